@@ -0,0 +1,47 @@
+#!/bin/bash
+
+######################################################################################
+# This script measures the throughput of the simulator on all four traces
+# You will need to first compile your code in ../src (make fast) before launching it
+# Optionally pass the path of a baseline sim binary to compare against, e.g. one
+# built from an older commit: bash ../scripts/bench.sh /tmp/sim.old
+# Any further arguments are passed to every simulator run
+# Each trace is run with in-process zlib decompression, with -gunzip, and with
+# $THREADS worker threads (default 4), then once with each op-type counting
+# kernel (-kernel scalar/sse4/avx2)
+# If ../traces/<trace>.ctr exists (see ../src/trace2col), it is timed as well
+######################################################################################
+
+baseline="$1"
+shift
+sim_args=("$@")
+threads="${THREADS:-4}"
+
+# Run one simulator on one trace and print its throughput in records/sec.
+run_one() {
+    local sim="$1"
+    local trace="$2"
+    local start end num_inst
+    start=$(date +%s.%N)
+    num_inst=$("$sim" "${sim_args[@]}" "$trace" | awk '/^LAB1_NUM_INST/ { print $3 }')
+    end=$(date +%s.%N)
+    awk -v n="$num_inst" -v s="$start" -v e="$end" \
+        'BEGIN { t = e - s; printf "%10d recs  %8.3f s  %12.0f recs/sec", n, t, n / t }'
+}
+
+for trace in bzip2 gcc libq mcf; do
+    echo "$trace:"
+    echo "    zlib    : $(run_one ../src/sim ../traces/$trace.otr.gz)"
+    echo "    gunzip  : $(sim_args=("${sim_args[@]}" -gunzip); run_one ../src/sim ../traces/$trace.otr.gz)"
+    echo "    threads : $(sim_args=("${sim_args[@]}" -threads "$threads"); run_one ../src/sim ../traces/$trace.otr.gz)"
+    for kernel in scalar sse4 avx2; do
+        printf "    %-8s: %s\n" "$kernel" \
+            "$(sim_args=("${sim_args[@]}" -kernel "$kernel"); run_one ../src/sim ../traces/$trace.otr.gz)"
+    done
+    if [[ -f ../traces/$trace.ctr ]]; then
+        echo "    columnar: $(run_one ../src/sim ../traces/$trace.ctr)"
+    fi
+    if [[ -n "$baseline" ]]; then
+        echo "    baseline: $(run_one "$baseline" ../traces/$trace.otr.gz)"
+    fi
+done
@@ -0,0 +1,436 @@
+// coltrace.cpp
+// Implements the reader and writer for columnar lab1 trace files.
+
+#include "coltrace.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(sizeof(ColTraceHeader) == 40, "ColTraceHeader must be packed");
+static_assert(sizeof(ColTraceIndexEntry) == 16,
+              "ColTraceIndexEntry must be packed");
+
+/** The size of the num_recs and pc_bytes fields at the start of a block. */
+#define BLOCK_HEADER_BYTES 8
+
+/** The largest number of bytes a varint can take. */
+#define MAX_VARINT_BYTES 10
+
+/** The number of bytes of packed optypes in a block of num_recs records. */
+#define OPTYPE_BYTES(num_recs) (3 * (((num_recs) + 7) / 8))
+
+/** The largest size of an encoded block. */
+#define MAX_BLOCK_BYTES                                                        \
+    (BLOCK_HEADER_BYTES + OPTYPE_BYTES(COLTRACE_BLOCK_RECS) +                  \
+     MAX_VARINT_BYTES * COLTRACE_BLOCK_RECS)
+
+/**
+ * Read exactly size bytes from the current position of the trace file.
+ *
+ * @param ct the trace
+ * @param buf the buffer to read into
+ * @param size the number of bytes to read
+ * @return 0 on success, or -1 on error or if the file ends first
+ */
+static int read_full(ColTrace *ct, void *buf, size_t size)
+{
+    uint8_t *bytes = (uint8_t *)buf;
+    while (size > 0)
+    {
+        ssize_t bytes_read = read(ct->fd, bytes, size);
+        ct->stat_syscalls++;
+        if (bytes_read == -1)
+        {
+            perror("Couldn't read from trace file");
+            return -1;
+        }
+        if (bytes_read == 0)
+        {
+            fprintf(stderr, "Error: trace file is truncated\n");
+            return -1;
+        }
+        ct->stat_bytes += bytes_read;
+        bytes += bytes_read;
+        size -= bytes_read;
+    }
+    return 0;
+}
+
+/**
+ * Write exactly size bytes at the current position of the trace file.
+ *
+ * @param ct the trace
+ * @param buf the bytes to write
+ * @param size the number of bytes to write
+ * @return 0 on success, or -1 on error
+ */
+static int write_full(ColTrace *ct, const void *buf, size_t size)
+{
+    const uint8_t *bytes = (const uint8_t *)buf;
+    while (size > 0)
+    {
+        ssize_t bytes_written = write(ct->fd, bytes, size);
+        ct->stat_syscalls++;
+        if (bytes_written == -1)
+        {
+            perror("Couldn't write to trace file");
+            return -1;
+        }
+        ct->stat_bytes += bytes_written;
+        bytes += bytes_written;
+        size -= bytes_written;
+    }
+    return 0;
+}
+
+bool coltrace_detect(const char *filename)
+{
+    char magic[8];
+
+    // Sniffing a pipe would eat the bytes the trace reader needs, so only a
+    // regular file can be a columnar trace.
+    struct stat st;
+    if (stat(filename, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        return false;
+    }
+
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1)
+    {
+        return false;
+    }
+    ssize_t bytes_read = read(fd, magic, sizeof(magic));
+    close(fd);
+    return bytes_read == sizeof(magic) &&
+           memcmp(magic, COLTRACE_MAGIC, sizeof(magic)) == 0;
+}
+
+ColTrace *coltrace_open(const char *filename)
+{
+    ColTrace *ct = (ColTrace *)calloc(1, sizeof(ColTrace));
+
+    ct->fd = open(filename, O_RDONLY);
+    if (ct->fd == -1)
+    {
+        perror("Couldn't open trace file");
+        free(ct);
+        return NULL;
+    }
+    posix_fadvise(ct->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    if (read_full(ct, &ct->header, sizeof(ct->header)) != 0 ||
+        memcmp(ct->header.magic, COLTRACE_MAGIC, sizeof(ct->header.magic)) != 0 ||
+        ct->header.version != COLTRACE_VERSION ||
+        ct->header.block_recs != COLTRACE_BLOCK_RECS)
+    {
+        fprintf(stderr, "Error: not a version %d columnar trace file\n",
+                COLTRACE_VERSION);
+        close(ct->fd);
+        free(ct);
+        return NULL;
+    }
+
+    ct->offset = sizeof(ct->header);
+    ct->block_buf = (uint8_t *)malloc(MAX_BLOCK_BYTES);
+    return ct;
+}
+
+/**
+ * Decode one block into buf.
+ *
+ * @param ct the trace
+ * @param buf the buffer to decode into, with room for COLTRACE_BLOCK_RECS
+ * @return the number of records decoded, or -1 on error
+ */
+static ssize_t read_block(ColTrace *ct, TraceRec *buf)
+{
+    uint32_t block_header[2];
+    if (read_full(ct, block_header, sizeof(block_header)) != 0)
+    {
+        return -1;
+    }
+
+    // Every block but the last is full.
+    uint32_t num_recs = block_header[0];
+    uint32_t pc_bytes = block_header[1];
+    bool last = (ct->block + 1 == ct->header.num_blocks);
+    if (num_recs == 0 || num_recs > COLTRACE_BLOCK_RECS ||
+        (!last && num_recs != COLTRACE_BLOCK_RECS) ||
+        pc_bytes > MAX_VARINT_BYTES * num_recs)
+    {
+        fprintf(stderr, "Error: Invalid trace file\n");
+        return -1;
+    }
+
+    size_t optype_bytes = OPTYPE_BYTES(num_recs);
+    if (read_full(ct, ct->block_buf, optype_bytes + pc_bytes) != 0)
+    {
+        return -1;
+    }
+
+    // Unpack the optypes, 8 records per 3 bytes.
+    const uint8_t *ops = ct->block_buf;
+    for (uint32_t i = 0; i < num_recs; i += 8, ops += 3)
+    {
+        uint32_t group = ops[0] | (ops[1] << 8) | (ops[2] << 16);
+        uint32_t group_recs = num_recs - i < 8 ? num_recs - i : 8;
+        for (uint32_t j = 0; j < group_recs; j++)
+        {
+            buf[i + j].optype = (group >> (3 * j)) & 7;
+        }
+    }
+
+    // Decode the PCs.
+    const uint8_t *pcs = ct->block_buf + optype_bytes;
+    const uint8_t *pcs_end = pcs + pc_bytes;
+    uint64_t pc = 0;
+    for (uint32_t i = 0; i < num_recs; i++)
+    {
+        uint64_t zigzag = 0;
+        unsigned int shift = 0;
+        while (true)
+        {
+            if (pcs == pcs_end || shift >= 64)
+            {
+                fprintf(stderr, "Error: Invalid trace file\n");
+                return -1;
+            }
+            uint8_t byte = *pcs++;
+            zigzag |= (uint64_t)(byte & 0x7F) << shift;
+            shift += 7;
+            if ((byte & 0x80) == 0)
+            {
+                break;
+            }
+        }
+        pc += (zigzag >> 1) ^ -(zigzag & 1);
+        buf[i].inst_addr = pc;
+    }
+    if (pcs != pcs_end)
+    {
+        fprintf(stderr, "Error: Invalid trace file\n");
+        return -1;
+    }
+
+    ct->offset += sizeof(block_header) + optype_bytes + pc_bytes;
+    ct->block++;
+    ct->rec += num_recs;
+    return num_recs;
+}
+
+ssize_t coltrace_read(ColTrace *ct, TraceRec *buf, size_t max_recs)
+{
+    size_t num_recs = 0;
+    while (num_recs + COLTRACE_BLOCK_RECS <= max_recs &&
+           ct->block < ct->header.num_blocks)
+    {
+        ssize_t block_recs = read_block(ct, buf + num_recs);
+        if (block_recs == -1)
+        {
+            return -1;
+        }
+        num_recs += block_recs;
+    }
+
+    if (ct->block == ct->header.num_blocks &&
+        (ct->rec != ct->header.num_recs ||
+         ct->offset != ct->header.index_offset))
+    {
+        fprintf(stderr, "Error: Invalid trace file\n");
+        return -1;
+    }
+    return num_recs;
+}
+
+ColTrace *coltrace_create(const char *filename)
+{
+    ColTrace *ct = (ColTrace *)calloc(1, sizeof(ColTrace));
+    ct->writing = true;
+
+    ct->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (ct->fd == -1)
+    {
+        perror("Couldn't create trace file");
+        free(ct);
+        return NULL;
+    }
+
+    // Leave room for the header, which is written last.
+    memcpy(ct->header.magic, COLTRACE_MAGIC, sizeof(ct->header.magic));
+    ct->header.version = COLTRACE_VERSION;
+    ct->header.block_recs = COLTRACE_BLOCK_RECS;
+    if (write_full(ct, &ct->header, sizeof(ct->header)) != 0)
+    {
+        close(ct->fd);
+        free(ct);
+        return NULL;
+    }
+
+    ct->offset = sizeof(ct->header);
+    ct->block_buf = (uint8_t *)malloc(MAX_BLOCK_BYTES);
+    ct->pending = (TraceRec *)malloc(COLTRACE_BLOCK_RECS * sizeof(TraceRec));
+    return ct;
+}
+
+/**
+ * Encode and write one block.
+ *
+ * @param ct the trace
+ * @param recs the records of the block
+ * @param num_recs the number of records, at most COLTRACE_BLOCK_RECS
+ * @return 0 on success, or -1 on error
+ */
+static int write_block(ColTrace *ct, const TraceRec *recs, uint32_t num_recs)
+{
+    // Pack the optypes, 8 records per 3 bytes.
+    size_t optype_bytes = OPTYPE_BYTES(num_recs);
+    uint8_t *ops = ct->block_buf + BLOCK_HEADER_BYTES;
+    for (uint32_t i = 0; i < num_recs; i += 8, ops += 3)
+    {
+        uint32_t group = 0;
+        uint32_t group_recs = num_recs - i < 8 ? num_recs - i : 8;
+        for (uint32_t j = 0; j < group_recs; j++)
+        {
+            if (recs[i + j].optype > 7)
+            {
+                fprintf(stderr, "Error: optype %u does not fit in 3 bits\n",
+                        recs[i + j].optype);
+                return -1;
+            }
+            group |= (uint32_t)recs[i + j].optype << (3 * j);
+        }
+        ops[0] = group & 0xFF;
+        ops[1] = (group >> 8) & 0xFF;
+        ops[2] = (group >> 16) & 0xFF;
+    }
+
+    // Encode the PCs.
+    uint8_t *pcs = ct->block_buf + BLOCK_HEADER_BYTES + optype_bytes;
+    uint8_t *pcs_start = pcs;
+    uint64_t pc = 0;
+    for (uint32_t i = 0; i < num_recs; i++)
+    {
+        uint64_t delta = recs[i].inst_addr - pc;
+        uint64_t zigzag = (delta << 1) ^ -(delta >> 63);
+        pc = recs[i].inst_addr;
+        while (zigzag >= 0x80)
+        {
+            *pcs++ = (zigzag & 0x7F) | 0x80;
+            zigzag >>= 7;
+        }
+        *pcs++ = zigzag;
+    }
+
+    uint32_t block_header[2] = {num_recs, (uint32_t)(pcs - pcs_start)};
+    memcpy(ct->block_buf, block_header, sizeof(block_header));
+    size_t block_bytes = pcs - ct->block_buf;
+    if (write_full(ct, ct->block_buf, block_bytes) != 0)
+    {
+        return -1;
+    }
+
+    ct->index = (ColTraceIndexEntry *)realloc(
+        ct->index, (ct->block + 1) * sizeof(ColTraceIndexEntry));
+    ct->index[ct->block].offset = ct->offset;
+    ct->index[ct->block].first_rec = ct->rec;
+    ct->offset += block_bytes;
+    ct->block++;
+    ct->rec += num_recs;
+    return 0;
+}
+
+int coltrace_write(ColTrace *ct, const TraceRec *recs, size_t num_recs)
+{
+    // Top up a partly filled block first.
+    if (ct->num_pending > 0)
+    {
+        size_t to_copy = COLTRACE_BLOCK_RECS - ct->num_pending;
+        if (to_copy > num_recs)
+        {
+            to_copy = num_recs;
+        }
+        memcpy(ct->pending + ct->num_pending, recs, to_copy * sizeof(TraceRec));
+        ct->num_pending += to_copy;
+        recs += to_copy;
+        num_recs -= to_copy;
+
+        if (ct->num_pending < COLTRACE_BLOCK_RECS)
+        {
+            return 0;
+        }
+        if (write_block(ct, ct->pending, COLTRACE_BLOCK_RECS) != 0)
+        {
+            return -1;
+        }
+        ct->num_pending = 0;
+    }
+
+    // Write full blocks straight from recs, and keep the rest for later.
+    while (num_recs >= COLTRACE_BLOCK_RECS)
+    {
+        if (write_block(ct, recs, COLTRACE_BLOCK_RECS) != 0)
+        {
+            return -1;
+        }
+        recs += COLTRACE_BLOCK_RECS;
+        num_recs -= COLTRACE_BLOCK_RECS;
+    }
+    memcpy(ct->pending, recs, num_recs * sizeof(TraceRec));
+    ct->num_pending = num_recs;
+    return 0;
+}
+
+/**
+ * Write out the last block, the index, and the final header.
+ *
+ * @param ct the trace, opened with coltrace_create()
+ * @return 0 on success, or -1 on error
+ */
+static int finish_writing(ColTrace *ct)
+{
+    if (ct->num_pending > 0 &&
+        write_block(ct, ct->pending, ct->num_pending) != 0)
+    {
+        return -1;
+    }
+
+    ct->header.num_recs = ct->rec;
+    ct->header.num_blocks = ct->block;
+    ct->header.index_offset = ct->offset;
+    if (write_full(ct, ct->index, ct->block * sizeof(ColTraceIndexEntry)) != 0)
+    {
+        return -1;
+    }
+
+    if (lseek(ct->fd, 0, SEEK_SET) == -1)
+    {
+        perror("Couldn't seek in trace file");
+        return -1;
+    }
+    return write_full(ct, &ct->header, sizeof(ct->header));
+}
+
+int coltrace_close(ColTrace *ct)
+{
+    int status = 0;
+
+    if (ct->writing)
+    {
+        status = finish_writing(ct);
+    }
+    if (close(ct->fd) != 0)
+    {
+        perror("Couldn't close trace file");
+        status = -1;
+    }
+
+    free(ct->block_buf);
+    free(ct->index);
+    free(ct->pending);
+    free(ct);
+    return status;
+}
@@ -0,0 +1,179 @@
+// coltrace.h
+// Declares a reader and writer for columnar lab1 trace files.
+//
+// A columnar trace stores the same records as a .otr.gz trace, but without
+// the padding of TraceRec and without gzip. Records are grouped into blocks
+// of COLTRACE_BLOCK_RECS, and each block stores its optypes and its PCs as
+// two separate streams:
+//
+// - The optypes are packed 3 bits per record, 8 records per 3 bytes.
+// - The PCs are stored as the difference from the previous PC in the block
+//   (the first PC of a block is relative to 0), zigzag-encoded and written as
+//   little-endian base-128 varints, so a PC close to the last one takes a
+//   single byte.
+//
+// Each block can be decoded on its own, and an index of block offsets at the
+// end of the file allows seeking straight to a block.
+//
+// File layout, all integers little-endian:
+//
+//   ColTraceHeader
+//   For each block:
+//     uint32_t num_recs
+//     uint32_t pc_bytes
+//     uint8_t  optypes[3 * ceil(num_recs / 8)]
+//     uint8_t  pcs[pc_bytes]
+//   ColTraceIndexEntry index[num_blocks]
+
+#ifndef _COLTRACE_H_
+#define _COLTRACE_H_
+
+#include "trace.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/** The magic bytes at the start of every columnar trace file. */
+#define COLTRACE_MAGIC "LAB1COLT"
+
+/** The version of the format written by coltrace_create(). */
+#define COLTRACE_VERSION 1
+
+/** The number of records in every block except the last. */
+#define COLTRACE_BLOCK_RECS 65536
+
+/** The header at the start of a columnar trace file. */
+typedef struct ColTraceHeader
+{
+    /** COLTRACE_MAGIC, without the terminating NUL. */
+    char magic[8];
+
+    /** COLTRACE_VERSION. */
+    uint32_t version;
+
+    /** COLTRACE_BLOCK_RECS. */
+    uint32_t block_recs;
+
+    /** The total number of records in the trace. */
+    uint64_t num_recs;
+
+    /** The number of blocks in the trace. */
+    uint64_t num_blocks;
+
+    /** The offset of the block index from the start of the file. */
+    uint64_t index_offset;
+} ColTraceHeader;
+
+/** An entry in the block index of a columnar trace file. */
+typedef struct ColTraceIndexEntry
+{
+    /** The offset of the block from the start of the file. */
+    uint64_t offset;
+
+    /** The number of records in the trace before this block. */
+    uint64_t first_rec;
+} ColTraceIndexEntry;
+
+/** An open columnar trace file, for reading or writing. */
+typedef struct ColTrace
+{
+    /** The file descriptor of the trace file. */
+    int fd;
+
+    /** Whether the trace was opened with coltrace_create(). */
+    bool writing;
+
+    /** The header of the trace file. */
+    ColTraceHeader header;
+
+    /** The number of blocks read or written so far. */
+    uint64_t block;
+
+    /** The number of records read or written so far. */
+    uint64_t rec;
+
+    /** The offset of the next block from the start of the file. */
+    uint64_t offset;
+
+    /** The encoded block being read or written. */
+    uint8_t *block_buf;
+
+    /** When writing, the index entry of every block written so far. */
+    ColTraceIndexEntry *index;
+
+    /** When writing, the number of records waiting in pending. */
+    size_t num_pending;
+
+    /** When writing, the records waiting for their block to fill up. */
+    TraceRec *pending;
+
+    /** The number of read() or write() system calls issued on fd. */
+    uint64_t stat_syscalls;
+
+    /** The number of bytes read from or written to fd. */
+    uint64_t stat_bytes;
+} ColTrace;
+
+/**
+ * Check whether a file is a columnar trace file, by its magic bytes. Only a
+ * regular file is checked, so that a pipe is left unread.
+ *
+ * @param filename the path of the file
+ * @return true if the file is a columnar trace file
+ */
+bool coltrace_detect(const char *filename);
+
+/**
+ * Open a columnar trace file for reading.
+ *
+ * @param filename the path of the trace file
+ * @return a pointer to a newly allocated trace, or NULL on failure
+ */
+ColTrace *coltrace_open(const char *filename);
+
+/**
+ * Read and decode trace records.
+ *
+ * The buffer is filled as far as possible, and fewer than max_recs records are
+ * returned only at the end of the trace. The padding bytes of each record are
+ * left unset.
+ *
+ * @param ct the trace, opened with coltrace_open()
+ * @param buf the buffer to decode into
+ * @param max_recs the size of buf, which must be a multiple of
+ *                 COLTRACE_BLOCK_RECS
+ * @return the number of records read, 0 at the end of the trace, or -1 on
+ *         error
+ */
+ssize_t coltrace_read(ColTrace *ct, TraceRec *buf, size_t max_recs);
+
+/**
+ * Create a columnar trace file for writing, replacing any existing file.
+ *
+ * @param filename the path of the trace file
+ * @return a pointer to a newly allocated trace, or NULL on failure
+ */
+ColTrace *coltrace_create(const char *filename);
+
+/**
+ * Encode and write trace records.
+ *
+ * @param ct the trace, opened with coltrace_create()
+ * @param recs the records to write
+ * @param num_recs the number of records to write
+ * @return 0 on success, or -1 on error
+ */
+int coltrace_write(ColTrace *ct, const TraceRec *recs, size_t num_recs);
+
+/**
+ * Close a columnar trace file and free it.
+ *
+ * When writing, this first writes out the last block, the index, and the
+ * final header.
+ *
+ * @param ct the trace
+ * @return 0 on success, or -1 on error
+ */
+int coltrace_close(ColTrace *ct);
+
+#endif
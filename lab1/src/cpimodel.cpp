@@ -0,0 +1,217 @@
+// cpimodel.cpp
+// Implements the table of CPI models used to estimate cycle counts.
+
+#include "cpimodel.h"
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The CPI of each op type under each model, one row per op type so that the
+ * models for an op type are contiguous and cpimodel_eval() runs down a row at
+ * a time.
+ */
+static double weights[NUM_OP_TYPES][MAX_CPI_MODELS] = {
+    {1}, // OP_ALU
+    {2}, // OP_LD
+    {2}, // OP_ST
+    {3}, // OP_CBR
+    {1}, // OP_OTHER
+};
+
+/** The name of each model. */
+static char names[MAX_CPI_MODELS][MAX_CPI_MODEL_NAME + 1] = {"default"};
+
+/** The number of models, including the default model until one is added. */
+static int num_models = 1;
+
+/** Whether the only model is the default model. */
+static bool default_only = true;
+
+int cpimodel_add(const char *name, const double cpi[NUM_OP_TYPES])
+{
+    if (default_only)
+    {
+        num_models = 0;
+        default_only = false;
+    }
+    if (num_models == MAX_CPI_MODELS)
+    {
+        fprintf(stderr, "Error: at most %d CPI models are supported\n",
+                MAX_CPI_MODELS);
+        return -1;
+    }
+    if (strlen(name) > MAX_CPI_MODEL_NAME)
+    {
+        fprintf(stderr, "Error: CPI model name is too long: %s\n", name);
+        return -1;
+    }
+
+    strcpy(names[num_models], name);
+    for (int op = 0; op < NUM_OP_TYPES; op++)
+    {
+        weights[op][num_models] = cpi[op];
+    }
+    num_models++;
+    return 0;
+}
+
+/**
+ * Parse a single CPI.
+ *
+ * @param str the CPI as text
+ * @param end set to the first character after the CPI
+ * @param cpi set to the CPI
+ * @return 0 on success, or -1 if str doesn't start with a non-negative number
+ */
+static int parse_cpi(const char *str, char **end, double *cpi)
+{
+    *cpi = strtod(str, end);
+    if (*end == str || !(*cpi >= 0.0) || isinf(*cpi))
+    {
+        return -1;
+    }
+    return 0;
+}
+
+int cpimodel_parse(const char *spec)
+{
+    double cpi[NUM_OP_TYPES];
+    const char *str = spec;
+
+    for (int op = 0; op < NUM_OP_TYPES; op++)
+    {
+        char *end;
+        if (parse_cpi(str, &end, &cpi[op]) != 0 ||
+            *end != (op == NUM_OP_TYPES - 1 ? '\0' : ','))
+        {
+            fprintf(stderr, "Error: CPI model must be %d comma-separated "
+                            "non-negative numbers: %s\n",
+                    NUM_OP_TYPES, spec);
+            return -1;
+        }
+        str = end + 1;
+    }
+
+    char name[MAX_CPI_MODEL_NAME + 1];
+    snprintf(name, sizeof(name), "model%d", default_only ? 0 : num_models);
+    return cpimodel_add(name, cpi);
+}
+
+int cpimodel_load(const char *filename)
+{
+    FILE *file = fopen(filename, "r");
+    if (file == NULL)
+    {
+        perror("Couldn't open CPI model file");
+        return -1;
+    }
+
+    char line[256];
+    int line_num = 0;
+    int status = 0;
+    while (status == 0 && fgets(line, sizeof(line), file) != NULL)
+    {
+        line_num++;
+
+        // Skip blank lines and comments.
+        char *str = line;
+        while (isspace((unsigned char)*str))
+        {
+            str++;
+        }
+        if (*str == '\0' || *str == '#')
+        {
+            continue;
+        }
+
+        char name[MAX_CPI_MODEL_NAME + 1];
+        int name_len = 0;
+        while (*str != '\0' && !isspace((unsigned char)*str))
+        {
+            if (name_len == MAX_CPI_MODEL_NAME)
+            {
+                fprintf(stderr, "Error: %s:%d: CPI model name is too long\n",
+                        filename, line_num);
+                status = -1;
+                break;
+            }
+            name[name_len++] = *str++;
+        }
+        name[name_len] = '\0';
+        if (status != 0)
+        {
+            break;
+        }
+
+        double cpi[NUM_OP_TYPES];
+        for (int op = 0; op < NUM_OP_TYPES && status == 0; op++)
+        {
+            char *end;
+            if (parse_cpi(str, &end, &cpi[op]) != 0)
+            {
+                status = -1;
+            }
+            str = end;
+        }
+        while (isspace((unsigned char)*str))
+        {
+            str++;
+        }
+        if (status != 0 || *str != '\0')
+        {
+            fprintf(stderr, "Error: %s:%d: expected a name and %d "
+                            "non-negative CPIs\n",
+                    filename, line_num, NUM_OP_TYPES);
+            status = -1;
+            break;
+        }
+
+        status = cpimodel_add(name, cpi);
+    }
+
+    fclose(file);
+    return status;
+}
+
+int cpimodel_count()
+{
+    return num_models;
+}
+
+const char *cpimodel_name(int model)
+{
+    return names[model];
+}
+
+uint64_t cpimodel_primary_cycles(const uint64_t optype_dyn[NUM_OP_TYPES])
+{
+    double cycles = 0.0;
+    for (int op = 0; op < NUM_OP_TYPES; op++)
+    {
+        cycles += (double)optype_dyn[op] * weights[op][0];
+    }
+    return (uint64_t)llround(cycles);
+}
+
+void cpimodel_eval(const uint64_t optype_dyn[NUM_OP_TYPES], double *cycles)
+{
+    for (int model = 0; model < num_models; model++)
+    {
+        cycles[model] = 0.0;
+    }
+
+    // The histogram times the weight matrix, one op type (row) at a time; the
+    // inner loop over models is contiguous and vectorizes.
+    for (int op = 0; op < NUM_OP_TYPES; op++)
+    {
+        double count = (double)optype_dyn[op];
+        const double *row = weights[op];
+        for (int model = 0; model < num_models; model++)
+        {
+            cycles[model] += count * row[model];
+        }
+    }
+}
@@ -0,0 +1,89 @@
+// cpimodel.h
+// Declares the table of CPI models used to estimate cycle counts.
+//
+// A CPI model gives the CPI of each op type, so the number of cycles it
+// predicts is the dot product of its weights with the op-type histogram of the
+// trace. Since the histogram is all any model needs, any number of models can
+// be evaluated after a single pass over the trace.
+//
+// The first model is the primary one, which drives LAB1_NUM_CYCLES and
+// LAB1_CPI. Without any models added, the table holds only the default model
+// (ALU=1, LD=2, ST=2, CBR=3, OTHER=1).
+
+#ifndef _CPIMODEL_H_
+#define _CPIMODEL_H_
+
+#include "trace.h"
+#include <inttypes.h>
+
+/** The maximum number of CPI models that can be evaluated at once. */
+#define MAX_CPI_MODELS 64
+
+/** The maximum length of the name of a CPI model. */
+#define MAX_CPI_MODEL_NAME 31
+
+/**
+ * Add a CPI model. The first model added replaces the default model.
+ *
+ * @param name the name of the model, at most MAX_CPI_MODEL_NAME characters
+ * @param cpi the CPI of each op type
+ * @return 0 on success, or -1 if there are already MAX_CPI_MODELS models or
+ *         the name is too long
+ */
+int cpimodel_add(const char *name, const double cpi[NUM_OP_TYPES]);
+
+/**
+ * Add a CPI model given as a comma-separated list of the CPI of each op type,
+ * in the order ALU,LD,ST,CBR,OTHER. The model is named after its position.
+ *
+ * @param spec the list of CPIs, e.g. "1,2,2,3,1"
+ * @return 0 on success, or -1 on error, which is reported to stderr
+ */
+int cpimodel_parse(const char *spec);
+
+/**
+ * Add every CPI model in a config file.
+ *
+ * Each non-blank line that doesn't start with '#' is one model: a name
+ * followed by the CPI of each op type, separated by whitespace, e.g.
+ *
+ *   slow_mem  1 4 4 3 1
+ *
+ * @param filename the path of the config file
+ * @return 0 on success, or -1 on error, which is reported to stderr
+ */
+int cpimodel_load(const char *filename);
+
+/**
+ * Get the number of CPI models.
+ *
+ * @return the number of models, at least 1
+ */
+int cpimodel_count();
+
+/**
+ * Get the name of a CPI model.
+ *
+ * @param model the index of the model
+ * @return the name of the model
+ */
+const char *cpimodel_name(int model);
+
+/**
+ * Get the number of cycles the primary CPI model predicts.
+ *
+ * @param optype_dyn the number of instructions executed by op type
+ * @return the number of cycles, rounded to the nearest integer
+ */
+uint64_t cpimodel_primary_cycles(const uint64_t optype_dyn[NUM_OP_TYPES]);
+
+/**
+ * Get the number of cycles every CPI model predicts.
+ *
+ * @param optype_dyn the number of instructions executed by op type
+ * @param cycles set to the number of cycles for each model, with room for
+ *               cpimodel_count() entries
+ */
+void cpimodel_eval(const uint64_t optype_dyn[NUM_OP_TYPES], double *cycles);
+
+#endif
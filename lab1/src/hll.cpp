@@ -0,0 +1,85 @@
+// hll.cpp
+// Implements the HyperLogLog estimator of the number of distinct PCs.
+
+#include "hll.h"
+#include <math.h>
+#include <stdlib.h>
+
+HLL *hll_new(unsigned int precision)
+{
+    HLL *hll = (HLL *)calloc(1, sizeof(HLL));
+    hll->precision = precision;
+    hll->registers = (uint8_t *)calloc(hll_size_bytes(hll), 1);
+    return hll;
+}
+
+void hll_free(HLL *hll)
+{
+    if (hll == NULL)
+    {
+        return;
+    }
+    free(hll->registers);
+    free(hll);
+}
+
+void hll_merge(HLL *dst, const HLL *src)
+{
+    size_t num_registers = hll_size_bytes(dst);
+    for (size_t i = 0; i < num_registers; i++)
+    {
+        if (src->registers[i] > dst->registers[i])
+        {
+            dst->registers[i] = src->registers[i];
+        }
+    }
+}
+
+double hll_estimate(const HLL *hll)
+{
+    size_t num_registers = hll_size_bytes(hll);
+    double m = (double)num_registers;
+
+    double sum = 0.0;
+    size_t num_zero = 0;
+    for (size_t i = 0; i < num_registers; i++)
+    {
+        sum += ldexp(1.0, -hll->registers[i]);
+        if (hll->registers[i] == 0)
+        {
+            num_zero++;
+        }
+    }
+
+    // The bias correction constant from the HyperLogLog paper.
+    double alpha;
+    switch (num_registers)
+    {
+    case 16:
+        alpha = 0.673;
+        break;
+    case 32:
+        alpha = 0.697;
+        break;
+    case 64:
+        alpha = 0.709;
+        break;
+    default:
+        alpha = 0.7213 / (1.0 + 1.079 / m);
+        break;
+    }
+    double estimate = alpha * m * m / sum;
+
+    // Small cardinalities are estimated better by linear counting. With a
+    // 64-bit hash there is no large-range correction to make.
+    if (estimate <= 2.5 * m && num_zero > 0)
+    {
+        estimate = m * log(m / (double)num_zero);
+    }
+    return estimate;
+}
+
+double hll_std_error(const HLL *hll)
+{
+    return 1.04 / sqrt((double)hll_size_bytes(hll));
+}
@@ -0,0 +1,114 @@
+// hll.h
+// Declares a HyperLogLog estimator of the number of distinct PCs.
+//
+// Unlike PCSet, which stores every PC, a HyperLogLog sketch keeps a fixed
+// array of 2^precision one-byte registers, each holding the longest run of
+// leading zero bits seen among the hashes of the PCs routed to it. The
+// estimate has a relative standard error of about 1.04 / sqrt(2^precision).
+
+#ifndef _HLL_H_
+#define _HLL_H_
+
+#include <inttypes.h>
+#include <stddef.h>
+
+/** The smallest supported precision. */
+#define HLL_MIN_PRECISION 4
+
+/** The largest supported precision. */
+#define HLL_MAX_PRECISION 18
+
+/** The default precision: 16 KiB of registers, about 0.81% standard error. */
+#define HLL_DEFAULT_PRECISION 14
+
+/** A HyperLogLog sketch. */
+typedef struct HLL
+{
+    /** log2 of the number of registers. */
+    unsigned int precision;
+
+    /** The registers. */
+    uint8_t *registers;
+} HLL;
+
+/**
+ * Allocate and initialize an empty sketch.
+ *
+ * @param precision log2 of the number of registers, between HLL_MIN_PRECISION
+ *                  and HLL_MAX_PRECISION
+ * @return a pointer to a newly allocated sketch
+ */
+HLL *hll_new(unsigned int precision);
+
+/**
+ * Free a sketch.
+ *
+ * @param hll the sketch to free
+ */
+void hll_free(HLL *hll);
+
+/**
+ * Add every PC seen by src to dst. Both must have the same precision.
+ *
+ * @param dst the sketch to add to
+ * @param src the sketch to add from
+ */
+void hll_merge(HLL *dst, const HLL *src);
+
+/**
+ * Estimate the number of distinct PCs added to a sketch.
+ *
+ * @param hll the sketch
+ * @return the estimated number of distinct PCs
+ */
+double hll_estimate(const HLL *hll);
+
+/**
+ * Get the relative standard error of the estimate of a sketch.
+ *
+ * @param hll the sketch
+ * @return the relative standard error, e.g. 0.0081 for 0.81%
+ */
+double hll_std_error(const HLL *hll);
+
+/**
+ * Get the number of bytes of registers of a sketch.
+ *
+ * @param hll the sketch
+ * @return the size of the registers in bytes
+ */
+static inline size_t hll_size_bytes(const HLL *hll)
+{
+    return (size_t)1 << hll->precision;
+}
+
+/**
+ * Add a PC to a sketch.
+ *
+ * @param hll the sketch
+ * @param pc the PC to add
+ */
+static inline void hll_add(HLL *hll, uint64_t pc)
+{
+    // The murmur3 finalizer, so that every bit of the hash depends on every
+    // bit of the PC. The leading zero count needs good high and low bits,
+    // which the multiplicative hash of PCSet doesn't give.
+    uint64_t h = pc;
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+
+    // The top bits pick the register; the rest give the rank. The extra 1 bit
+    // caps the rank when the rest are all zero.
+    uint64_t index = h >> (64 - hll->precision);
+    uint64_t rest = (h << hll->precision) | (1ULL << (hll->precision - 1));
+    uint8_t rank = __builtin_clzll(rest) + 1;
+    if (rank > hll->registers[index])
+    {
+        hll->registers[index] = rank;
+    }
+}
+
+#endif
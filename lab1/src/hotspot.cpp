@@ -0,0 +1,231 @@
+// hotspot.cpp
+// Implements the per-PC hot-spot profile.
+
+#include "hotspot.h"
+#include <algorithm>
+#include <queue>
+#include <stdio.h>
+#include <vector>
+
+/** The names of the op types, as printed in the report. */
+static const char *const OPTYPE_NAMES[NUM_OP_TYPES] = {
+    "ALU", "LD", "ST", "CBR", "OTHER",
+};
+
+/** A PC and its execution count. */
+typedef struct HotPC
+{
+    uint64_t count;
+    uint64_t pc;
+    OpType optype;
+} HotPC;
+
+/** A range of PCs executed the same number of times. */
+typedef struct HotRange
+{
+    /** The number of instructions executed in the range, i.e. its weight. */
+    uint64_t num_inst;
+    uint64_t start_pc;
+    uint64_t end_pc;
+    uint64_t num_pcs;
+    uint64_t count;
+} HotRange;
+
+static bool hot_pc_less(const HotPC &a, const HotPC &b)
+{
+    return a.count < b.count || (a.count == b.count && a.pc > b.pc);
+}
+
+static bool hot_range_greater(const HotRange &a, const HotRange &b)
+{
+    return a.num_inst > b.num_inst ||
+           (a.num_inst == b.num_inst && a.start_pc < b.start_pc);
+}
+
+/**
+ * Add the execution count in a profile value to the entry for a PC.
+ */
+static inline void merge_entry(PCMap *dst, uint64_t pc, uint64_t value)
+{
+    bool inserted;
+    uint64_t *dst_value = pcmap_upsert(dst, pc, &inserted);
+    if (inserted)
+    {
+        *dst_value = value;
+    }
+    else
+    {
+        *dst_value += hotspot_value_count(value) << HOTSPOT_OPTYPE_BITS;
+    }
+}
+
+void hotspot_merge(PCMap *dst, const PCMap *src)
+{
+    if (src->has_zero)
+    {
+        merge_entry(dst, 0, src->zero.value);
+    }
+    for (uint64_t j = 0; j < src->capacity; j++)
+    {
+        if (src->slots[j].pc != 0)
+        {
+            merge_entry(dst, src->slots[j].pc, src->slots[j].value);
+        }
+    }
+}
+
+/**
+ * Copy every PC of a profile into a vector.
+ */
+static std::vector<HotPC> collect(const PCMap *counts)
+{
+    std::vector<HotPC> pcs;
+    pcs.reserve(pcmap_size(counts));
+    for (uint64_t j = 0; j < counts->capacity; j++)
+    {
+        if (counts->slots[j].pc != 0)
+        {
+            uint64_t value = counts->slots[j].value;
+            pcs.push_back({hotspot_value_count(value), counts->slots[j].pc,
+                           hotspot_value_optype(value)});
+        }
+    }
+    if (counts->has_zero)
+    {
+        pcs.push_back({hotspot_value_count(counts->zero.value), 0,
+                       hotspot_value_optype(counts->zero.value)});
+    }
+    return pcs;
+}
+
+/**
+ * Print the hottest PCs and the number of hottest PCs covering 50%, 90%, and
+ * 99% of the trace.
+ *
+ * Both only need the PCs in order of count up to the 99% mark, so rather than
+ * sorting every PC, the PCs are heapified in linear time and popped one at a
+ * time until the mark is reached.
+ */
+static void print_hot_pcs(std::vector<HotPC> pcs, uint64_t num_inst,
+                          uint32_t top_n)
+{
+    static const int COVER_PERCENTS[] = {50, 90, 99};
+    const int num_marks = sizeof(COVER_PERCENTS) / sizeof(COVER_PERCENTS[0]);
+    uint64_t cover_pcs[num_marks] = {};
+
+    std::make_heap(pcs.begin(), pcs.end(), hot_pc_less);
+    uint64_t num_popped = 0;
+    uint64_t cumulative = 0;
+    int mark = 0;
+    while (!pcs.empty() && (num_popped < top_n || mark < num_marks))
+    {
+        std::pop_heap(pcs.begin(), pcs.end(), hot_pc_less);
+        HotPC hot = pcs.back();
+        pcs.pop_back();
+        num_popped++;
+        cumulative += hot.count;
+
+        if (num_popped <= top_n)
+        {
+            printf("LAB1_HOT_PC_%-4lu       \t : 0x%012lx %-5s %12lu  %7.3f%%  %7.3f%%\n",
+                   num_popped, hot.pc, OPTYPE_NAMES[hot.optype], hot.count,
+                   100.0 * (double)hot.count / (double)num_inst,
+                   100.0 * (double)cumulative / (double)num_inst);
+        }
+        while (mark < num_marks &&
+               cumulative * 100 >= num_inst * COVER_PERCENTS[mark])
+        {
+            cover_pcs[mark++] = num_popped;
+        }
+    }
+    printf("\n");
+
+    for (int i = 0; i < num_marks; i++)
+    {
+        printf("LAB1_COVER_%d_PC        \t : %10lu\n", COVER_PERCENTS[i],
+               cover_pcs[i]);
+    }
+    printf("\n");
+}
+
+/**
+ * Print the hottest basic-block-like ranges of PCs.
+ *
+ * All instructions of a basic block execute equally often, so a range is a
+ * maximal run of PCs, in address order, no more than HOTSPOT_MAX_INST_BYTES
+ * apart, with the same execution count, and with no conditional branch
+ * before its last PC. The top ranges are kept in a min-heap of top_n entries.
+ */
+static void print_hot_ranges(std::vector<HotPC> pcs, uint64_t num_inst,
+                             uint32_t top_n)
+{
+    std::sort(pcs.begin(), pcs.end(),
+              [](const HotPC &a, const HotPC &b) { return a.pc < b.pc; });
+
+    std::priority_queue<HotRange, std::vector<HotRange>,
+                        bool (*)(const HotRange &, const HotRange &)>
+        top(hot_range_greater);
+    size_t start = 0;
+    for (size_t i = 0; i < pcs.size(); i++)
+    {
+        bool last = i + 1 == pcs.size() || pcs[i].optype == OP_CBR ||
+                    pcs[i + 1].pc - pcs[i].pc > HOTSPOT_MAX_INST_BYTES ||
+                    pcs[i + 1].count != pcs[i].count;
+        if (!last)
+        {
+            continue;
+        }
+
+        HotRange range;
+        range.num_pcs = i + 1 - start;
+        range.count = pcs[start].count;
+        range.num_inst = range.num_pcs * range.count;
+        range.start_pc = pcs[start].pc;
+        range.end_pc = pcs[i].pc;
+        start = i + 1;
+
+        if (top.size() < top_n)
+        {
+            top.push(range);
+        }
+        else if (hot_range_greater(range, top.top()))
+        {
+            top.pop();
+            top.push(range);
+        }
+    }
+
+    // The heap pops the coldest first.
+    std::vector<HotRange> ranges(top.size());
+    for (size_t i = ranges.size(); i > 0; i--)
+    {
+        ranges[i - 1] = top.top();
+        top.pop();
+    }
+
+    for (size_t i = 0; i < ranges.size(); i++)
+    {
+        printf("LAB1_HOT_RANGE_%-4lu    \t : 0x%012lx-0x%012lx %5lu PCs %12lu x  %7.3f%%\n",
+               i + 1, ranges[i].start_pc, ranges[i].end_pc, ranges[i].num_pcs,
+               ranges[i].count,
+               100.0 * (double)ranges[i].num_inst / (double)num_inst);
+    }
+    printf("\n");
+}
+
+void hotspot_print(const PCMap *counts, uint32_t top_n)
+{
+    std::vector<HotPC> pcs = collect(counts);
+    uint64_t num_inst = 0;
+    for (const HotPC &hot : pcs)
+    {
+        num_inst += hot.count;
+    }
+    if (num_inst == 0)
+    {
+        return;
+    }
+
+    print_hot_pcs(pcs, num_inst, top_n);
+    print_hot_ranges(std::move(pcs), num_inst, top_n);
+}
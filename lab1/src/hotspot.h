@@ -0,0 +1,88 @@
+// hotspot.h
+// Declares the per-PC hot-spot profile: the dynamic execution count and op
+// type of every PC, from which the hottest instructions, the hottest
+// basic-block-like PC ranges, and the coverage curve of the trace are
+// reported.
+//
+// The profile is a PCMap whose value packs the execution count of the PC above
+// its op type, so it takes no more memory than the map itself. Counts are
+// independent of trace order, so unlike a LocalityProfile, profiles gathered
+// by separate threads can be merged.
+
+#ifndef _HOTSPOT_H_
+#define _HOTSPOT_H_
+
+#include "pcmap.h"
+#include "trace.h"
+#include <inttypes.h>
+#include <stddef.h>
+
+/** The number of low bits of a profile value holding the op type. */
+#define HOTSPOT_OPTYPE_BITS 3
+
+/**
+ * The largest gap in bytes between two PCs of the same range, i.e. the
+ * longest instruction.
+ */
+#define HOTSPOT_MAX_INST_BYTES 15
+
+/**
+ * Get the execution count from a profile value.
+ *
+ * @param value the value stored for a PC
+ * @return the number of times the PC was executed
+ */
+static inline uint64_t hotspot_value_count(uint64_t value)
+{
+    return value >> HOTSPOT_OPTYPE_BITS;
+}
+
+/**
+ * Get the op type from a profile value.
+ *
+ * @param value the value stored for a PC
+ * @return the op type of the PC
+ */
+static inline OpType hotspot_value_optype(uint64_t value)
+{
+    return (OpType)(value & ((1 << HOTSPOT_OPTYPE_BITS) - 1));
+}
+
+/**
+ * Update a profile with a batch of trace records.
+ *
+ * @param counts the profile to update
+ * @param t the first trace record of the batch
+ * @param n the number of records in the batch
+ */
+static inline void hotspot_add(PCMap *counts, const TraceRec *t, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        bool inserted;
+        uint64_t *value = pcmap_upsert(counts, t[i].inst_addr, &inserted);
+        if (inserted)
+        {
+            *value = t[i].optype;
+        }
+        *value += 1 << HOTSPOT_OPTYPE_BITS;
+    }
+}
+
+/**
+ * Add the execution counts of src into dst.
+ *
+ * @param dst the profile to update
+ * @param src the profile to add
+ */
+void hotspot_merge(PCMap *dst, const PCMap *src);
+
+/**
+ * Print the LAB1_HOT_* and LAB1_COVER_* sections of the report.
+ *
+ * @param counts the profile
+ * @param top_n the number of hottest PCs and ranges to list
+ */
+void hotspot_print(const PCMap *counts, uint32_t top_n);
+
+#endif
@@ -0,0 +1,271 @@
+// locality.cpp
+// Implements the instruction locality profiler.
+
+#include "locality.h"
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+LocalityProfile *locality_new(uint64_t window, bool reuse,
+                              unsigned int line_bits)
+{
+    LocalityProfile *lp =
+        (LocalityProfile *)calloc(1, sizeof(LocalityProfile));
+    lp->line_bits = line_bits;
+
+    lp->window = window;
+    if (window > 0)
+    {
+        lp->window_pcs = pcmap_new(PCSET_DEFAULT_CAPACITY);
+    }
+
+    lp->reuse = reuse;
+    if (reuse)
+    {
+        lp->last_fetch = pcmap_new(PCSET_DEFAULT_CAPACITY);
+        lp->tree_size = LOCALITY_MIN_TREE_SIZE;
+        lp->tree = (uint32_t *)calloc(lp->tree_size + 1, sizeof(uint32_t));
+    }
+    return lp;
+}
+
+void locality_free(LocalityProfile *lp)
+{
+    if (lp == NULL)
+    {
+        return;
+    }
+    pcmap_free(lp->window_pcs);
+    pcmap_free(lp->last_fetch);
+    free(lp->tree);
+    free(lp);
+}
+
+/**
+ * Add delta to the Fenwick tree at the given time.
+ */
+static inline void tree_add(LocalityProfile *lp, uint64_t time, int32_t delta)
+{
+    for (uint64_t i = time + 1; i <= lp->tree_size; i += i & -i)
+    {
+        lp->tree[i] += delta;
+    }
+}
+
+/**
+ * Get the sum of the Fenwick tree over the times before the given time.
+ */
+static inline uint64_t tree_prefix(const LocalityProfile *lp, uint64_t time)
+{
+    uint64_t sum = 0;
+    for (uint64_t i = time; i > 0; i -= i & -i)
+    {
+        sum += lp->tree[i];
+    }
+    return sum;
+}
+
+/**
+ * Renumber the last fetch times of all PCs to 0, 1, 2, ... in order, and
+ * rebuild the Fenwick tree with room for at least as many fetches again.
+ *
+ * Only the relative order of the last fetches matters for reuse distances, so
+ * this lets the tree stay proportional to the number of distinct PCs rather
+ * than the length of the trace.
+ */
+static void renumber(LocalityProfile *lp)
+{
+    PCMap *map = lp->last_fetch;
+    std::vector<uint64_t *> times;
+    times.reserve(pcmap_size(map));
+    for (uint64_t j = 0; j < map->capacity; j++)
+    {
+        if (map->slots[j].pc != 0)
+        {
+            times.push_back(&map->slots[j].value);
+        }
+    }
+    if (map->has_zero)
+    {
+        times.push_back(&map->zero.value);
+    }
+    std::sort(times.begin(), times.end(),
+              [](const uint64_t *a, const uint64_t *b) { return *a < *b; });
+
+    uint64_t num_pcs = times.size();
+    for (uint64_t i = 0; i < num_pcs; i++)
+    {
+        *times[i] = i;
+    }
+
+    // Every time below num_pcs now holds a 1. Build the tree in linear time
+    // by pushing each node's sum up to its parent.
+    lp->tree_size = std::max((uint64_t)LOCALITY_MIN_TREE_SIZE, 2 * num_pcs);
+    free(lp->tree);
+    lp->tree = (uint32_t *)calloc(lp->tree_size + 1, sizeof(uint32_t));
+    for (uint64_t i = 1; i <= lp->tree_size; i++)
+    {
+        if (i <= num_pcs)
+        {
+            lp->tree[i] += 1;
+        }
+        uint64_t parent = i + (i & -i);
+        if (parent <= lp->tree_size)
+        {
+            lp->tree[parent] += lp->tree[i];
+        }
+    }
+    lp->time = num_pcs;
+}
+
+/**
+ * Close the current working-set window.
+ */
+static void end_window(LocalityProfile *lp)
+{
+    if (lp->ws_num_windows == 0 || lp->window_unique < lp->ws_min)
+    {
+        lp->ws_min = lp->window_unique;
+    }
+    if (lp->window_unique > lp->ws_max)
+    {
+        lp->ws_max = lp->window_unique;
+    }
+    lp->ws_sum += lp->window_unique;
+    lp->ws_num_windows++;
+
+    lp->window_num++;
+    lp->window_fill = 0;
+    lp->window_unique = 0;
+}
+
+void locality_analyze(LocalityProfile *lp, const TraceRec *t, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        uint64_t addr = t[i].inst_addr >> lp->line_bits;
+        bool inserted;
+
+        if (lp->window > 0)
+        {
+            // Count each PC once per window.
+            uint64_t *last_window =
+                pcmap_upsert(lp->window_pcs, addr, &inserted);
+            if (*last_window != lp->window_num + 1)
+            {
+                *last_window = lp->window_num + 1;
+                lp->window_unique++;
+            }
+            if (++lp->window_fill == lp->window)
+            {
+                end_window(lp);
+            }
+        }
+
+        if (lp->reuse)
+        {
+            if (lp->time == lp->tree_size)
+            {
+                renumber(lp);
+            }
+
+            uint64_t *last_time = pcmap_upsert(lp->last_fetch, addr, &inserted);
+            if (inserted)
+            {
+                lp->reuse_cold++;
+            }
+            else
+            {
+                // The distinct PCs fetched since are exactly those whose last
+                // fetch falls between the two fetches of this PC.
+                uint64_t distance =
+                    tree_prefix(lp, lp->time) - tree_prefix(lp, *last_time + 1);
+                int bucket = distance == 0 ? 0 : 64 - __builtin_clzll(distance);
+                lp->reuse_hist[bucket]++;
+                tree_add(lp, *last_time, -1);
+            }
+            tree_add(lp, lp->time, 1);
+            *last_time = lp->time++;
+        }
+    }
+}
+
+void locality_print(LocalityProfile *lp)
+{
+    if (lp->line_bits > 0)
+    {
+        printf("LAB1_LOCALITY_LINE_SIZE \t : %10lu\n\n", 1UL << lp->line_bits);
+    }
+
+    if (lp->window > 0)
+    {
+        // A trace shorter than one window still reports its only window.
+        if (lp->ws_num_windows == 0 && lp->window_fill > 0)
+        {
+            end_window(lp);
+        }
+        double ws_avg = 0.0;
+        if (lp->ws_num_windows > 0)
+        {
+            ws_avg = (double)lp->ws_sum / (double)lp->ws_num_windows;
+        }
+
+        // With -linesize, what is counted is lines rather than PCs.
+        const char *unit = lp->line_bits > 0 ? "LINES" : "PC";
+        char name[32];
+        printf("LAB1_WS_WINDOW_INST     \t : %10lu\n", lp->window);
+        printf("LAB1_WS_NUM_WINDOWS     \t : %10lu\n", lp->ws_num_windows);
+        snprintf(name, sizeof(name), "LAB1_WS_MIN_UNIQUE_%s", unit);
+        printf("%-24s\t : %10lu\n", name, lp->ws_min);
+        snprintf(name, sizeof(name), "LAB1_WS_AVG_UNIQUE_%s", unit);
+        printf("%-24s\t : %12.1f\n", name, ws_avg);
+        snprintf(name, sizeof(name), "LAB1_WS_MAX_UNIQUE_%s", unit);
+        printf("%-24s\t : %10lu\n\n", name, lp->ws_max);
+    }
+
+    if (lp->reuse)
+    {
+        uint64_t num_fetches = lp->reuse_cold;
+        int last_bucket = 0;
+        for (int b = 0; b < LOCALITY_NUM_BUCKETS; b++)
+        {
+            num_fetches += lp->reuse_hist[b];
+            if (lp->reuse_hist[b] > 0)
+            {
+                last_bucket = b;
+            }
+        }
+        if (num_fetches == 0)
+        {
+            num_fetches = 1; // Avoid division by zero.
+        }
+
+        // The cumulative percentage of bucket b is the hit rate of a fully
+        // associative LRU cache holding 2^b PCs, or lines with -linesize.
+        printf("LAB1_REUSE_COLD         \t : %10lu\n", lp->reuse_cold);
+        uint64_t cumulative = 0;
+        for (int b = 0; b <= last_bucket; b++)
+        {
+            char range[48];
+            if (b == 0)
+            {
+                snprintf(range, sizeof(range), "0");
+            }
+            else if (b == 1)
+            {
+                snprintf(range, sizeof(range), "1");
+            }
+            else
+            {
+                snprintf(range, sizeof(range), "%lu-%lu", 1UL << (b - 1),
+                         (b == 64) ? ~0UL : (1UL << b) - 1);
+            }
+            cumulative += lp->reuse_hist[b];
+            printf("LAB1_REUSE_DIST_%-8s\t : %10lu  %7.3f%%\n", range,
+                   lp->reuse_hist[b],
+                   100.0 * (double)cumulative / (double)num_fetches);
+        }
+        printf("\n");
+    }
+}
@@ -0,0 +1,125 @@
+// locality.h
+// Declares the instruction locality profiler: the working set of the trace
+// over fixed windows of instructions, and the reuse (LRU stack) distance of
+// every instruction fetch.
+//
+// The reuse distance of a fetch is the number of distinct PCs fetched since
+// the last fetch of the same PC. A fully associative LRU cache holding C PCs
+// hits exactly the fetches with a reuse distance below C, so the cumulative
+// histogram gives the hit rate of every cache size at once.
+//
+// Both need the records in trace order, so unlike TraceStats a profile cannot
+// be split across threads and merged.
+
+#ifndef _LOCALITY_H_
+#define _LOCALITY_H_
+
+#include "pcmap.h"
+#include "trace.h"
+#include <inttypes.h>
+#include <stddef.h>
+
+/**
+ * The number of reuse distance buckets. Bucket 0 holds distance 0, and bucket
+ * b > 0 holds distances 2^(b-1) to 2^b - 1.
+ */
+#define LOCALITY_NUM_BUCKETS 65
+
+/** The smallest number of positions the Fenwick tree is given. */
+#define LOCALITY_MIN_TREE_SIZE (1 << 16)
+
+/** The locality profile of a trace. */
+typedef struct LocalityProfile
+{
+    /**
+     * The number of low PC bits dropped before profiling, e.g. 6 to profile
+     * 64-byte cache lines instead of individual PCs.
+     */
+    unsigned int line_bits;
+
+    /** The number of instructions per working-set window, or 0 if disabled. */
+    uint64_t window;
+
+    /** Maps each PC to 1 + the number of the last window it was fetched in. */
+    PCMap *window_pcs;
+
+    /** The number of instructions in the current window so far. */
+    uint64_t window_fill;
+
+    /** The number of the current window. */
+    uint64_t window_num;
+
+    /** The number of distinct PCs in the current window so far. */
+    uint64_t window_unique;
+
+    /** The number of complete windows. */
+    uint64_t ws_num_windows;
+
+    /** The smallest, largest, and total number of distinct PCs per window. */
+    uint64_t ws_min;
+    uint64_t ws_max;
+    uint64_t ws_sum;
+
+    /** Whether the reuse distance profile is enabled. */
+    bool reuse;
+
+    /** Maps each PC to the time of its last fetch. */
+    PCMap *last_fetch;
+
+    /**
+     * A Fenwick tree over fetch times with a 1 at the time of the last fetch
+     * of every PC, so the number of 1s between two times is the number of
+     * distinct PCs fetched in between. 1-based, with tree_size positions.
+     */
+    uint32_t *tree;
+
+    /** The number of positions in tree. */
+    uint64_t tree_size;
+
+    /** The time of the next fetch. Times are renumbered when tree fills up. */
+    uint64_t time;
+
+    /** The number of first fetches of a PC, which have no reuse distance. */
+    uint64_t reuse_cold;
+
+    /** The number of fetches in each reuse distance bucket. */
+    uint64_t reuse_hist[LOCALITY_NUM_BUCKETS];
+} LocalityProfile;
+
+/**
+ * Allocate and initialize an empty locality profile.
+ *
+ * @param window the number of instructions per working-set window, or 0 to
+ *               skip the working set
+ * @param reuse whether to profile reuse distances
+ * @param line_bits the number of low PC bits to drop
+ * @return a pointer to a newly allocated profile
+ */
+LocalityProfile *locality_new(uint64_t window, bool reuse,
+                              unsigned int line_bits);
+
+/**
+ * Free a locality profile.
+ *
+ * @param lp the profile to free
+ */
+void locality_free(LocalityProfile *lp);
+
+/**
+ * Update a locality profile with the next batch of trace records, in trace
+ * order.
+ *
+ * @param lp the profile to update
+ * @param t the first trace record of the batch
+ * @param n the number of records in the batch
+ */
+void locality_analyze(LocalityProfile *lp, const TraceRec *t, size_t n);
+
+/**
+ * Print the LAB1_WS_* and LAB1_REUSE_* sections of the report.
+ *
+ * @param lp the profile
+ */
+void locality_print(LocalityProfile *lp);
+
+#endif
@@ -0,0 +1,306 @@
+// optypehist.cpp
+// Implements the kernels that count trace records by op type.
+
+#include "optypehist.h"
+#include <string.h>
+
+#if defined(__x86_64__)
+#define OPTYPEHIST_X86 1
+#include <immintrin.h>
+#endif
+
+static_assert(sizeof(TraceRec) == 16 && offsetof(TraceRec, optype) == 8,
+              "the vector kernels assume 16-byte records with optype at byte 8");
+
+/**
+ * Count a batch of trace records by op type, one record at a time.
+ *
+ * @param t the first trace record of the batch
+ * @param n the number of records in the batch
+ * @param hist incremented by the number of records of each op type
+ */
+static void count_scalar(const TraceRec *t, size_t n, uint64_t *hist)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        hist[t[i].optype]++;
+    }
+}
+
+#ifdef OPTYPEHIST_X86
+
+/**
+ * The number of vectors of optypes that can be counted before the 8-bit
+ * per-lane counters have to be flushed into hist.
+ */
+#define MAX_INNER_ITERS 255
+
+// Both vector kernels gather optypes the same way. A record is two 64-bit
+// words with the optype in the low byte of the second one, so unpacking the
+// high words of two vectors of records gives a vector with one optype per
+// word. Masking off the padding and shifting the vector from each of 8 such
+// unpacks into a different byte packs one optype into every byte. Comparing
+// that against each op type gives -1 per match, which is subtracted into
+// 8-bit counters that are summed into hist before they can overflow.
+
+/**
+ * Gather the optypes of the 2 records at p into the low byte of each word.
+ */
+__attribute__((target("sse4.1")))
+static inline __m128i gather_sse4(const uint8_t *p, __m128i low_byte)
+{
+    __m128i a = _mm_loadu_si128((const __m128i *)p);
+    __m128i b = _mm_loadu_si128((const __m128i *)(p + 16));
+    return _mm_and_si128(_mm_unpackhi_epi64(a, b), low_byte);
+}
+
+/** Add the number of bytes equal to k in ops to the 8-bit counters acc. */
+__attribute__((target("sse4.1")))
+static inline __m128i count_sse4_k(__m128i acc, __m128i ops, int k)
+{
+    return _mm_sub_epi8(acc, _mm_cmpeq_epi8(ops, _mm_set1_epi8(k)));
+}
+
+/** Sum the 8-bit counters acc. */
+__attribute__((target("sse4.1")))
+static inline uint64_t sum_sse4(__m128i acc)
+{
+    __m128i sums = _mm_sad_epu8(acc, _mm_setzero_si128());
+    return _mm_cvtsi128_si64(sums) + _mm_extract_epi64(sums, 1);
+}
+
+/**
+ * Count a batch of trace records by op type, 16 records at a time.
+ *
+ * @param t the first trace record of the batch
+ * @param n the number of records in the batch
+ * @param hist incremented by the number of records of each op type
+ */
+__attribute__((target("sse4.1")))
+static void count_sse4(const TraceRec *t, size_t n, uint64_t *hist)
+{
+    const uint8_t *p = (const uint8_t *)t;
+    const __m128i low_byte = _mm_set1_epi64x(0xFF);
+
+    size_t i = 0;
+    while (n - i >= 16)
+    {
+        size_t iters = (n - i) / 16;
+        if (iters > MAX_INNER_ITERS)
+        {
+            iters = MAX_INNER_ITERS;
+        }
+
+        __m128i acc0 = _mm_setzero_si128();
+        __m128i acc1 = _mm_setzero_si128();
+        __m128i acc2 = _mm_setzero_si128();
+        __m128i acc3 = _mm_setzero_si128();
+        __m128i acc4 = _mm_setzero_si128();
+        for (size_t it = 0; it < iters; it++, i += 16, p += 16 * 16)
+        {
+            __m128i ops = gather_sse4(p, low_byte);
+            ops = _mm_or_si128(ops, _mm_slli_epi64(gather_sse4(p + 32, low_byte), 8));
+            ops = _mm_or_si128(ops, _mm_slli_epi64(gather_sse4(p + 64, low_byte), 16));
+            ops = _mm_or_si128(ops, _mm_slli_epi64(gather_sse4(p + 96, low_byte), 24));
+            ops = _mm_or_si128(ops, _mm_slli_epi64(gather_sse4(p + 128, low_byte), 32));
+            ops = _mm_or_si128(ops, _mm_slli_epi64(gather_sse4(p + 160, low_byte), 40));
+            ops = _mm_or_si128(ops, _mm_slli_epi64(gather_sse4(p + 192, low_byte), 48));
+            ops = _mm_or_si128(ops, _mm_slli_epi64(gather_sse4(p + 224, low_byte), 56));
+
+            acc0 = count_sse4_k(acc0, ops, OP_ALU);
+            acc1 = count_sse4_k(acc1, ops, OP_LD);
+            acc2 = count_sse4_k(acc2, ops, OP_ST);
+            acc3 = count_sse4_k(acc3, ops, OP_CBR);
+            acc4 = count_sse4_k(acc4, ops, OP_OTHER);
+        }
+
+        hist[OP_ALU] += sum_sse4(acc0);
+        hist[OP_LD] += sum_sse4(acc1);
+        hist[OP_ST] += sum_sse4(acc2);
+        hist[OP_CBR] += sum_sse4(acc3);
+        hist[OP_OTHER] += sum_sse4(acc4);
+    }
+
+    count_scalar(t + i, n - i, hist);
+}
+
+/**
+ * Gather the optypes of the 4 records at p into the low byte of each word.
+ */
+__attribute__((target("avx2")))
+static inline __m256i gather_avx2(const uint8_t *p, __m256i low_byte)
+{
+    __m256i a = _mm256_loadu_si256((const __m256i *)p);
+    __m256i b = _mm256_loadu_si256((const __m256i *)(p + 32));
+    return _mm256_and_si256(_mm256_unpackhi_epi64(a, b), low_byte);
+}
+
+/** Add the number of bytes equal to k in ops to the 8-bit counters acc. */
+__attribute__((target("avx2")))
+static inline __m256i count_avx2_k(__m256i acc, __m256i ops, int k)
+{
+    return _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(ops, _mm256_set1_epi8(k)));
+}
+
+/** Sum the 8-bit counters acc. */
+__attribute__((target("avx2")))
+static inline uint64_t sum_avx2(__m256i acc)
+{
+    __m256i sums = _mm256_sad_epu8(acc, _mm256_setzero_si256());
+    return _mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1) +
+           _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3);
+}
+
+/**
+ * Count a batch of trace records by op type, 32 records at a time.
+ *
+ * @param t the first trace record of the batch
+ * @param n the number of records in the batch
+ * @param hist incremented by the number of records of each op type
+ */
+__attribute__((target("avx2")))
+static void count_avx2(const TraceRec *t, size_t n, uint64_t *hist)
+{
+    const uint8_t *p = (const uint8_t *)t;
+    const __m256i low_byte = _mm256_set1_epi64x(0xFF);
+
+    size_t i = 0;
+    while (n - i >= 32)
+    {
+        size_t iters = (n - i) / 32;
+        if (iters > MAX_INNER_ITERS)
+        {
+            iters = MAX_INNER_ITERS;
+        }
+
+        __m256i acc0 = _mm256_setzero_si256();
+        __m256i acc1 = _mm256_setzero_si256();
+        __m256i acc2 = _mm256_setzero_si256();
+        __m256i acc3 = _mm256_setzero_si256();
+        __m256i acc4 = _mm256_setzero_si256();
+        for (size_t it = 0; it < iters; it++, i += 32, p += 32 * 16)
+        {
+            __m256i ops = gather_avx2(p, low_byte);
+            ops = _mm256_or_si256(ops, _mm256_slli_epi64(gather_avx2(p + 64, low_byte), 8));
+            ops = _mm256_or_si256(ops, _mm256_slli_epi64(gather_avx2(p + 128, low_byte), 16));
+            ops = _mm256_or_si256(ops, _mm256_slli_epi64(gather_avx2(p + 192, low_byte), 24));
+            ops = _mm256_or_si256(ops, _mm256_slli_epi64(gather_avx2(p + 256, low_byte), 32));
+            ops = _mm256_or_si256(ops, _mm256_slli_epi64(gather_avx2(p + 320, low_byte), 40));
+            ops = _mm256_or_si256(ops, _mm256_slli_epi64(gather_avx2(p + 384, low_byte), 48));
+            ops = _mm256_or_si256(ops, _mm256_slli_epi64(gather_avx2(p + 448, low_byte), 56));
+
+            acc0 = count_avx2_k(acc0, ops, OP_ALU);
+            acc1 = count_avx2_k(acc1, ops, OP_LD);
+            acc2 = count_avx2_k(acc2, ops, OP_ST);
+            acc3 = count_avx2_k(acc3, ops, OP_CBR);
+            acc4 = count_avx2_k(acc4, ops, OP_OTHER);
+        }
+
+        hist[OP_ALU] += sum_avx2(acc0);
+        hist[OP_LD] += sum_avx2(acc1);
+        hist[OP_ST] += sum_avx2(acc2);
+        hist[OP_CBR] += sum_avx2(acc3);
+        hist[OP_OTHER] += sum_avx2(acc4);
+    }
+
+    count_scalar(t + i, n - i, hist);
+}
+
+static bool has_sse4()
+{
+    return __builtin_cpu_supports("sse4.1");
+}
+
+static bool has_avx2()
+{
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif
+
+static bool has_scalar()
+{
+    return true;
+}
+
+/** A kernel for optypehist_count(). */
+typedef struct OpHistKernel
+{
+    /** The name used to select the kernel. */
+    const char *name;
+
+    /** The function that counts records. */
+    void (*count)(const TraceRec *t, size_t n, uint64_t *hist);
+
+    /** Whether this CPU can run the kernel. */
+    bool (*supported)();
+} OpHistKernel;
+
+/** Every kernel, fastest first. */
+static const OpHistKernel kernels[] = {
+#ifdef OPTYPEHIST_X86
+    {"avx2", count_avx2, has_avx2},
+    {"sse4", count_sse4, has_sse4},
+#endif
+    {"scalar", count_scalar, has_scalar},
+};
+
+#define NUM_KERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+/**
+ * Find the fastest kernel this CPU supports.
+ *
+ * @return the kernel
+ */
+static const OpHistKernel *best_kernel()
+{
+#ifdef OPTYPEHIST_X86
+    // Needed since this can run before main(), during static initialization.
+    __builtin_cpu_init();
+#endif
+    for (size_t i = 0; i < NUM_KERNELS; i++)
+    {
+        if (kernels[i].supported())
+        {
+            return &kernels[i];
+        }
+    }
+    return &kernels[NUM_KERNELS - 1];
+}
+
+/** The kernel used by optypehist_count(). */
+static const OpHistKernel *kernel = best_kernel();
+
+bool optypehist_select(const char *name)
+{
+    if (strcmp(name, "auto") == 0)
+    {
+        kernel = best_kernel();
+        return true;
+    }
+
+    for (size_t i = 0; i < NUM_KERNELS; i++)
+    {
+        if (strcmp(name, kernels[i].name) == 0)
+        {
+            if (!kernels[i].supported())
+            {
+                return false;
+            }
+            kernel = &kernels[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *optypehist_kernel_name()
+{
+    return kernel->name;
+}
+
+void optypehist_count(const TraceRec *t, size_t n,
+                      uint64_t hist[NUM_OP_TYPES])
+{
+    kernel->count(t, n, hist);
+}
@@ -0,0 +1,44 @@
+// optypehist.h
+// Declares the kernels that count trace records by op type.
+//
+// The scalar kernel works everywhere. On x86, SSE4 and AVX2 kernels gather the
+// optype byte of many records at once and count them with vector compares.
+// The kernel is picked at run time from what the CPU supports, or forced with
+// optypehist_select().
+
+#ifndef _OPTYPEHIST_H_
+#define _OPTYPEHIST_H_
+
+#include "trace.h"
+#include <inttypes.h>
+#include <stddef.h>
+
+/**
+ * Choose the kernel used by optypehist_count().
+ *
+ * @param name one of "auto", "scalar", "sse4", or "avx2"
+ * @return true on success, false if the name is unknown or the CPU does not
+ *         support that kernel
+ */
+bool optypehist_select(const char *name);
+
+/**
+ * Get the name of the kernel used by optypehist_count().
+ *
+ * @return the name of the kernel, e.g. "avx2"
+ */
+const char *optypehist_kernel_name();
+
+/**
+ * Count a batch of trace records by op type.
+ *
+ * Every record must have an optype less than NUM_OP_TYPES.
+ *
+ * @param t the first trace record of the batch
+ * @param n the number of records in the batch
+ * @param hist incremented by the number of records of each op type
+ */
+void optypehist_count(const TraceRec *t, size_t n,
+                      uint64_t hist[NUM_OP_TYPES]);
+
+#endif
@@ -0,0 +1,88 @@
+// pcmap.cpp
+// Implements the flat open-addressing PC map.
+
+#include "pcmap.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Allocate and initialize an empty PC map.
+ *
+ * @param capacity the initial number of slots, rounded up to a power of two
+ * @return a pointer to a newly allocated PC map
+ */
+PCMap *pcmap_new(uint64_t capacity)
+{
+    PCMap *map = (PCMap *)calloc(1, sizeof(PCMap));
+
+    map->capacity = 16;
+    map->capacity_bits = 4;
+    while (map->capacity < capacity)
+    {
+        map->capacity <<= 1;
+        map->capacity_bits++;
+    }
+
+    map->slots = (PCMapEntry *)calloc(map->capacity, sizeof(PCMapEntry));
+    if (map->slots == NULL)
+    {
+        fprintf(stderr, "Error: out of memory allocating PC map\n");
+        exit(1);
+    }
+    return map;
+}
+
+/**
+ * Free a PC map and its table.
+ *
+ * @param map the PC map to free
+ */
+void pcmap_free(PCMap *map)
+{
+    if (map == NULL)
+    {
+        return;
+    }
+    free(map->slots);
+    free(map);
+}
+
+/**
+ * Double the number of slots of a PC map and rehash every entry into the new
+ * table.
+ *
+ * @param map the PC map to grow
+ */
+void pcmap_grow(PCMap *map)
+{
+    uint64_t old_capacity = map->capacity;
+    PCMapEntry *old_slots = map->slots;
+
+    map->capacity <<= 1;
+    map->capacity_bits++;
+    map->slots = (PCMapEntry *)calloc(map->capacity, sizeof(PCMapEntry));
+    if (map->slots == NULL)
+    {
+        fprintf(stderr, "Error: out of memory growing PC map to %lu slots\n",
+                (unsigned long)map->capacity);
+        exit(1);
+    }
+
+    uint64_t mask = map->capacity - 1;
+    for (uint64_t j = 0; j < old_capacity; j++)
+    {
+        if (old_slots[j].pc == 0)
+        {
+            continue;
+        }
+
+        uint64_t i = pcset_hash(old_slots[j].pc, map->capacity_bits);
+        while (map->slots[i].pc != 0)
+        {
+            i = (i + 1) & mask;
+        }
+        map->slots[i] = old_slots[j];
+    }
+
+    free(old_slots);
+}
@@ -0,0 +1,133 @@
+// pcmap.h
+// Declares a flat open-addressing hash map from instruction addresses (PCs) to
+// 64-bit values.
+//
+// This is the map counterpart of PCSet (see pcset.h), and uses the same
+// table layout and hash.
+
+#ifndef _PCMAP_H_
+#define _PCMAP_H_
+
+#include "pcset.h"
+#include <inttypes.h>
+#include <stddef.h>
+
+/** A slot of a PC map. */
+typedef struct PCMapEntry
+{
+    /** The PC, or 0 if the slot is empty. */
+    uint64_t pc;
+
+    /** The value stored for the PC. */
+    uint64_t value;
+} PCMapEntry;
+
+/**
+ * A map from PCs to 64-bit values, stored in a single power-of-two sized
+ * array of slots and resolved with linear probing.
+ *
+ * The PC 0 marks an empty slot. Since 0 can still be a legal PC, its entry is
+ * kept separately in zero rather than stored in the table.
+ */
+typedef struct PCMap
+{
+    /** The slots of the table. */
+    PCMapEntry *slots;
+
+    /** The number of slots in the table. Always a power of two. */
+    uint64_t capacity;
+
+    /** log2(capacity), used to take the top bits of the hash as the index. */
+    unsigned int capacity_bits;
+
+    /** The number of non-zero PCs stored in slots. */
+    uint64_t count;
+
+    /** Whether the PC 0 is in the map. */
+    bool has_zero;
+
+    /** The entry for the PC 0, if has_zero is set. */
+    PCMapEntry zero;
+} PCMap;
+
+/**
+ * Allocate and initialize an empty PC map.
+ *
+ * @param capacity the initial number of slots, rounded up to a power of two
+ * @return a pointer to a newly allocated PC map
+ */
+PCMap *pcmap_new(uint64_t capacity);
+
+/**
+ * Free a PC map and its table.
+ *
+ * @param map the PC map to free
+ */
+void pcmap_free(PCMap *map);
+
+/**
+ * Double the number of slots of a PC map and rehash every entry into the new
+ * table.
+ *
+ * This is called automatically by pcmap_upsert() when the table is about to
+ * become 3/4 full; you should not need to call it directly.
+ *
+ * @param map the PC map to grow
+ */
+void pcmap_grow(PCMap *map);
+
+/**
+ * Find the value stored for a PC, adding the PC with a value of 0 if it is not
+ * in the map yet.
+ *
+ * @param map the PC map
+ * @param pc the PC to look up
+ * @param inserted set to whether the PC was added
+ * @return a pointer to the value, valid until the next call to pcmap_upsert()
+ */
+static inline uint64_t *pcmap_upsert(PCMap *map, uint64_t pc, bool *inserted)
+{
+    if (pc == 0)
+    {
+        *inserted = !map->has_zero;
+        map->has_zero = true;
+        return &map->zero.value;
+    }
+
+    // Grow first, so that the pointer returned stays valid.
+    if ((map->count + 1) * 4 >= map->capacity * 3)
+    {
+        pcmap_grow(map);
+    }
+
+    uint64_t mask = map->capacity - 1;
+    uint64_t i = pcset_hash(pc, map->capacity_bits);
+    while (map->slots[i].pc != 0)
+    {
+        if (map->slots[i].pc == pc)
+        {
+            *inserted = false;
+            return &map->slots[i].value;
+        }
+        i = (i + 1) & mask;
+    }
+
+    map->slots[i].pc = pc;
+    map->slots[i].value = 0;
+    map->count++;
+    *inserted = true;
+    return &map->slots[i].value;
+}
+
+/**
+ * Get the number of PCs in the map.
+ *
+ * @param map the PC map
+ * @return the number of PCs in the map
+ */
+static inline uint64_t pcmap_size(const PCMap *map)
+{
+    return map->count + (map->has_zero ? 1 : 0);
+}
+
+#endif
@@ -0,0 +1,110 @@
+// pcset.cpp
+// Implements the flat open-addressing PC set.
+
+#include "pcset.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Allocate and initialize an empty PC set.
+ *
+ * @param capacity the initial number of slots, rounded up to a power of two
+ * @return a pointer to a newly allocated PC set
+ */
+PCSet *pcset_new(uint64_t capacity)
+{
+    PCSet *set = (PCSet *)calloc(1, sizeof(PCSet));
+
+    set->capacity = 16;
+    set->capacity_bits = 4;
+    while (set->capacity < capacity)
+    {
+        set->capacity <<= 1;
+        set->capacity_bits++;
+    }
+
+    set->slots = (uint64_t *)calloc(set->capacity, sizeof(uint64_t));
+    if (set->slots == NULL)
+    {
+        fprintf(stderr, "Error: out of memory allocating PC set\n");
+        exit(1);
+    }
+    return set;
+}
+
+/**
+ * Free a PC set and its table.
+ *
+ * @param set the PC set to free
+ */
+void pcset_free(PCSet *set)
+{
+    if (set == NULL)
+    {
+        return;
+    }
+    free(set->slots);
+    free(set);
+}
+
+/**
+ * Double the number of slots of a PC set and rehash every PC into the new
+ * table.
+ *
+ * @param set the PC set to grow
+ */
+void pcset_grow(PCSet *set)
+{
+    uint64_t old_capacity = set->capacity;
+    uint64_t *old_slots = set->slots;
+
+    set->capacity <<= 1;
+    set->capacity_bits++;
+    set->slots = (uint64_t *)calloc(set->capacity, sizeof(uint64_t));
+    if (set->slots == NULL)
+    {
+        fprintf(stderr, "Error: out of memory growing PC set to %lu slots\n",
+                (unsigned long)set->capacity);
+        exit(1);
+    }
+
+    uint64_t mask = set->capacity - 1;
+    for (uint64_t j = 0; j < old_capacity; j++)
+    {
+        uint64_t pc = old_slots[j];
+        if (pc == 0)
+        {
+            continue;
+        }
+
+        uint64_t i = pcset_hash(pc, set->capacity_bits);
+        while (set->slots[i] != 0)
+        {
+            i = (i + 1) & mask;
+        }
+        set->slots[i] = pc;
+    }
+
+    free(old_slots);
+}
+
+/**
+ * Add every PC in src to dst.
+ *
+ * @param dst the PC set to add to
+ * @param src the PC set to add from
+ */
+void pcset_merge(PCSet *dst, const PCSet *src)
+{
+    if (src->has_zero)
+    {
+        pcset_insert(dst, 0);
+    }
+    for (uint64_t j = 0; j < src->capacity; j++)
+    {
+        if (src->slots[j] != 0)
+        {
+            pcset_insert(dst, src->slots[j]);
+        }
+    }
+}
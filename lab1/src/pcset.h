@@ -0,0 +1,161 @@
+// pcset.h
+// Declares a flat open-addressing hash set of instruction addresses (PCs).
+
+#ifndef _PCSET_H_
+#define _PCSET_H_
+
+#include <inttypes.h>
+#include <stddef.h>
+
+/**
+ * The number of slots a newly created PC set starts with if no capacity is
+ * given. Must be a power of two.
+ */
+#define PCSET_DEFAULT_CAPACITY 4096
+
+/**
+ * A set of PCs, stored in a single power-of-two sized array of slots and
+ * resolved with linear probing.
+ *
+ * The value 0 marks an empty slot. Since 0 can still be a legal PC, it is
+ * tracked separately in has_zero rather than stored in the table.
+ */
+typedef struct PCSet
+{
+    /** The slots of the table. An empty slot holds 0. */
+    uint64_t *slots;
+
+    /** The number of slots in the table. Always a power of two. */
+    uint64_t capacity;
+
+    /** log2(capacity), used to take the top bits of the hash as the index. */
+    unsigned int capacity_bits;
+
+    /** The number of non-zero PCs stored in slots. */
+    uint64_t count;
+
+    /** Whether the PC 0 is a member of the set. */
+    bool has_zero;
+} PCSet;
+
+/**
+ * Allocate and initialize an empty PC set.
+ *
+ * @param capacity the initial number of slots, rounded up to a power of two
+ * @return a pointer to a newly allocated PC set
+ */
+PCSet *pcset_new(uint64_t capacity);
+
+/**
+ * Free a PC set and its table.
+ *
+ * @param set the PC set to free
+ */
+void pcset_free(PCSet *set);
+
+/**
+ * Double the number of slots of a PC set and rehash every PC into the new
+ * table.
+ *
+ * This is called automatically by pcset_insert() once the table is 3/4 full;
+ * you should not need to call it directly.
+ *
+ * @param set the PC set to grow
+ */
+void pcset_grow(PCSet *set);
+
+/**
+ * Add every PC in src to dst.
+ *
+ * @param dst the PC set to add to
+ * @param src the PC set to add from
+ */
+void pcset_merge(PCSet *dst, const PCSet *src);
+
+/**
+ * Get the home slot of a PC in a table with 2^bits slots.
+ *
+ * Uses Fibonacci hashing: PCs are mostly small, densely packed multiples of
+ * the instruction size, so the multiplicative hash spreads their low bits
+ * into the top bits that we keep.
+ */
+static inline uint64_t pcset_hash(uint64_t pc, unsigned int bits)
+{
+    return (pc * 0x9E3779B97F4A7C15ULL) >> (64 - bits);
+}
+
+/**
+ * Add a PC to the set.
+ *
+ * @param set the PC set
+ * @param pc the PC to add
+ * @return true if the PC was not already in the set, false otherwise
+ */
+static inline bool pcset_insert(PCSet *set, uint64_t pc)
+{
+    if (pc == 0)
+    {
+        bool inserted = !set->has_zero;
+        set->has_zero = true;
+        return inserted;
+    }
+
+    uint64_t mask = set->capacity - 1;
+    uint64_t i = pcset_hash(pc, set->capacity_bits);
+    while (set->slots[i] != 0)
+    {
+        if (set->slots[i] == pc)
+        {
+            return false;
+        }
+        i = (i + 1) & mask;
+    }
+
+    set->slots[i] = pc;
+    set->count++;
+    if (set->count * 4 >= set->capacity * 3)
+    {
+        pcset_grow(set);
+    }
+    return true;
+}
+
+/**
+ * Check whether a PC is in the set.
+ *
+ * @param set the PC set
+ * @param pc the PC to look for
+ * @return true if the PC is in the set, false otherwise
+ */
+static inline bool pcset_contains(const PCSet *set, uint64_t pc)
+{
+    if (pc == 0)
+    {
+        return set->has_zero;
+    }
+
+    uint64_t mask = set->capacity - 1;
+    uint64_t i = pcset_hash(pc, set->capacity_bits);
+    while (set->slots[i] != 0)
+    {
+        if (set->slots[i] == pc)
+        {
+            return true;
+        }
+        i = (i + 1) & mask;
+    }
+    return false;
+}
+
+/**
+ * Get the number of distinct PCs in the set.
+ *
+ * @param set the PC set
+ * @return the number of PCs in the set
+ */
+static inline uint64_t pcset_size(const PCSet *set)
+{
+    return set->count + (set->has_zero ? 1 : 0);
+}
+
+#endif
@@ -6,11 +6,34 @@
 // Reads and analyzes a CPU trace file for ECE 4100/6100.
 // Author: Rishov Sarkar
 
+#include "coltrace.h"
+#include "cpimodel.h"
+#include "locality.h"
+#include "optypehist.h"
 #include "trace.h"
+#include "tracefile.h"
+#include "tracestats.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <stdio.h>
-#include <sys/types.h>
-#include <sys/wait.h>
-#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <time.h>
+#include <vector>
+
+/**
+ * The number of trace records read from the trace file per block, i.e. the
+ * largest batch passed to analyze_trace_batch(). 65536 records is 1 MiB.
+ */
+#define TRACE_BUF_RECS 65536
+
+static_assert(TRACE_BUF_RECS % COLTRACE_BLOCK_RECS == 0,
+              "columnar traces are read whole blocks at a time");
+
+/** The maximum number of worker threads that can be requested. */
+#define MAX_THREADS 256
 
 /** Total number of instructions executed. Updated in this file. */
 extern uint64_t stat_num_inst;
@@ -37,98 +60,613 @@ extern uint64_t stat_num_cycle;
  */
 extern uint64_t stat_unique_pc;
 
-int read_trace(int fd);
+/**
+ * The statistics of every record analyzed so far. Defined in studentwork.cpp.
+ */
+extern TraceStats *trace_stats;
+
+/**
+ * A Boolean indicating whether the trace file should be decompressed by an
+ * external gunzip process instead of in-process with zlib.
+ *
+ * Set by the command-line argument -gunzip.
+ */
+uint32_t USE_GUNZIP = 0;
+
+/**
+ * The number of worker threads that analyze blocks of the trace. With 1, the
+ * trace is analyzed on the main thread as it is read.
+ *
+ * Set by the command-line argument -threads.
+ */
+uint32_t NUM_THREADS = 1;
+
+/**
+ * A Boolean indicating whether CPI models were given, in which case the cycles
+ * and CPI under every model are reported.
+ *
+ * Set by the command-line arguments -cpi and -cpifile.
+ */
+uint32_t CPI_MODELS_GIVEN = 0;
+
+/**
+ * The number of instructions per working-set window, or 0 to skip the
+ * working-set profile.
+ *
+ * Set by the command-line argument -wswindow.
+ */
+uint64_t WS_WINDOW = 0;
+
+/**
+ * A Boolean indicating whether to profile PC reuse distances.
+ *
+ * Set by the command-line argument -reuse.
+ */
+uint32_t PROFILE_REUSE = 0;
+
+/**
+ * The number of bytes of PC grouped together by the working-set and reuse
+ * distance profiles, e.g. the I-cache line size. Always a power of two.
+ *
+ * Set by the command-line argument -linesize.
+ */
+uint32_t LINE_SIZE = 1;
+
+/**
+ * How the number of unique PCs is counted: exactly, estimated with a
+ * HyperLogLog sketch, or both.
+ *
+ * Set by the command-line argument -uniquepc.
+ */
+UniquePCMode UNIQUE_PC_MODE = UNIQUE_PC_EXACT;
+
+/**
+ * log2 of the number of registers of the HyperLogLog sketch.
+ *
+ * Set by the command-line argument -hllprecision.
+ */
+uint32_t HLL_PRECISION = HLL_DEFAULT_PRECISION;
+
+/**
+ * The number of hottest PCs and PC ranges to report, or 0 to skip the
+ * hot-spot profile.
+ *
+ * Set by the command-line argument -hotspots.
+ */
+uint32_t HOTSPOT_TOP_N = 0;
+
+/**
+ * The locality profile of the trace, or NULL if neither -wswindow nor -reuse
+ * was given. Always updated on the thread reading the trace, since it needs
+ * the records in order.
+ */
+LocalityProfile *locality = NULL;
+
+/** Number of read() system calls issued on the trace file. */
+uint64_t stat_read_syscalls = 0;
+
+/** Number of decompressed bytes read from the trace file. */
+uint64_t stat_read_bytes = 0;
+
+/** Wall-clock time spent reading and analyzing the trace, in seconds. */
+double stat_read_seconds = 0.0;
+
+/**
+ * An open trace file: either a gzip-compressed trace, or a columnar trace
+ * created by trace2col. Exactly one of the two is non-NULL.
+ */
+typedef struct TraceInput
+{
+    TraceFile *tf;
+    ColTrace *ct;
+} TraceInput;
+
+int parse_args(int argc, char *argv[], char **trace_filename);
+int read_trace(TraceInput *in);
+int read_trace_parallel(TraceInput *in);
 void print_stats();
+void print_usage(char *program_name);
 
 int main(int argc, char *argv[])
 {
     int status;
+    struct timespec start, end;
 
-    if (argc != 2)
+    // Parse the command-line arguments.
+    char *trace_filename = NULL;
+    status = parse_args(argc, argv, &trace_filename);
+    if (status != 0)
     {
-        fprintf(stderr, "Usage: %s <trace file>\n", argv[0]);
-        return 2;
+        return status;
     }
 
-    // Open the trace file using gunzip.
-    // Uses the traditional pipe/fork/exec method.
-    printf("Opening trace file with gunzip: %s\n", argv[1]);
+    if (WS_WINDOW > 0 || PROFILE_REUSE)
+    {
+        locality = locality_new(WS_WINDOW, PROFILE_REUSE,
+                                __builtin_ctz(LINE_SIZE));
+    }
 
-    int pipefd[2];
-    status = pipe(pipefd);
-    if (status != 0)
+    // Open the trace file.
+    TraceInput in = {NULL, NULL};
+    if (coltrace_detect(trace_filename))
     {
-        perror("Couldn't create pipe");
-        return 1;
+        printf("Opening columnar trace file: %s\n", trace_filename);
+        in.ct = coltrace_open(trace_filename);
+        if (in.ct == NULL)
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        printf("Opening trace file with %s: %s\n",
+               USE_GUNZIP ? "gunzip" : "zlib", trace_filename);
+        in.tf = tracefile_open(trace_filename, USE_GUNZIP);
+        if (in.tf == NULL)
+        {
+            return 1;
+        }
     }
 
-    pid_t pid = fork();
-    if (pid == -1)
+    // Read the trace file.
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (NUM_THREADS > 1)
+    {
+        status = read_trace_parallel(&in);
+    }
+    else
+    {
+        status = read_trace(&in);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    stat_read_seconds = (double)(end.tv_sec - start.tv_sec) +
+                        (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+    int close_status;
+    if (in.ct != NULL)
+    {
+        // Count decoded bytes, so the rate compares with gzip traces.
+        stat_read_syscalls = in.ct->stat_syscalls;
+        stat_read_bytes = stat_num_inst * sizeof(TraceRec);
+        close_status = coltrace_close(in.ct);
+    }
+    else
+    {
+        stat_read_syscalls = in.tf->stat_syscalls;
+        stat_read_bytes = in.tf->stat_bytes;
+        close_status = tracefile_close(in.tf) == 127 ? 1 : 0;
+    }
+    if (status != 0 || close_status != 0)
     {
-        perror("Couldn't fork");
         return 1;
     }
 
-    if (pid == 0)
+    // Print statistics.
+    print_stats();
+    return 0;
+}
+
+int parse_args(int argc, char *argv[], char **trace_filename)
+{
+    *trace_filename = NULL;
+
+    if (argc < 2)
     {
-        // Child process: exec gunzip.
-        dup2(pipefd[1], STDOUT_FILENO);
-        close(pipefd[0]);
-        close(pipefd[1]);
-        execlp("gunzip", "gunzip", "-c", argv[1], NULL);
-        perror("Couldn't exec gunzip");
-        fprintf(stderr, "Is gunzip installed?\n");
-        return 127;
+        print_usage(argv[0]);
+        return 2;
     }
 
-    // Parent process: read the trace file.
-    int trace_fd = pipefd[0];
-    close(pipefd[1]);
-    status = read_trace(trace_fd);
-    close(trace_fd);
-    if (status != 0)
+    for (int i = 1; i < argc; i++)
     {
-        return 1;
+        if (argv[i][0] == '-')
+        {
+            // Parse options.
+            if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "-help") == 0)
+            {
+                print_usage(argv[0]);
+                return 2;
+            }
+            else if (strcmp(argv[i], "-gunzip") == 0)
+            {
+                USE_GUNZIP = 1;
+            }
+            else if (strcmp(argv[i], "-threads") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -threads\n");
+                    return 2;
+                }
+
+                int num_threads = atoi(argv[i]);
+                if (num_threads < 1 || num_threads > MAX_THREADS)
+                {
+                    fprintf(stderr, "Error: number of threads must be between "
+                                    "1 and %d\n", MAX_THREADS);
+                    return 2;
+                }
+
+                NUM_THREADS = num_threads;
+            }
+            else if (strcmp(argv[i], "-kernel") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -kernel\n");
+                    return 2;
+                }
+
+                if (!optypehist_select(argv[i]))
+                {
+                    fprintf(stderr, "Error: unknown or unsupported kernel: %s\n",
+                            argv[i]);
+                    return 2;
+                }
+            }
+            else if (strcmp(argv[i], "-cpi") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -cpi\n");
+                    return 2;
+                }
+
+                if (cpimodel_parse(argv[i]) != 0)
+                {
+                    return 2;
+                }
+                CPI_MODELS_GIVEN = 1;
+            }
+            else if (strcmp(argv[i], "-cpifile") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -cpifile\n");
+                    return 2;
+                }
+
+                if (cpimodel_load(argv[i]) != 0)
+                {
+                    return 2;
+                }
+                CPI_MODELS_GIVEN = 1;
+            }
+            else if (strcmp(argv[i], "-wswindow") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -wswindow\n");
+                    return 2;
+                }
+
+                long long window = atoll(argv[i]);
+                if (window < 1)
+                {
+                    fprintf(stderr, "Error: working-set window must be at "
+                                    "least 1 instruction\n");
+                    return 2;
+                }
+
+                WS_WINDOW = window;
+            }
+            else if (strcmp(argv[i], "-reuse") == 0)
+            {
+                PROFILE_REUSE = 1;
+            }
+            else if (strcmp(argv[i], "-linesize") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -linesize\n");
+                    return 2;
+                }
+
+                int line_size = atoi(argv[i]);
+                if (line_size < 1 || (line_size & (line_size - 1)) != 0)
+                {
+                    fprintf(stderr, "Error: line size must be a power of two\n");
+                    return 2;
+                }
+
+                LINE_SIZE = line_size;
+            }
+            else if (strcmp(argv[i], "-uniquepc") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -uniquepc\n");
+                    return 2;
+                }
+
+                if (strcmp(argv[i], "exact") == 0)
+                {
+                    UNIQUE_PC_MODE = UNIQUE_PC_EXACT;
+                }
+                else if (strcmp(argv[i], "hll") == 0)
+                {
+                    UNIQUE_PC_MODE = UNIQUE_PC_HLL;
+                }
+                else if (strcmp(argv[i], "both") == 0)
+                {
+                    UNIQUE_PC_MODE = UNIQUE_PC_BOTH;
+                }
+                else
+                {
+                    fprintf(stderr, "Error: unique PC mode must be exact, hll, "
+                                    "or both\n");
+                    return 2;
+                }
+            }
+            else if (strcmp(argv[i], "-hllprecision") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -hllprecision\n");
+                    return 2;
+                }
+
+                int precision = atoi(argv[i]);
+                if (precision < HLL_MIN_PRECISION || precision > HLL_MAX_PRECISION)
+                {
+                    fprintf(stderr, "Error: HyperLogLog precision must be between "
+                                    "%d and %d\n", HLL_MIN_PRECISION,
+                            HLL_MAX_PRECISION);
+                    return 2;
+                }
+
+                HLL_PRECISION = precision;
+            }
+            else if (strcmp(argv[i], "-hotspots") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -hotspots\n");
+                    return 2;
+                }
+
+                int top_n = atoi(argv[i]);
+                if (top_n < 1)
+                {
+                    fprintf(stderr, "Error: number of hot spots must be at "
+                                    "least 1\n");
+                    return 2;
+                }
+
+                HOTSPOT_TOP_N = top_n;
+            }
+            else
+            {
+                fprintf(stderr, "Error: unrecognized option: %s\n", argv[i]);
+                return 2;
+            }
+        }
+        else
+        {
+            // Parse trace file name.
+            if (*trace_filename != NULL)
+            {
+                fprintf(stderr, "Error: only one trace file may be specified\n");
+                return 2;
+            }
+
+            *trace_filename = argv[i];
+        }
     }
 
-    // Wait for the child process to finish.
-    waitpid(pid, &status, 0);
-    status = WEXITSTATUS(status);
-    if (status == 127)
+    if (*trace_filename == NULL)
     {
-        return 1;
+        fprintf(stderr, "Error: no trace file specified\n");
+        return 2;
     }
 
-    // Print statistics.
-    print_stats();
     return 0;
 }
 
-int read_trace(int fd)
+/**
+ * Read the next block of trace records and check that they are valid.
+ *
+ * Gzip-compressed and uncompressed traces are not copied: recs is pointed at
+ * the records where the trace file has them, in its inflate buffer or its
+ * memory mapping. Columnar traces are decoded into buf.
+ *
+ * @param in the trace file
+ * @param buf a buffer with room for TRACE_BUF_RECS records
+ * @param recs set to point at the records, which stay valid until the next
+ *             call
+ * @return the number of records read, which is less than TRACE_BUF_RECS only
+ *         for the last block of the trace, or -1 on error
+ */
+static ssize_t read_block(TraceInput *in, TraceRec *buf, const TraceRec **recs)
 {
-    TraceRec trace_record;
-    while (true)
+    size_t num_recs;
+    if (in->ct != NULL)
     {
-        ssize_t bytes_read = read(fd, &trace_record, sizeof(trace_record));
-        if (bytes_read == 0)
+        ssize_t recs_read = coltrace_read(in->ct, buf, TRACE_BUF_RECS);
+        if (recs_read == -1)
         {
-            return 0;
+            return -1;
         }
+        num_recs = recs_read;
+        *recs = buf;
+    }
+    else
+    {
+        const void *data;
+        ssize_t bytes_read = tracefile_next(in->tf, &data,
+                                            TRACE_BUF_RECS * sizeof(TraceRec));
         if (bytes_read == -1)
         {
-            perror("Couldn't read from pipe");
             return -1;
         }
-        if (bytes_read != sizeof(trace_record) || trace_record.optype >= NUM_OP_TYPES)
+        *recs = (const TraceRec *)data;
+
+        num_recs = bytes_read / sizeof(TraceRec);
+        if (num_recs * sizeof(TraceRec) != (size_t)bytes_read)
+        {
+            fprintf(stderr, "Error: Invalid trace file\n");
+            return -1;
+        }
+    }
+    for (size_t i = 0; i < num_recs; i++)
+    {
+        if ((*recs)[i].optype >= NUM_OP_TYPES)
         {
             fprintf(stderr, "Error: Invalid trace file\n");
             return -1;
         }
+    }
+
+    return num_recs;
+}
+
+int read_trace(TraceInput *in)
+{
+    static TraceRec trace_buf[TRACE_BUF_RECS];
+
+    while (true)
+    {
+        const TraceRec *recs;
+        ssize_t num_recs = read_block(in, trace_buf, &recs);
+        if (num_recs == -1)
+        {
+            return -1;
+        }
+
+        // Hand every record in the block to the analyzer as one batch.
+        stat_num_inst += num_recs;
+        analyze_trace_batch(recs, num_recs);
+        if (locality != NULL)
+        {
+            locality_analyze(locality, recs, num_recs);
+        }
+
+        if (num_recs < TRACE_BUF_RECS)
+        {
+            return 0;
+        }
+    }
+}
+
+/** A block of trace records waiting to be analyzed by a worker thread. */
+typedef struct TraceBlock
+{
+    TraceRec *recs;
+    size_t num_recs;
+} TraceBlock;
+
+int read_trace_parallel(TraceInput *in)
+{
+    std::mutex lock;
+    std::condition_variable filled_cv;
+    std::condition_variable free_cv;
+    std::deque<TraceBlock> filled_blocks;
+    std::vector<TraceRec *> free_bufs;
+    bool done = false;
+    int status = 0;
+
+    // Two spare buffers let the main thread read ahead while every worker is
+    // busy.
+    for (uint32_t i = 0; i < NUM_THREADS + 2; i++)
+    {
+        free_bufs.push_back(new TraceRec[TRACE_BUF_RECS]);
+    }
+
+    // Each worker analyzes whole blocks into its own statistics.
+    std::vector<TraceStats *> worker_stats;
+    std::vector<std::thread> workers;
+    for (uint32_t i = 0; i < NUM_THREADS; i++)
+    {
+        TraceStats *stats = tracestats_new();
+        worker_stats.push_back(stats);
+        workers.push_back(std::thread([&, stats]() {
+            std::unique_lock<std::mutex> guard(lock);
+            while (true)
+            {
+                filled_cv.wait(guard, [&]() {
+                    return !filled_blocks.empty() || done;
+                });
+                if (filled_blocks.empty())
+                {
+                    return;
+                }
+                TraceBlock block = filled_blocks.front();
+                filled_blocks.pop_front();
+
+                guard.unlock();
+                tracestats_analyze(stats, block.recs, block.num_recs);
+                guard.lock();
+
+                free_bufs.push_back(block.recs);
+                free_cv.notify_one();
+            }
+        }));
+    }
+
+    // The main thread reads blocks and queues them for the workers.
+    while (true)
+    {
+        TraceRec *buf;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            free_cv.wait(guard, [&]() { return !free_bufs.empty(); });
+            buf = free_bufs.back();
+            free_bufs.pop_back();
+        }
+
+        // The records must outlive the next read, so keep a copy in buf.
+        const TraceRec *recs;
+        ssize_t num_recs = read_block(in, buf, &recs);
+        if (num_recs == -1)
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            free_bufs.push_back(buf);
+            status = -1;
+            break;
+        }
+        if (recs != buf)
+        {
+            memcpy(buf, recs, num_recs * sizeof(TraceRec));
+        }
+        stat_num_inst += num_recs;
+        if (locality != NULL)
+        {
+            locality_analyze(locality, buf, num_recs);
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            filled_blocks.push_back({buf, (size_t)num_recs});
+        }
+        filled_cv.notify_one();
 
-        // Update statistics.
-        stat_num_inst++;
-        analyze_trace_record(&trace_record);
+        if (num_recs < TRACE_BUF_RECS)
+        {
+            break;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        done = true;
+    }
+    filled_cv.notify_all();
+    for (uint32_t i = 0; i < NUM_THREADS; i++)
+    {
+        workers[i].join();
+    }
+
+    // Merge the per-worker statistics. Every buffer is back in free_bufs once
+    // the workers have finished, even after an error.
+    for (uint32_t i = 0; i < NUM_THREADS; i++)
+    {
+        analyze_trace_merge(worker_stats[i]);
+        tracestats_free(worker_stats[i]);
+    }
+    for (size_t i = 0; i < free_bufs.size(); i++)
+    {
+        delete[] free_bufs[i];
     }
+
+    return status;
 }
 
 void print_stats()
@@ -165,4 +703,90 @@ void print_stats()
     printf("LAB1_PERC_ST_OP         \t : %6.3f\n", 100.0 * (double)(stat_optype_dyn[OP_ST]) / (double)(stat_num_inst));
     printf("LAB1_PERC_CBR_OP        \t : %6.3f\n", 100.0 * (double)(stat_optype_dyn[OP_CBR]) / (double)(stat_num_inst));
     printf("LAB1_PERC_OTHER_OP      \t : %6.3f\n\n", 100.0 * (double)(stat_optype_dyn[OP_OTHER]) / (double)(stat_num_inst));
+
+    if (CPI_MODELS_GIVEN)
+    {
+        // Every model is evaluated from the same op-type histogram.
+        double cycles[MAX_CPI_MODELS];
+        cpimodel_eval(stat_optype_dyn, cycles);
+
+        printf("LAB1_NUM_CPI_MODELS     \t : %10d\n", cpimodel_count());
+        for (int i = 0; i < cpimodel_count(); i++)
+        {
+            printf("LAB1_CPI_MODEL_%-3d     \t : %-16s %14.0f cycles  CPI %6.3f\n",
+                   i, cpimodel_name(i), cycles[i], cycles[i] / (double)stat_num_inst);
+        }
+        printf("\n");
+    }
+
+    if (trace_stats != NULL && trace_stats->hll != NULL)
+    {
+        const HLL *hll = trace_stats->hll;
+        double estimate = hll_estimate(hll);
+        double std_error = hll_std_error(hll);
+
+        printf("LAB1_HLL_PRECISION      \t : %10u\n", hll->precision);
+        printf("LAB1_HLL_MEMORY_BYTES   \t : %10lu\n", hll_size_bytes(hll));
+        printf("LAB1_HLL_EST_UNIQUE_PC  \t : %12.1f\n", estimate);
+        printf("LAB1_HLL_STD_ERROR      \t : %6.3f%%\n", 100.0 * std_error);
+        printf("LAB1_HLL_95_CI          \t : %12.1f - %.1f\n",
+               estimate * (1.0 - 1.96 * std_error),
+               estimate * (1.0 + 1.96 * std_error));
+        if (trace_stats->pcs != NULL)
+        {
+            double actual = (double)pcset_size(trace_stats->pcs);
+            printf("LAB1_HLL_ACTUAL_ERROR   \t : %6.3f%%\n",
+                   actual > 0.0 ? 100.0 * (estimate - actual) / actual : 0.0);
+        }
+        printf("\n");
+    }
+
+    if (trace_stats != NULL && trace_stats->pc_counts != NULL)
+    {
+        hotspot_print(trace_stats->pc_counts, HOTSPOT_TOP_N);
+    }
+
+    if (locality != NULL)
+    {
+        locality_print(locality);
+    }
+
+    double mb_per_sec = 0.0;
+    if (stat_read_seconds > 0.0)
+    {
+        mb_per_sec = (double)stat_read_bytes / 1e6 / stat_read_seconds;
+    }
+
+    printf("LAB1_READ_SYSCALLS      \t : %10lu\n", stat_read_syscalls);
+    printf("LAB1_SYSCALLS_PER_REC   \t : %10.6f\n", (double)stat_read_syscalls / (double)(stat_num_inst));
+    printf("LAB1_READ_MB_PER_SEC    \t : %10.3f\n\n", mb_per_sec);
+}
+
+void print_usage(char *program_name)
+{
+    fprintf(stderr, "Usage: %s [options] <trace file>\n\n", program_name);
+    fprintf(stderr, "Trace analyzer\n\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "    -gunzip             Decompress the trace with an external gunzip process\n");
+    fprintf(stderr, "                        instead of in-process with zlib\n");
+    fprintf(stderr, "    -threads <num>      Analyze the trace with <num> worker threads\n");
+    fprintf(stderr, "                        (default: 1)\n");
+    fprintf(stderr, "    -kernel <name>      Count op types with the auto, scalar, sse4,\n");
+    fprintf(stderr, "                        or avx2 kernel (default: auto)\n");
+    fprintf(stderr, "    -cpi <a,l,s,c,o>    Add a CPI model with the given CPI for ALU, LD, ST,\n");
+    fprintf(stderr, "                        CBR, and OTHER ops; may be repeated (default: 1,2,2,3,1)\n");
+    fprintf(stderr, "    -cpifile <file>     Add the CPI models in <file>, one per line:\n");
+    fprintf(stderr, "                        <name> <alu> <ld> <st> <cbr> <other>\n");
+    fprintf(stderr, "    -wswindow <num>     Report the working set over windows of <num>\n");
+    fprintf(stderr, "                        instructions\n");
+    fprintf(stderr, "    -reuse              Report the PC reuse distance histogram\n");
+    fprintf(stderr, "    -linesize <bytes>   Group PCs into lines of <bytes> for -wswindow and\n");
+    fprintf(stderr, "                        -reuse (default: 1)\n");
+    fprintf(stderr, "    -uniquepc <mode>    Count unique PCs exactly, estimate them with a\n");
+    fprintf(stderr, "                        HyperLogLog sketch (hll), or both (default: exact)\n");
+    fprintf(stderr, "    -hllprecision <p>   Give the sketch 2^<p> registers, %d to %d\n",
+            HLL_MIN_PRECISION, HLL_MAX_PRECISION);
+    fprintf(stderr, "                        (default: %d)\n", HLL_DEFAULT_PRECISION);
+    fprintf(stderr, "    -hotspots <num>     Report the <num> hottest PCs and PC ranges, and how\n");
+    fprintf(stderr, "                        many PCs cover 50/90/99%% of the trace\n");
 }
@@ -0,0 +1,547 @@
+// simpoint.cpp
+// Chooses simulation points for a trace, SimPoint style: the trace is cut into
+// fixed intervals of instructions, each interval is summarized by its basic
+// block vector, the vectors are clustered with k-means, and the interval
+// closest to the center of each cluster represents the whole cluster.
+//
+// A basic block vector counts the instructions executed in every basic block
+// during the interval. Blocks are found from control flow alone, as runs of
+// sequential PCs, so this works on the traces of every lab: only the PC at the
+// start of each record is read. The vectors are randomly projected down to a
+// few dimensions as they are built, so memory does not grow with the number
+// of blocks in the program.
+//
+// The list written can be passed to the lab2, lab3, and lab4 simulators with
+// -simpoints; see simpoints.h.
+
+#include "pcmap.h"
+#include "simpoints.h"
+#include "tracefile.h"
+#include <algorithm>
+#include <math.h>
+#include <random>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+/** The default number of instructions per interval. */
+#define DEFAULT_INTERVAL_SIZE 1000000
+
+/** The default largest number of clusters tried. */
+#define DEFAULT_MAX_K 10
+
+/** The default number of dimensions the vectors are projected down to. */
+#define DEFAULT_DIMS 15
+
+/** The largest number of dimensions the vectors can be projected down to. */
+#define MAX_DIMS 64
+
+/** The most iterations of k-means run for each number of clusters. */
+#define KMEANS_MAX_ITERS 100
+
+/**
+ * The smallest number of clusters whose BIC score is within this fraction of
+ * the best score is chosen, as in SimPoint.
+ */
+#define BIC_THRESHOLD 0.9
+
+/**
+ * The largest gap in bytes between two sequential PCs. Any other change of PC
+ * starts a new block.
+ */
+#define MAX_INST_BYTES 15
+
+/** The result of clustering the intervals. */
+typedef struct Clustering
+{
+    int k;
+    std::vector<int> assignment;
+    std::vector<double> centers;
+    double distortion;
+    double bic;
+} Clustering;
+
+static void print_usage(char *program_name)
+{
+    fprintf(stderr, "Usage: %s [options] <trace file> <simulation point list>\n\n",
+            program_name);
+    fprintf(stderr, "Chooses representative intervals of a trace to simulate\n\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "    -interval <num>     Cut the trace into intervals of <num> instructions\n");
+    fprintf(stderr, "                        (default: %d)\n", DEFAULT_INTERVAL_SIZE);
+    fprintf(stderr, "    -maxk <num>         Try up to <num> clusters (default: %d)\n", DEFAULT_MAX_K);
+    fprintf(stderr, "    -dims <num>         Project basic block vectors down to <num> dimensions\n");
+    fprintf(stderr, "                        (default: %d)\n", DEFAULT_DIMS);
+    fprintf(stderr, "    -seed <num>         Seed the random projection and k-means (default: 1)\n");
+    fprintf(stderr, "    -recsize <bytes>    Set the size of a trace record (default: 16 for\n");
+    fprintf(stderr, "                        .otr, 48 for .ptr, 9 for .mtr traces)\n");
+    fprintf(stderr, "    -gunzip             Decompress the trace with an external gunzip process\n");
+    fprintf(stderr, "                        instead of in-process with zlib\n");
+}
+
+/**
+ * Guess the record size of a trace from its file name.
+ */
+static size_t guess_rec_size(const char *filename)
+{
+    if (strstr(filename, ".ptr") != NULL)
+    {
+        return 48;
+    }
+    if (strstr(filename, ".mtr") != NULL)
+    {
+        return 9;
+    }
+    return 16;
+}
+
+/**
+ * Builds the projected basic block vector of every interval.
+ */
+typedef struct BBVBuilder
+{
+    int dims;
+    std::mt19937_64 rng;
+
+    /** Maps the first PC of each block to its index in projections. */
+    PCMap *blocks;
+
+    /** The random projection of every block, dims values per block. */
+    std::vector<float> projections;
+
+    /** The projected vector of the current interval. */
+    std::vector<double> current;
+
+    /** The first PC of the current block, and its index. */
+    uint64_t block_pc;
+    uint64_t block_index;
+
+    /** The number of instructions of the current block in the interval. */
+    uint64_t block_inst;
+
+    /** The number of instructions in the current interval. */
+    uint64_t interval_inst;
+
+    /** The vectors of all complete intervals, dims values per interval. */
+    std::vector<double> vectors;
+
+    /** The number of instructions in every complete interval. */
+    std::vector<uint64_t> lengths;
+} BBVBuilder;
+
+/**
+ * Start a new block at the given PC.
+ */
+static void start_block(BBVBuilder *b, uint64_t pc)
+{
+    bool inserted;
+    uint64_t *index = pcmap_upsert(b->blocks, pc, &inserted);
+    if (inserted)
+    {
+        *index = b->projections.size() / b->dims;
+        std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+        for (int d = 0; d < b->dims; d++)
+        {
+            b->projections.push_back(uniform(b->rng));
+        }
+    }
+    b->block_pc = pc;
+    b->block_index = *index;
+    b->block_inst = 0;
+}
+
+/**
+ * Add the instructions of the current block so far to the interval vector.
+ */
+static void flush_block(BBVBuilder *b)
+{
+    if (b->block_inst == 0)
+    {
+        return;
+    }
+    const float *projection = &b->projections[b->block_index * b->dims];
+    for (int d = 0; d < b->dims; d++)
+    {
+        b->current[d] += (double)b->block_inst * projection[d];
+    }
+    b->block_inst = 0;
+}
+
+/**
+ * Close the current interval, normalizing its vector to the fraction of
+ * instructions in each block.
+ */
+static void end_interval(BBVBuilder *b)
+{
+    flush_block(b);
+    for (int d = 0; d < b->dims; d++)
+    {
+        b->vectors.push_back(b->current[d] / (double)b->interval_inst);
+        b->current[d] = 0.0;
+    }
+    b->lengths.push_back(b->interval_inst);
+    b->interval_inst = 0;
+}
+
+/**
+ * Get the squared distance between two vectors.
+ */
+static inline double distance2(const double *a, const double *b, int dims)
+{
+    double sum = 0.0;
+    for (int d = 0; d < dims; d++)
+    {
+        double diff = a[d] - b[d];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+/**
+ * Cluster the intervals into k clusters with k-means, seeded with k-means++,
+ * and score the clustering with the Bayesian Information Criterion.
+ */
+static Clustering kmeans(const std::vector<double> &vectors, int dims, int k,
+                         std::mt19937_64 &rng)
+{
+    size_t n = vectors.size() / dims;
+    Clustering c;
+    c.k = k;
+    c.assignment.assign(n, -1);
+    c.centers.assign((size_t)k * dims, 0.0);
+
+    // k-means++: pick each center with probability proportional to the
+    // squared distance to the nearest center so far.
+    std::vector<double> nearest(n, INFINITY);
+    std::uniform_int_distribution<size_t> pick(0, n - 1);
+    size_t first = pick(rng);
+    std::copy(&vectors[first * dims], &vectors[first * dims] + dims,
+              &c.centers[0]);
+    for (int j = 1; j < k; j++)
+    {
+        double total = 0.0;
+        for (size_t i = 0; i < n; i++)
+        {
+            nearest[i] = std::min(nearest[i],
+                                  distance2(&vectors[i * dims],
+                                            &c.centers[(j - 1) * dims], dims));
+            total += nearest[i];
+        }
+        size_t chosen = pick(rng);
+        if (total > 0.0)
+        {
+            std::uniform_real_distribution<double> uniform(0.0, total);
+            double target = uniform(rng);
+            for (chosen = 0; chosen + 1 < n && target >= nearest[chosen];
+                 chosen++)
+            {
+                target -= nearest[chosen];
+            }
+        }
+        std::copy(&vectors[chosen * dims], &vectors[chosen * dims] + dims,
+                  &c.centers[j * dims]);
+    }
+
+    // Lloyd's algorithm.
+    std::vector<size_t> sizes(k);
+    for (int iter = 0; iter < KMEANS_MAX_ITERS; iter++)
+    {
+        bool changed = false;
+        c.distortion = 0.0;
+        for (size_t i = 0; i < n; i++)
+        {
+            int best = 0;
+            double best_dist = INFINITY;
+            for (int j = 0; j < k; j++)
+            {
+                double dist =
+                    distance2(&vectors[i * dims], &c.centers[j * dims], dims);
+                if (dist < best_dist)
+                {
+                    best = j;
+                    best_dist = dist;
+                }
+            }
+            changed = changed || c.assignment[i] != best;
+            c.assignment[i] = best;
+            c.distortion += best_dist;
+        }
+        if (!changed)
+        {
+            break;
+        }
+
+        std::fill(c.centers.begin(), c.centers.end(), 0.0);
+        std::fill(sizes.begin(), sizes.end(), 0);
+        for (size_t i = 0; i < n; i++)
+        {
+            int j = c.assignment[i];
+            sizes[j]++;
+            for (int d = 0; d < dims; d++)
+            {
+                c.centers[j * dims + d] += vectors[i * dims + d];
+            }
+        }
+        for (int j = 0; j < k; j++)
+        {
+            for (int d = 0; d < dims && sizes[j] > 0; d++)
+            {
+                c.centers[j * dims + d] /= (double)sizes[j];
+            }
+        }
+    }
+
+    // The log-likelihood of the intervals under identical spherical Gaussians
+    // around the centers, less a penalty for the number of parameters.
+    std::fill(sizes.begin(), sizes.end(), 0);
+    for (size_t i = 0; i < n; i++)
+    {
+        sizes[c.assignment[i]]++;
+    }
+    double r = (double)n;
+    double variance = 1e-12;
+    if (n > (size_t)k)
+    {
+        variance = std::max(variance, c.distortion / ((r - k) * dims));
+    }
+    double likelihood = -r * dims / 2.0 * log(2.0 * M_PI * variance) -
+                        c.distortion / (2.0 * variance);
+    for (int j = 0; j < k; j++)
+    {
+        if (sizes[j] > 0)
+        {
+            likelihood += (double)sizes[j] * log((double)sizes[j] / r);
+        }
+    }
+    double num_params = (k - 1) + (double)k * dims + 1;
+    c.bic = likelihood - num_params / 2.0 * log(r);
+    return c;
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t interval_size = DEFAULT_INTERVAL_SIZE;
+    int max_k = DEFAULT_MAX_K;
+    int dims = DEFAULT_DIMS;
+    uint64_t seed = 1;
+    size_t rec_size = 0;
+    bool use_gunzip = false;
+    char *filenames[2];
+    int num_filenames = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "-gunzip") == 0)
+        {
+            use_gunzip = true;
+        }
+        else if (strcmp(argv[i], "-interval") == 0 && has_value)
+        {
+            interval_size = strtoull(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "-maxk") == 0 && has_value)
+        {
+            max_k = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-dims") == 0 && has_value)
+        {
+            dims = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-seed") == 0 && has_value)
+        {
+            seed = strtoull(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "-recsize") == 0 && has_value)
+        {
+            rec_size = atoi(argv[++i]);
+        }
+        else if (argv[i][0] == '-' || num_filenames == 2)
+        {
+            print_usage(argv[0]);
+            return 2;
+        }
+        else
+        {
+            filenames[num_filenames++] = argv[i];
+        }
+    }
+    if (num_filenames != 2 || interval_size == 0 || max_k < 1 || dims < 1 ||
+        dims > MAX_DIMS)
+    {
+        print_usage(argv[0]);
+        return 2;
+    }
+    if (rec_size == 0)
+    {
+        rec_size = guess_rec_size(filenames[0]);
+    }
+    if (rec_size < 4 || rec_size > TRACEFILE_OUT_BUF_SIZE)
+    {
+        fprintf(stderr, "Error: invalid record size: %lu\n",
+                (unsigned long)rec_size);
+        return 2;
+    }
+
+    TraceFile *tf = tracefile_open(filenames[0], use_gunzip);
+    if (tf == NULL)
+    {
+        return 1;
+    }
+
+    // Records smaller than 16 bytes (lab4's) hold a 4-byte PC.
+    size_t pc_size = rec_size < 16 ? 4 : 8;
+    size_t chunk_recs = TRACEFILE_OUT_BUF_SIZE / rec_size;
+
+    BBVBuilder b;
+    b.dims = dims;
+    b.rng.seed(seed);
+    b.blocks = pcmap_new(PCSET_DEFAULT_CAPACITY);
+    b.current.assign(dims, 0.0);
+    b.block_pc = 0;
+    b.block_index = 0;
+    b.block_inst = 0;
+    b.interval_inst = 0;
+
+    int status = 0;
+    uint64_t num_inst = 0;
+    uint64_t prev_pc = 0;
+    while (true)
+    {
+        const void *data;
+        ssize_t bytes_read = tracefile_next(tf, &data, chunk_recs * rec_size);
+        if (bytes_read == -1)
+        {
+            status = 1;
+            break;
+        }
+        if (bytes_read % rec_size != 0)
+        {
+            fprintf(stderr, "Error: Invalid trace file\n");
+            status = 1;
+            break;
+        }
+
+        const uint8_t *recs = (const uint8_t *)data;
+        size_t num_recs = bytes_read / rec_size;
+        for (size_t i = 0; i < num_recs; i++)
+        {
+            uint64_t pc = 0;
+            memcpy(&pc, recs + i * rec_size, pc_size);
+
+            // Anything but a short step forward starts a new block.
+            if (num_inst == 0 || pc <= prev_pc ||
+                pc - prev_pc > MAX_INST_BYTES)
+            {
+                flush_block(&b);
+                start_block(&b, pc);
+            }
+            b.block_inst++;
+            if (++b.interval_inst == interval_size)
+            {
+                end_interval(&b);
+            }
+            prev_pc = pc;
+            num_inst++;
+        }
+
+        if (num_recs < chunk_recs)
+        {
+            break;
+        }
+    }
+    if (tracefile_close(tf) == 127)
+    {
+        status = 1;
+    }
+    pcmap_free(b.blocks);
+    if (status != 0)
+    {
+        return status;
+    }
+    if (b.interval_inst > 0)
+    {
+        end_interval(&b);
+    }
+    if (b.lengths.empty())
+    {
+        fprintf(stderr, "Error: empty trace\n");
+        return 1;
+    }
+
+    // Cluster with every k up to max_k, and keep the smallest k that scores
+    // close enough to the best.
+    size_t num_intervals = b.lengths.size();
+    max_k = (int)std::min((size_t)max_k, num_intervals);
+    std::vector<Clustering> clusterings;
+    double best_bic = -INFINITY;
+    double worst_bic = INFINITY;
+    for (int k = 1; k <= max_k; k++)
+    {
+        clusterings.push_back(kmeans(b.vectors, dims, k, b.rng));
+        best_bic = std::max(best_bic, clusterings.back().bic);
+        worst_bic = std::min(worst_bic, clusterings.back().bic);
+    }
+    const Clustering *chosen = &clusterings.back();
+    for (const Clustering &c : clusterings)
+    {
+        if (c.bic >= worst_bic + BIC_THRESHOLD * (best_bic - worst_bic))
+        {
+            chosen = &c;
+            break;
+        }
+    }
+
+    // Each cluster is represented by the interval closest to its center, and
+    // weighted by the share of instructions in the cluster.
+    std::vector<uint64_t> representative(chosen->k, 0);
+    std::vector<double> closest(chosen->k, INFINITY);
+    std::vector<uint64_t> cluster_inst(chosen->k, 0);
+    for (size_t i = 0; i < num_intervals; i++)
+    {
+        int j = chosen->assignment[i];
+        double dist = distance2(&b.vectors[i * dims],
+                                &chosen->centers[j * dims], dims);
+        if (dist < closest[j])
+        {
+            closest[j] = dist;
+            representative[j] = i;
+        }
+        cluster_inst[j] += b.lengths[i];
+    }
+
+    std::vector<std::pair<uint64_t, double>> points;
+    uint64_t simulated_inst = 0;
+    for (int j = 0; j < chosen->k; j++)
+    {
+        if (cluster_inst[j] > 0)
+        {
+            points.push_back({representative[j],
+                              (double)cluster_inst[j] / (double)num_inst});
+            simulated_inst += b.lengths[representative[j]];
+        }
+    }
+    std::sort(points.begin(), points.end());
+
+    SimPoints *sp = simpoints_new(interval_size, num_inst, points.size());
+    for (size_t i = 0; i < points.size(); i++)
+    {
+        sp->points[i].interval = points[i].first;
+        sp->points[i].weight = points[i].second;
+    }
+    status = simpoints_write(sp, filenames[1]) == 0 ? 0 : 1;
+    simpoints_free(sp);
+    if (status != 0)
+    {
+        return status;
+    }
+
+    printf("Chose %lu simulation points from %lu intervals of %lu instructions\n",
+           (unsigned long)points.size(), (unsigned long)num_intervals,
+           (unsigned long)interval_size);
+    printf("Simulating %lu of %lu instructions (%.2f%%)\n",
+           (unsigned long)simulated_inst, (unsigned long)num_inst,
+           100.0 * (double)simulated_inst / (double)num_inst);
+    return 0;
+}
@@ -0,0 +1,272 @@
+// simpoints.cpp
+// Implements simulation point lists.
+
+#include "simpoints.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+SimPoints *simpoints_new(uint64_t interval_size, uint64_t trace_inst,
+                         uint32_t count)
+{
+    SimPoints *sp = (SimPoints *)calloc(1, sizeof(SimPoints));
+    sp->interval_size = interval_size;
+    sp->trace_inst = trace_inst;
+    sp->count = count;
+    sp->points = (SimPoint *)calloc(count > 0 ? count : 1, sizeof(SimPoint));
+    return sp;
+}
+
+SimPoints *simpoints_window(uint64_t skip, uint64_t warmup, uint64_t simulate)
+{
+    SimPoints *sp = simpoints_new(0, 0, 1);
+    SimPoint *point = &sp->points[0];
+    point->weight = 1.0;
+    point->start = skip + warmup;
+    point->length = simulate > 0 ? simulate : UINT64_MAX - point->start;
+    point->warmup = warmup;
+    return sp;
+}
+
+void simpoints_set_warmup(SimPoints *sp, uint64_t warmup)
+{
+    uint64_t prev_end = 0;
+    for (uint32_t i = 0; i < sp->count; i++)
+    {
+        SimPoint *point = &sp->points[i];
+        uint64_t gap = point->start - prev_end;
+        point->warmup = warmup < gap ? warmup : gap;
+        prev_end = point->start + point->length;
+    }
+}
+
+SimPoints *simpoints_load(const char *filename)
+{
+    FILE *file = fopen(filename, "r");
+    if (file == NULL)
+    {
+        perror("Couldn't open simulation point list");
+        return NULL;
+    }
+
+    uint64_t interval_size = 0;
+    uint64_t trace_inst = 0;
+    SimPoint *points = NULL;
+    uint32_t count = 0;
+    uint32_t capacity = 0;
+    bool ok = true;
+
+    char line[256];
+    int line_num = 0;
+    while (ok && fgets(line, sizeof(line), file) != NULL)
+    {
+        line_num++;
+        char *text = line + strspn(line, " \t");
+        if (text[0] == '#' || text[0] == '\n' || text[0] == '\0')
+        {
+            continue;
+        }
+
+        uint64_t value;
+        double weight;
+        if (sscanf(text, "interval %" SCNu64, &value) == 1)
+        {
+            interval_size = value;
+        }
+        else if (sscanf(text, "instructions %" SCNu64, &value) == 1)
+        {
+            trace_inst = value;
+        }
+        else if (sscanf(text, "%" SCNu64 " %lf", &value, &weight) == 2)
+        {
+            if (count > 0 && value <= points[count - 1].interval)
+            {
+                fprintf(stderr, "Error: %s:%d: simulation points must be in "
+                                "increasing order\n", filename, line_num);
+                ok = false;
+                break;
+            }
+            if (count == capacity)
+            {
+                capacity = capacity > 0 ? 2 * capacity : 16;
+                points = (SimPoint *)realloc(points, capacity * sizeof(SimPoint));
+            }
+            memset(&points[count], 0, sizeof(SimPoint));
+            points[count].interval = value;
+            points[count].weight = weight;
+            count++;
+        }
+        else
+        {
+            fprintf(stderr, "Error: %s:%d: invalid line in simulation point "
+                            "list\n", filename, line_num);
+            ok = false;
+        }
+    }
+    fclose(file);
+
+    if (ok && (interval_size == 0 || count == 0))
+    {
+        fprintf(stderr, "Error: %s: simulation point list needs an interval "
+                        "and at least one point\n", filename);
+        ok = false;
+    }
+    if (!ok)
+    {
+        free(points);
+        return NULL;
+    }
+
+    SimPoints *sp = simpoints_new(interval_size, trace_inst, count);
+    memcpy(sp->points, points, count * sizeof(SimPoint));
+    free(points);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        sp->points[i].start = sp->points[i].interval * interval_size;
+        sp->points[i].length = interval_size;
+    }
+    return sp;
+}
+
+int simpoints_write(const SimPoints *sp, const char *filename)
+{
+    FILE *file = fopen(filename, "w");
+    if (file == NULL)
+    {
+        perror("Couldn't create simulation point list");
+        return -1;
+    }
+
+    fprintf(file, "# <interval number> <weight>\n");
+    fprintf(file, "interval %" PRIu64 "\n", sp->interval_size);
+    fprintf(file, "instructions %" PRIu64 "\n", sp->trace_inst);
+    for (uint32_t i = 0; i < sp->count; i++)
+    {
+        fprintf(file, "%" PRIu64 " %.6f\n", sp->points[i].interval,
+                sp->points[i].weight);
+    }
+
+    if (fclose(file) != 0)
+    {
+        perror("Couldn't write simulation point list");
+        return -1;
+    }
+    return 0;
+}
+
+void simpoints_free(SimPoints *sp)
+{
+    if (sp == NULL)
+    {
+        return;
+    }
+    free(sp->points);
+    free(sp);
+}
+
+ssize_t simpoints_next(SimPoints *sp, TraceFile *tf, const void **data,
+                       size_t rec_size)
+{
+    if (sp->fetch_left == 0)
+    {
+        if (sp->next_fetch == sp->count)
+        {
+            return 0;
+        }
+
+        // Fast-forward to the start of the next point's warm-up.
+        const SimPoint *point = &sp->points[sp->next_fetch];
+        uint64_t start = point->start - point->warmup;
+        if (start > sp->fetch_pos)
+        {
+            size_t skip_size = (start - sp->fetch_pos) * rec_size;
+            ssize_t bytes_skipped = tracefile_skip(tf, skip_size);
+            if (bytes_skipped == -1)
+            {
+                return -1;
+            }
+            if ((size_t)bytes_skipped < skip_size)
+            {
+                return 0;
+            }
+        }
+        sp->fetch_pos = start;
+        sp->fetch_left = point->warmup + point->length;
+        sp->next_fetch++;
+    }
+
+    ssize_t bytes_read = tracefile_next(tf, data, rec_size);
+    if (bytes_read == (ssize_t)rec_size)
+    {
+        sp->fetch_pos++;
+        sp->fetch_left--;
+    }
+    return bytes_read;
+}
+
+void simpoints_finish(SimPoints *sp, uint64_t num_inst, uint64_t num_cycles)
+{
+    simpoints_retire(sp, num_inst, num_cycles);
+
+    // A point that was being measured when the trace ran out keeps the
+    // instructions and cycles it got. A point still warming up measured
+    // nothing, so it is left at zero and simpoints_print() skips it.
+    if (sp->next_retire < sp->count && sp->measuring)
+    {
+        SimPoint *point = &sp->points[sp->next_retire++];
+        point->num_inst = num_inst - (sp->retire_base + point->warmup);
+        point->num_cycles = num_cycles - sp->retire_cycle;
+        sp->measured_inst += point->num_inst;
+        sp->measured_cycles += point->num_cycles;
+        sp->measuring = false;
+    }
+}
+
+void simpoints_print(const SimPoints *sp, const char *prefix)
+{
+    if (sp->interval_size == 0)
+    {
+        return;
+    }
+
+    char name[64];
+    double weight_sum = 0.0;
+    double weighted_cpi = 0.0;
+    for (uint32_t i = 0; i < sp->count; i++)
+    {
+        const SimPoint *point = &sp->points[i];
+        if (point->num_inst == 0)
+        {
+            continue; // The trace ended first.
+        }
+
+        double cpi = (double)point->num_cycles / (double)point->num_inst;
+        weight_sum += point->weight;
+        weighted_cpi += point->weight * cpi;
+
+        snprintf(name, sizeof(name), "%s_SIMPOINT_%u", prefix, i);
+        printf("%-24s\t : interval %8" PRIu64 "  weight %6.4f  %10" PRIu64
+               " inst  %10" PRIu64 " cycles  CPI %6.3f\n",
+               name, point->interval, point->weight, point->num_inst,
+               point->num_cycles, cpi);
+    }
+    if (weight_sum <= 0.0)
+    {
+        return;
+    }
+
+    // Renormalize in case some points were never reached. CPI, not IPC, is
+    // what adds up across intervals, so the IPC comes from the weighted CPI.
+    weighted_cpi /= weight_sum;
+    snprintf(name, sizeof(name), "%s_WEIGHTED_CPI", prefix);
+    printf("%-24s\t : %10.3f\n", name, weighted_cpi);
+    snprintf(name, sizeof(name), "%s_WEIGHTED_IPC", prefix);
+    printf("%-24s\t : %10.3f\n", name, 1.0 / weighted_cpi);
+    if (sp->trace_inst > 0)
+    {
+        snprintf(name, sizeof(name), "%s_EST_NUM_CYCLES", prefix);
+        printf("%-24s\t : %10.0f\n", name,
+               weighted_cpi * (double)sp->trace_inst);
+    }
+}
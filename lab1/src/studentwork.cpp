@@ -7,9 +7,11 @@
 // Analyzes a record in a CPU trace file.
 // Author: <your name here>
 
+#include "cpimodel.h"
 #include "trace.h"
+#include "tracestats.h"
 #include <assert.h>
-#include <vector>
+#include <math.h>
 // You may include any other standard C or C++ headers you need here,
 // e.g. #include <vector> or #include <algorithm>.
 // Make sure this compiles on the reference machine!
@@ -60,12 +62,34 @@ uint64_t stat_unique_pc = 0;
 // You may add helper functions if you need them.                            //
 // ------------------------------------------------------------------------- //
 
-std::vector<uint64_t> store_pc;
+/**
+ * The statistics of every record analyzed so far, including those merged in
+ * from worker threads.
+ *
+ * Allocated on first use.
+ */
+TraceStats *trace_stats = NULL;
+
+/**
+ * Copy trace_stats into the global variables stat_num_cycle, stat_optype_dyn,
+ * and stat_unique_pc.
+ */
+static void publish_trace_stats() {
+    for (int i = 0; i < NUM_OP_TYPES; i++){
+        stat_optype_dyn[i] = trace_stats->optype_dyn[i];
+    }
+    stat_num_cycle = cpimodel_primary_cycles(trace_stats->optype_dyn);
+    if (trace_stats->pcs != NULL){
+        stat_unique_pc = pcset_size(trace_stats->pcs);
+    } else {
+        stat_unique_pc = llround(hll_estimate(trace_stats->hll));
+    }
+}
+
 /**
  * Updates the global variables stat_num_cycle, stat_optype_dyn, and
  * stat_unique_pc according to the given trace record.
  *
- * You must write code to implement this function.
  * Make sure you DO NOT update stat_num_inst; it is updated by the code in
  * sim.cpp.
  *
@@ -74,43 +98,35 @@ std::vector<uint64_t> store_pc;
  */
 void analyze_trace_record(TraceRec *t) {
     assert(t);
+    analyze_trace_batch(t, 1);
+}
 
-    // TODO: Task 1: Quantify the mix of the dynamic instruction stream.
-    // Update stat_optype_dyn according to the trace record t.
-    stat_optype_dyn[t->optype] += 1;
-    // TODO: Task 2: Estimate the overall CPI using a simple CPI model in which
-    // the CPI for each category of instructions is provided.
-    // Update stat_num_cycle according to the trace record t.
-    switch(t->optype){
-        case 0:
-        stat_num_cycle += 1;
-        break;
-        case 1:
-        stat_num_cycle += 2;
-        break;
-        case 2:
-        stat_num_cycle += 2;
-        break;
-        case 3:
-        stat_num_cycle += 3;
-        break;
-        case 4:
-        stat_num_cycle += 1;
-        break;
-    }
-    // TODO: Task 3: Estimate the instruction footprint by counting the number
-    // of unique PCs in the benchmark trace.
-    // Update stat_unique_pc according to the trace record t.
-    bool exists = false;
-    for(uint64_t val : store_pc){
-        if (t->inst_addr == val){
-            exists = true;
-            break;
-        }
+/**
+ * Updates the global variables stat_num_cycle, stat_optype_dyn, and
+ * stat_unique_pc according to a batch of consecutive trace records.
+ *
+ * @param t the first trace record of the batch
+ * @param n the number of records in the batch
+ */
+void analyze_trace_batch(const TraceRec *t, size_t n) {
+    if (trace_stats == NULL){
+        trace_stats = tracestats_new();
     }
-    if (!exists){
-        store_pc.push_back(t->inst_addr);
-        stat_unique_pc += 1;
+    tracestats_analyze(trace_stats, t, n);
+    publish_trace_stats();
+}
+
+/**
+ * Updates the global variables stat_num_cycle, stat_optype_dyn, and
+ * stat_unique_pc with statistics gathered separately, e.g. by a worker thread
+ * analyzing part of the trace.
+ *
+ * @param stats the statistics to merge in
+ */
+void analyze_trace_merge(const TraceStats *stats) {
+    if (trace_stats == NULL){
+        trace_stats = tracestats_new();
     }
-    // Make sure you DO NOT update stat_num_inst.
+    tracestats_merge(trace_stats, stats);
+    publish_trace_stats();
 }
@@ -6,6 +6,7 @@
 #define _TRACE_H_
 
 #include <inttypes.h>
+#include <stddef.h>
 
 /** The type of operation performed by an instruction in the CPU trace file. */
 typedef enum OpTypeEnum
@@ -50,4 +51,27 @@ typedef struct TraceRecStruct
  */
 void analyze_trace_record(TraceRec *t);
 
+/**
+ * Updates the global variables stat_num_cycle, stat_optype_dyn, and
+ * stat_unique_pc according to a batch of consecutive trace records.
+ *
+ * This is equivalent to calling analyze_trace_record() on each record in
+ * order, and is what sim.cpp calls for every block it reads from the trace.
+ *
+ * @param t the first trace record of the batch
+ * @param n the number of records in the batch
+ */
+void analyze_trace_batch(const TraceRec *t, size_t n);
+
+struct TraceStats;
+
+/**
+ * Updates the global variables stat_num_cycle, stat_optype_dyn, and
+ * stat_unique_pc with statistics gathered separately, e.g. by a worker thread
+ * analyzing part of the trace. See tracestats.h.
+ *
+ * @param stats the statistics to merge in
+ */
+void analyze_trace_merge(const struct TraceStats *stats);
+
 #endif
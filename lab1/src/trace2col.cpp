@@ -0,0 +1,116 @@
+// trace2col.cpp
+// Converts a gzip-compressed lab1 trace file into a columnar trace file.
+//
+// The simulator detects columnar traces by their magic bytes, so the output
+// can be passed to sim in place of the original trace.
+
+#include "coltrace.h"
+#include "trace.h"
+#include "tracefile.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/** The number of records converted at a time. 65536 records is 1 MiB. */
+#define CONVERT_BUF_RECS 65536
+
+static void print_usage(char *program_name)
+{
+    fprintf(stderr, "Usage: %s [options] <trace file> <columnar trace file>\n\n",
+            program_name);
+    fprintf(stderr, "Converts a trace to the columnar trace format\n\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "    -gunzip             Decompress the trace with an external gunzip process\n");
+    fprintf(stderr, "                        instead of in-process with zlib\n");
+}
+
+int main(int argc, char *argv[])
+{
+    static TraceRec trace_buf[CONVERT_BUF_RECS];
+    bool use_gunzip = false;
+    char *filenames[2];
+    int num_filenames = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-gunzip") == 0)
+        {
+            use_gunzip = true;
+        }
+        else if (argv[i][0] == '-' || num_filenames == 2)
+        {
+            print_usage(argv[0]);
+            return 2;
+        }
+        else
+        {
+            filenames[num_filenames++] = argv[i];
+        }
+    }
+    if (num_filenames != 2)
+    {
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    TraceFile *tf = tracefile_open(filenames[0], use_gunzip);
+    if (tf == NULL)
+    {
+        return 1;
+    }
+    ColTrace *ct = coltrace_create(filenames[1]);
+    if (ct == NULL)
+    {
+        tracefile_close(tf);
+        return 1;
+    }
+
+    int status = 0;
+    while (true)
+    {
+        ssize_t bytes_read = tracefile_read(tf, trace_buf, sizeof(trace_buf));
+        if (bytes_read == -1)
+        {
+            status = 1;
+            break;
+        }
+
+        size_t num_recs = bytes_read / sizeof(TraceRec);
+        if (num_recs * sizeof(TraceRec) != (size_t)bytes_read)
+        {
+            fprintf(stderr, "Error: Invalid trace file\n");
+            status = 1;
+            break;
+        }
+        if (coltrace_write(ct, trace_buf, num_recs) != 0)
+        {
+            status = 1;
+            break;
+        }
+
+        if ((size_t)bytes_read < sizeof(trace_buf))
+        {
+            break;
+        }
+    }
+
+    uint64_t in_bytes = tf->stat_bytes;
+    if (tracefile_close(tf) == 127)
+    {
+        status = 1;
+    }
+    uint64_t num_recs = ct->rec + ct->num_pending;
+    if (coltrace_close(ct) != 0)
+    {
+        status = 1;
+    }
+    if (status != 0)
+    {
+        unlink(filenames[1]);
+        return status;
+    }
+
+    printf("Converted %lu records (%lu bytes) to %s\n", (unsigned long)num_recs,
+           (unsigned long)in_bytes, filenames[1]);
+    return 0;
+}
@@ -0,0 +1,775 @@
+// tracefile.cpp
+// Implements the reader for trace files.
+
+#include "tracefile.h"
+#include <atomic>
+#include <fcntl.h>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+/** The size of a cache line, which the prefetch ring is laid out around. */
+#define CACHE_LINE_SIZE 64
+
+/**
+ * The state shared between a reader and its prefetch thread: a lock-free
+ * single-producer, single-consumer ring of buffers.
+ *
+ * The thread fills the slot after the last one it filled and publishes it by
+ * advancing filled. The reader hands out the slot after the last one it took,
+ * and gives it back by advancing released once it has moved on to the next.
+ */
+struct TracePrefetch
+{
+    /** The trace file the thread decompresses. Only the thread touches it. */
+    TraceFile *source;
+
+    /** The prefetch thread. */
+    std::thread thread;
+
+    /** The buffers, each TRACEFILE_OUT_BUF_SIZE bytes, cache-line aligned. */
+    uint8_t *slots[TRACEFILE_PREFETCH_SLOTS];
+
+    /**
+     * The number of bytes in each filled buffer: less than
+     * TRACEFILE_OUT_BUF_SIZE only at the end of the trace, or -1 on error.
+     */
+    ssize_t slot_sizes[TRACEFILE_PREFETCH_SLOTS];
+
+    /** The number of slots the reader has taken. Only the reader touches it. */
+    uint64_t taken;
+
+    /** Set by the reader to make the thread exit early. */
+    std::atomic<bool> stop;
+
+    // Each counter is written by one side only and gets a cache line of its
+    // own, so neither side's writes invalidate the line the other writes.
+
+    /** The number of slots the thread has filled. */
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> filled;
+
+    /** The number of slots the reader has given back. */
+    alignas(CACHE_LINE_SIZE) std::atomic<uint64_t> released;
+};
+
+/**
+ * Open the trace file using gunzip.
+ * Uses the traditional pipe/fork/exec method.
+ *
+ * @param filename the path of the trace file
+ * @param fd set to the read end of the pipe
+ * @param pid set to the process ID of gunzip
+ * @return 0 on success, nonzero on failure
+ */
+static int open_gunzip_pipe(const char *filename, int *fd, pid_t *pid)
+{
+    int status;
+    int pipefd[2];
+
+    status = pipe(pipefd);
+    if (status != 0)
+    {
+        perror("Couldn't create pipe");
+        return 1;
+    }
+
+    *pid = fork();
+    if (*pid == -1)
+    {
+        perror("Couldn't fork");
+        close(pipefd[0]);
+        close(pipefd[1]);
+        return 1;
+    }
+
+    if (*pid == 0)
+    {
+        // Child process: exec gunzip.
+        dup2(pipefd[1], STDOUT_FILENO);
+        close(pipefd[0]);
+        close(pipefd[1]);
+        execlp("gunzip", "gunzip", "-c", filename, NULL);
+        perror("Couldn't exec gunzip");
+        fprintf(stderr, "Is gunzip installed?\n");
+        exit(127);
+    }
+
+    // Parent process: return the read end of the pipe.
+    *fd = pipefd[0];
+    close(pipefd[1]);
+    return 0;
+}
+
+/**
+ * Check whether a regular file starts with the gzip magic bytes.
+ *
+ * @param fd the file
+ * @return true if the file is gzip-compressed
+ */
+static bool is_gzip(int fd)
+{
+    uint8_t magic[2];
+    return pread(fd, magic, sizeof(magic), 0) == sizeof(magic) &&
+           magic[0] == 0x1F && magic[1] == 0x8B;
+}
+
+/**
+ * Open a trace that is not a regular file, such as a pipe, which can be
+ * neither sniffed with pread() nor mapped. The bytes read to tell whether it
+ * is gzip-compressed are left in in_buf, to be inflated, or handed out first
+ * if it is not compressed.
+ *
+ * @param tf the trace file, whose fd is open
+ * @return 0 on success, nonzero on failure
+ */
+static int open_stream(TraceFile *tf)
+{
+    uint8_t magic[2];
+    size_t magic_size = 0;
+    while (magic_size < sizeof(magic))
+    {
+        ssize_t bytes_read =
+            read(tf->fd, magic + magic_size, sizeof(magic) - magic_size);
+        tf->stat_syscalls++;
+        if (bytes_read == -1)
+        {
+            perror("Couldn't read from trace file");
+            return 1;
+        }
+        if (bytes_read == 0)
+        {
+            break;
+        }
+        magic_size += bytes_read;
+    }
+
+    if (magic_size < sizeof(magic) || magic[0] != 0x1F || magic[1] != 0x8B)
+    {
+        // An uncompressed trace: read it as is.
+        tf->raw = true;
+    }
+    else if (inflateInit2(&tf->zs, 15 + 32) != Z_OK)
+    {
+        // 15 + 32: maximum window size, and accept a gzip or zlib header.
+        fprintf(stderr, "Error: couldn't initialize zlib\n");
+        return 1;
+    }
+
+    tf->in_buf = (uint8_t *)malloc(TRACEFILE_IN_BUF_SIZE);
+    tf->out_buf = (uint8_t *)malloc(TRACEFILE_OUT_BUF_SIZE);
+    memcpy(tf->in_buf, magic, magic_size);
+    tf->zs.next_in = tf->in_buf;
+    tf->zs.avail_in = magic_size;
+    return 0;
+}
+
+/**
+ * Memory-map an uncompressed trace file.
+ *
+ * @param tf the trace file, whose fd is open
+ * @return 0 on success, nonzero on failure
+ */
+static int map_trace(TraceFile *tf)
+{
+    struct stat st;
+    if (fstat(tf->fd, &st) != 0)
+    {
+        perror("Couldn't stat trace file");
+        return 1;
+    }
+
+    tf->mapped = true;
+    tf->map_size = st.st_size;
+    if (tf->map_size == 0)
+    {
+        // mmap() rejects empty mappings; an empty trace just has no records.
+        return 0;
+    }
+
+    void *map = mmap(NULL, tf->map_size, PROT_READ, MAP_PRIVATE, tf->fd, 0);
+    if (map == MAP_FAILED)
+    {
+        perror("Couldn't map trace file");
+        return 1;
+    }
+    tf->map = (uint8_t *)map;
+
+    // The trace is read front to back exactly once. These are only hints, so
+    // failures are ignored.
+    madvise(tf->map, tf->map_size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    madvise(tf->map, tf->map_size, MADV_HUGEPAGE);
+#endif
+    return 0;
+}
+
+TraceFile *tracefile_open(const char *filename, bool use_gunzip)
+{
+    TraceFile *tf = (TraceFile *)calloc(1, sizeof(TraceFile));
+    tf->pid = -1;
+
+    tf->fd = open(filename, O_RDONLY);
+    if (tf->fd == -1)
+    {
+        perror("Couldn't open trace file");
+        free(tf);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(tf->fd, &st) != 0)
+    {
+        perror("Couldn't stat trace file");
+        close(tf->fd);
+        free(tf);
+        return NULL;
+    }
+
+    if (!S_ISREG(st.st_mode) && !use_gunzip)
+    {
+        if (open_stream(tf) != 0)
+        {
+            close(tf->fd);
+            free(tf);
+            return NULL;
+        }
+        return tf;
+    }
+
+    if (S_ISREG(st.st_mode) && !is_gzip(tf->fd))
+    {
+        // An uncompressed trace: map it, whether or not gunzip was asked for.
+        if (map_trace(tf) != 0)
+        {
+            close(tf->fd);
+            free(tf);
+            return NULL;
+        }
+        return tf;
+    }
+
+    if (use_gunzip)
+    {
+        // gunzip reads the file itself, so a pipe is passed on unread.
+        close(tf->fd);
+        if (open_gunzip_pipe(filename, &tf->fd, &tf->pid) != 0)
+        {
+            free(tf);
+            return NULL;
+        }
+        tf->out_buf = (uint8_t *)malloc(TRACEFILE_OUT_BUF_SIZE);
+        return tf;
+    }
+
+    posix_fadvise(tf->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    // 15 + 32: maximum window size, and accept either a gzip or zlib header.
+    if (inflateInit2(&tf->zs, 15 + 32) != Z_OK)
+    {
+        fprintf(stderr, "Error: couldn't initialize zlib\n");
+        close(tf->fd);
+        free(tf);
+        return NULL;
+    }
+
+    tf->in_buf = (uint8_t *)malloc(TRACEFILE_IN_BUF_SIZE);
+    tf->out_buf = (uint8_t *)malloc(TRACEFILE_OUT_BUF_SIZE);
+    return tf;
+}
+
+/**
+ * Read the next block of compressed input, if the previous one is used up.
+ *
+ * @param tf the trace file
+ * @return 0 on success (including at the end of the file), or -1 on error
+ */
+static int tracefile_fill(TraceFile *tf)
+{
+    if (tf->zs.avail_in > 0 || tf->in_eof)
+    {
+        return 0;
+    }
+
+    ssize_t bytes_read = read(tf->fd, tf->in_buf, TRACEFILE_IN_BUF_SIZE);
+    tf->stat_syscalls++;
+    if (bytes_read == -1)
+    {
+        perror("Couldn't read from trace file");
+        tf->error = true;
+        return -1;
+    }
+    tf->in_eof = (bytes_read == 0);
+    tf->zs.next_in = tf->in_buf;
+    tf->zs.avail_in = bytes_read;
+    return 0;
+}
+
+/**
+ * Inflate up to size bytes of the trace into dst.
+ *
+ * Keeps going until dst is full or the last gzip member has ended, reading
+ * more compressed input as needed. Like gunzip, this treats concatenated gzip
+ * members as one stream.
+ *
+ * @param tf the trace file
+ * @param dst the buffer to inflate into
+ * @param size the size of dst
+ * @return the number of bytes inflated, or -1 on error
+ */
+static ssize_t tracefile_inflate(TraceFile *tf, uint8_t *dst, size_t size)
+{
+    tf->zs.next_out = dst;
+    tf->zs.avail_out = size;
+
+    while (tf->zs.avail_out > 0 && !tf->done)
+    {
+        if (tracefile_fill(tf) != 0)
+        {
+            return -1;
+        }
+
+        int ret = inflate(&tf->zs, Z_NO_FLUSH);
+        if (ret == Z_STREAM_END)
+        {
+            // Either the end of the trace, or another gzip member follows.
+            if (tracefile_fill(tf) != 0)
+            {
+                return -1;
+            }
+            if (tf->zs.avail_in == 0)
+            {
+                tf->done = true;
+            }
+            else
+            {
+                inflateReset(&tf->zs);
+            }
+        }
+        else if (ret == Z_BUF_ERROR && tf->zs.avail_in == 0 && tf->in_eof)
+        {
+            fprintf(stderr, "Error: trace file is truncated\n");
+            tf->error = true;
+            return -1;
+        }
+        else if (ret != Z_OK && ret != Z_BUF_ERROR)
+        {
+            fprintf(stderr, "Error: couldn't decompress trace file: %s\n",
+                    tf->zs.msg ? tf->zs.msg : "unknown error");
+            tf->error = true;
+            return -1;
+        }
+    }
+
+    return size - tf->zs.avail_out;
+}
+
+/**
+ * Read the next stretch of decompressed trace data into dst, either from
+ * gunzip or by inflating it.
+ *
+ * Inflating fills dst unless the trace ends first. Reading from gunzip issues
+ * a single read(), which may come up short.
+ *
+ * @param tf the trace file
+ * @param dst the buffer to read into
+ * @param size the size of dst
+ * @return the number of bytes read, 0 at the end of the trace, or -1 on error
+ */
+static ssize_t tracefile_produce(TraceFile *tf, uint8_t *dst, size_t size)
+{
+    if (tf->pid == -1 && !tf->raw)
+    {
+        return tracefile_inflate(tf, dst, size);
+    }
+
+    if (tf->raw && tf->zs.avail_in > 0)
+    {
+        // Hand out the bytes read by open_stream() first.
+        size_t bytes_read = size < tf->zs.avail_in ? size : tf->zs.avail_in;
+        memcpy(dst, tf->zs.next_in, bytes_read);
+        tf->zs.next_in += bytes_read;
+        tf->zs.avail_in -= bytes_read;
+        return bytes_read;
+    }
+
+    ssize_t bytes_read = read(tf->fd, dst, size);
+    tf->stat_syscalls++;
+    if (bytes_read == -1)
+    {
+        perror(tf->raw ? "Couldn't read from trace file"
+                       : "Couldn't read from pipe");
+        tf->error = true;
+        return -1;
+    }
+    tf->done = (bytes_read == 0);
+    return bytes_read;
+}
+
+/**
+ * Fill one slot of a prefetch ring as far as possible, which takes several
+ * reads from gunzip.
+ *
+ * @param source the trace file to decompress
+ * @param dst the slot
+ * @return the number of bytes read, which is less than TRACEFILE_OUT_BUF_SIZE
+ *         only at the end of the trace, or -1 on error
+ */
+static ssize_t prefetch_fill(TraceFile *source, uint8_t *dst)
+{
+    size_t size = 0;
+    while (size < TRACEFILE_OUT_BUF_SIZE && !source->done)
+    {
+        ssize_t bytes_produced = tracefile_produce(
+            source, dst + size, TRACEFILE_OUT_BUF_SIZE - size);
+        if (bytes_produced == -1)
+        {
+            return -1;
+        }
+        size += bytes_produced;
+    }
+    return size;
+}
+
+/**
+ * The body of a prefetch thread: decompress the trace into the ring until the
+ * trace ends, an error occurs, or the reader stops it.
+ *
+ * @param pf the ring
+ */
+static void prefetch_run(TracePrefetch *pf)
+{
+    for (uint64_t filled = 0;; filled++)
+    {
+        // Wait for the reader to give back a slot.
+        while (filled - pf->released.load(std::memory_order_acquire) ==
+               TRACEFILE_PREFETCH_SLOTS)
+        {
+            if (pf->stop.load(std::memory_order_relaxed))
+            {
+                return;
+            }
+            std::this_thread::yield();
+        }
+        if (pf->stop.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+
+        unsigned int slot = filled % TRACEFILE_PREFETCH_SLOTS;
+        ssize_t size = prefetch_fill(pf->source, pf->slots[slot]);
+        pf->slot_sizes[slot] = size;
+        pf->filled.store(filled + 1, std::memory_order_release);
+        if (size < (ssize_t)TRACEFILE_OUT_BUF_SIZE)
+        {
+            return; // The end of the trace, or an error.
+        }
+    }
+}
+
+TraceFile *tracefile_open_prefetch(const char *filename, bool use_gunzip)
+{
+    TraceFile *source = tracefile_open(filename, use_gunzip);
+    if (source == NULL || source->mapped)
+    {
+        return source;
+    }
+
+    // The ring is over-aligned, which plain new doesn't honor before C++17.
+    void *mem;
+    if (posix_memalign(&mem, CACHE_LINE_SIZE, sizeof(TracePrefetch)) != 0)
+    {
+        fprintf(stderr, "Error: couldn't allocate prefetch ring\n");
+        tracefile_close(source);
+        return NULL;
+    }
+    TracePrefetch *pf = new (mem) TracePrefetch();
+    pf->source = source;
+    for (unsigned int i = 0; i < TRACEFILE_PREFETCH_SLOTS; i++)
+    {
+        if (posix_memalign(&mem, CACHE_LINE_SIZE, TRACEFILE_OUT_BUF_SIZE) != 0)
+        {
+            fprintf(stderr, "Error: couldn't allocate prefetch ring\n");
+            for (unsigned int j = 0; j < i; j++)
+            {
+                free(pf->slots[j]);
+            }
+            pf->~TracePrefetch();
+            free(pf);
+            tracefile_close(source);
+            return NULL;
+        }
+        pf->slots[i] = (uint8_t *)mem;
+    }
+
+    TraceFile *tf = (TraceFile *)calloc(1, sizeof(TraceFile));
+    tf->fd = -1;
+    tf->pid = -1;
+    tf->prefetch = pf;
+    pf->thread = std::thread(prefetch_run, pf);
+    return tf;
+}
+
+/**
+ * Take the next filled slot of the prefetch ring as out_buf, giving back the
+ * slot out_buf was until now.
+ *
+ * @param tf the trace file
+ * @return the number of bytes in the slot, 0 at the end of the trace, or -1 on
+ *         error
+ */
+static ssize_t prefetch_take(TraceFile *tf)
+{
+    TracePrefetch *pf = tf->prefetch;
+    if (pf->taken > 0)
+    {
+        pf->released.store(pf->taken, std::memory_order_release);
+    }
+
+    while (pf->filled.load(std::memory_order_acquire) == pf->taken)
+    {
+        std::this_thread::yield();
+    }
+
+    unsigned int slot = pf->taken++ % TRACEFILE_PREFETCH_SLOTS;
+    ssize_t size = pf->slot_sizes[slot];
+    tf->out_buf = pf->slots[slot];
+    if (size < (ssize_t)TRACEFILE_OUT_BUF_SIZE)
+    {
+        // The thread has exited and already reported any error.
+        tf->done = true;
+        tf->error = (size == -1);
+    }
+    return size;
+}
+
+/**
+ * Replace the data in out_buf, which has all been handed out, with the next
+ * stretch of decompressed trace data.
+ *
+ * @param tf the trace file
+ * @return 0 on success (including at the end of the trace), or -1 on error
+ */
+static int tracefile_refill(TraceFile *tf)
+{
+    ssize_t bytes_produced;
+    if (tf->prefetch != NULL)
+    {
+        bytes_produced = prefetch_take(tf);
+    }
+    else
+    {
+        bytes_produced =
+            tracefile_produce(tf, tf->out_buf, TRACEFILE_OUT_BUF_SIZE);
+    }
+    if (bytes_produced == -1)
+    {
+        return -1;
+    }
+    tf->out_offset = 0;
+    tf->out_left = bytes_produced;
+    return 0;
+}
+
+ssize_t tracefile_read(TraceFile *tf, void *buf, size_t size)
+{
+    if (tf->mapped)
+    {
+        const void *data;
+        ssize_t bytes_read = tracefile_next(tf, &data, size);
+        if (bytes_read > 0)
+        {
+            memcpy(buf, data, bytes_read);
+        }
+        return bytes_read;
+    }
+
+    if (tf->error)
+    {
+        return -1;
+    }
+
+    uint8_t *bytes = (uint8_t *)buf;
+    size_t bytes_read_total = 0;
+    while (bytes_read_total < size)
+    {
+        size_t bytes_left = size - bytes_read_total;
+
+        if (tf->out_left > 0)
+        {
+            // Hand out what is already buffered.
+            size_t bytes_to_copy =
+                bytes_left < tf->out_left ? bytes_left : tf->out_left;
+            memcpy(bytes + bytes_read_total, tf->out_buf + tf->out_offset,
+                   bytes_to_copy);
+            tf->out_offset += bytes_to_copy;
+            tf->out_left -= bytes_to_copy;
+            bytes_read_total += bytes_to_copy;
+            continue;
+        }
+
+        if (tf->done)
+        {
+            break;
+        }
+
+        if (bytes_left >= TRACEFILE_OUT_BUF_SIZE && tf->prefetch == NULL)
+        {
+            // Large read: go directly into the caller's buffer.
+            ssize_t bytes_produced =
+                tracefile_produce(tf, bytes + bytes_read_total, bytes_left);
+            if (bytes_produced == -1)
+            {
+                return -1;
+            }
+            bytes_read_total += bytes_produced;
+        }
+        else if (tracefile_refill(tf) != 0)
+        {
+            return -1;
+        }
+    }
+
+    tf->stat_bytes += bytes_read_total;
+    return bytes_read_total;
+}
+
+ssize_t tracefile_next(TraceFile *tf, const void **data, size_t size)
+{
+    if (tf->mapped)
+    {
+        size_t bytes_left = tf->map_size - tf->map_offset;
+        size_t bytes_read = size < bytes_left ? size : bytes_left;
+        *data = tf->map + tf->map_offset;
+        tf->map_offset += bytes_read;
+        tf->stat_bytes += bytes_read;
+        return bytes_read;
+    }
+
+    if (tf->error)
+    {
+        return -1;
+    }
+
+    if (tf->out_left == 0 && !tf->done && tracefile_refill(tf) != 0)
+    {
+        return -1;
+    }
+
+    if (tf->out_left >= size || tf->done)
+    {
+        // Hand out the buffered data in place.
+        size_t bytes_read = size < tf->out_left ? size : tf->out_left;
+        *data = tf->out_buf + tf->out_offset;
+        tf->out_offset += bytes_read;
+        tf->out_left -= bytes_read;
+        tf->stat_bytes += bytes_read;
+        return bytes_read;
+    }
+
+    // The data straddles two fills of out_buf, so gather it into next_buf.
+    if (tf->next_buf == NULL)
+    {
+        tf->next_buf = (uint8_t *)malloc(TRACEFILE_OUT_BUF_SIZE);
+    }
+    *data = tf->next_buf;
+    return tracefile_read(tf, tf->next_buf, size);
+}
+
+ssize_t tracefile_skip(TraceFile *tf, size_t size)
+{
+    if (tf->mapped)
+    {
+        size_t bytes_left = tf->map_size - tf->map_offset;
+        size_t bytes_skipped = size < bytes_left ? size : bytes_left;
+        tf->map_offset += bytes_skipped;
+        return bytes_skipped;
+    }
+
+    if (tf->error)
+    {
+        return -1;
+    }
+
+    size_t bytes_skipped = 0;
+    while (bytes_skipped < size)
+    {
+        if (tf->out_left > 0)
+        {
+            size_t bytes_left = size - bytes_skipped;
+            size_t bytes_to_skip =
+                bytes_left < tf->out_left ? bytes_left : tf->out_left;
+            tf->out_offset += bytes_to_skip;
+            tf->out_left -= bytes_to_skip;
+            bytes_skipped += bytes_to_skip;
+            continue;
+        }
+
+        if (tf->done)
+        {
+            break;
+        }
+
+        if (tracefile_refill(tf) != 0)
+        {
+            return -1;
+        }
+    }
+
+    return bytes_skipped;
+}
+
+int tracefile_close(TraceFile *tf)
+{
+    int status = 0;
+
+    if (tf->prefetch != NULL)
+    {
+        TracePrefetch *pf = tf->prefetch;
+        pf->stop.store(true, std::memory_order_relaxed);
+        pf->thread.join();
+        status = tracefile_close(pf->source);
+        for (unsigned int i = 0; i < TRACEFILE_PREFETCH_SLOTS; i++)
+        {
+            free(pf->slots[i]);
+        }
+        pf->~TracePrefetch();
+        free(pf);
+        free(tf->next_buf);
+        free(tf);
+        return status;
+    }
+
+    close(tf->fd);
+    if (tf->mapped)
+    {
+        if (tf->map != NULL)
+        {
+            munmap(tf->map, tf->map_size);
+        }
+    }
+    else if (tf->pid != -1)
+    {
+        // Wait for the child process to finish.
+        waitpid(tf->pid, &status, 0);
+        status = WEXITSTATUS(status);
+    }
+    else
+    {
+        if (!tf->raw)
+        {
+            inflateEnd(&tf->zs);
+        }
+        free(tf->in_buf);
+    }
+
+    free(tf->out_buf);
+    free(tf->next_buf);
+    free(tf);
+    return status;
+}
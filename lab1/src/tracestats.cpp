@@ -0,0 +1,90 @@
+// tracestats.cpp
+// Implements the mergeable set of trace statistics.
+
+#include "tracestats.h"
+#include "optypehist.h"
+#include <stdlib.h>
+
+extern UniquePCMode UNIQUE_PC_MODE;
+extern uint32_t HLL_PRECISION;
+extern uint32_t HOTSPOT_TOP_N;
+
+TraceStats *tracestats_new()
+{
+    TraceStats *stats = (TraceStats *)calloc(1, sizeof(TraceStats));
+    if (UNIQUE_PC_MODE != UNIQUE_PC_HLL)
+    {
+        stats->pcs = pcset_new(PCSET_DEFAULT_CAPACITY);
+    }
+    if (UNIQUE_PC_MODE != UNIQUE_PC_EXACT)
+    {
+        stats->hll = hll_new(HLL_PRECISION);
+    }
+    if (HOTSPOT_TOP_N > 0)
+    {
+        stats->pc_counts = pcmap_new(PCSET_DEFAULT_CAPACITY);
+    }
+    return stats;
+}
+
+void tracestats_free(TraceStats *stats)
+{
+    if (stats == NULL)
+    {
+        return;
+    }
+    pcset_free(stats->pcs);
+    hll_free(stats->hll);
+    pcmap_free(stats->pc_counts);
+    free(stats);
+}
+
+void tracestats_analyze(TraceStats *stats, const TraceRec *t, size_t n)
+{
+    // Quantify the mix of the dynamic instruction stream. This is also all
+    // the CPI models need; see cpimodel.h.
+    optypehist_count(t, n, stats->optype_dyn);
+
+    // Estimate the instruction footprint by counting the number of unique PCs
+    // in the benchmark trace.
+    if (stats->pcs != NULL)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            pcset_insert(stats->pcs, t[i].inst_addr);
+        }
+    }
+    if (stats->hll != NULL)
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            hll_add(stats->hll, t[i].inst_addr);
+        }
+    }
+
+    // Count every execution of every PC to find the hot spots.
+    if (stats->pc_counts != NULL)
+    {
+        hotspot_add(stats->pc_counts, t, n);
+    }
+}
+
+void tracestats_merge(TraceStats *dst, const TraceStats *src)
+{
+    for (int i = 0; i < NUM_OP_TYPES; i++)
+    {
+        dst->optype_dyn[i] += src->optype_dyn[i];
+    }
+    if (dst->pcs != NULL)
+    {
+        pcset_merge(dst->pcs, src->pcs);
+    }
+    if (dst->hll != NULL)
+    {
+        hll_merge(dst->hll, src->hll);
+    }
+    if (dst->pc_counts != NULL)
+    {
+        hotspot_merge(dst->pc_counts, src->pc_counts);
+    }
+}
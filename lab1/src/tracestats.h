@@ -0,0 +1,81 @@
+// tracestats.h
+// Declares a mergeable set of trace statistics.
+//
+// Each thread analyzing part of a trace keeps its own TraceStats. Since every
+// statistic is a sum or a set union, the per-thread results can be merged in
+// any order and give the same totals as analyzing the trace sequentially.
+
+#ifndef _TRACESTATS_H_
+#define _TRACESTATS_H_
+
+#include "hll.h"
+#include "hotspot.h"
+#include "pcset.h"
+#include "trace.h"
+#include <inttypes.h>
+#include <stddef.h>
+
+/** How the number of unique PCs is counted. */
+typedef enum UniquePCModeEnum
+{
+    UNIQUE_PC_EXACT, // Keep every PC in a PCSet
+    UNIQUE_PC_HLL,   // Estimate with a HyperLogLog sketch in constant memory
+    UNIQUE_PC_BOTH,  // Do both, to measure the error of the estimate
+} UniquePCMode;
+
+/** Statistics gathered from (part of) a trace. */
+typedef struct TraceStats
+{
+    /** The number of instructions executed, by op type. */
+    uint64_t optype_dyn[NUM_OP_TYPES];
+
+    /** The set of PCs executed, or NULL in UNIQUE_PC_HLL mode. */
+    PCSet *pcs;
+
+    /** A sketch of the PCs executed, or NULL in UNIQUE_PC_EXACT mode. */
+    HLL *hll;
+
+    /**
+     * The execution count and op type of every PC (see hotspot.h), or NULL
+     * if the hot-spot profile is disabled.
+     */
+    PCMap *pc_counts;
+} TraceStats;
+
+/**
+ * Allocate and initialize an empty set of statistics.
+ *
+ * Which unique-PC counters are kept depends on UNIQUE_PC_MODE and
+ * HLL_PRECISION, which are set by the command-line arguments -uniquepc and
+ * -hllprecision. The hot-spot profile is kept if HOTSPOT_TOP_N, set by
+ * -hotspots, is not 0.
+ *
+ * @return a pointer to newly allocated statistics
+ */
+TraceStats *tracestats_new();
+
+/**
+ * Free a set of statistics.
+ *
+ * @param stats the statistics to free
+ */
+void tracestats_free(TraceStats *stats);
+
+/**
+ * Update a set of statistics with a batch of trace records.
+ *
+ * @param stats the statistics to update
+ * @param t the first trace record of the batch
+ * @param n the number of records in the batch
+ */
+void tracestats_analyze(TraceStats *stats, const TraceRec *t, size_t n);
+
+/**
+ * Add the statistics from src into dst.
+ *
+ * @param dst the statistics to update
+ * @param src the statistics to add
+ */
+void tracestats_merge(TraceStats *dst, const TraceStats *src);
+
+#endif
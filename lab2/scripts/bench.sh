@@ -0,0 +1,51 @@
+#!/bin/bash
+
+######################################################################################
+# This script measures the throughput of the simulator on the A and B
+# configurations of runall.sh, and on pipelines 1, 2, 4 and 8 wide (W1-W8)
+# You will need to first compile your code in ../src (make fast) before launching it
+# Optionally pass the path of a baseline sim binary to compare against, e.g. one
+# built from an older commit: bash ../scripts/bench.sh /tmp/sim.old
+# Any further arguments are passed to every simulator run
+######################################################################################
+
+baseline="$1"
+shift
+sim_args=("$@")
+
+configs=(
+    "A1:-pipewidth 1"
+    "A2:-pipewidth 2"
+    "A3:-pipewidth 2 -enablememfwd -enableexefwd"
+    "B1:-pipewidth 2 -enablememfwd -enableexefwd -bpredpolicy 1"
+    "B2:-pipewidth 2 -enablememfwd -enableexefwd -bpredpolicy 2"
+    "W1:-pipewidth 1 -enablememfwd -enableexefwd -bpredpolicy 2"
+    "W2:-pipewidth 2 -enablememfwd -enableexefwd -bpredpolicy 2"
+    "W4:-pipewidth 4 -enablememfwd -enableexefwd -bpredpolicy 2"
+    "W8:-pipewidth 8 -enablememfwd -enableexefwd -bpredpolicy 2"
+)
+
+# Run one simulator on one trace and print its throughput in cycles/sec.
+run_one() {
+    local sim="$1"
+    local trace="$2"
+    shift 2
+    local start end num_cycles
+    start=$(date +%s.%N)
+    num_cycles=$("$sim" "$@" "${sim_args[@]}" "$trace" | awk '/^LAB2_NUM_CYCLES/ { print $3 }')
+    end=$(date +%s.%N)
+    awk -v n="$num_cycles" -v s="$start" -v e="$end" \
+        'BEGIN { t = e - s; printf "%10d cycles  %8.3f s  %12.0f cycles/sec", n, t, n / t }'
+}
+
+for trace in bzip2 gcc libq mcf; do
+    echo "$trace:"
+    for config in "${configs[@]}"; do
+        name="${config%%:*}"
+        read -r -a args <<< "${config#*:}"
+        printf "    %-8s: %s\n" "$name" "$(run_one ../src/sim ../traces/$trace.ptr.gz "${args[@]}")"
+        if [[ -n "$baseline" ]]; then
+            printf "    %-8s: %s\n" "baseline" "$(run_one "$baseline" ../traces/$trace.ptr.gz "${args[@]}")"
+        fi
+    done
+done
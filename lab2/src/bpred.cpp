@@ -8,9 +8,689 @@
 // Implements the branch predictor class.
 
 #include "bpred.h"
+#include "pht.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+/** The names of the branch prediction policies, as accepted by -bpredpolicy. */
+static const char *const BPRED_POLICY_NAMES[NUM_BPRED_POLICIES] = {
+    "perfect", "taken", "gshare", "bimodal", "tournament", "perceptron",
+    "tage"};
+
+const char *bpred_policy_name(BPredPolicy policy)
+{
+    return BPRED_POLICY_NAMES[policy];
+}
+
+bool bpred_policy_parse(const char *name, BPredPolicy *policy)
+{
+    for (int i = 0; i < NUM_BPRED_POLICIES; i++)
+    {
+        if (strcmp(name, BPRED_POLICY_NAMES[i]) == 0)
+        {
+            *policy = (BPredPolicy)i;
+            return true;
+        }
+    }
+
+    char *end;
+    long number = strtol(name, &end, 10);
+    if (*name == '\0' || *end != '\0' || number < 0 ||
+        number >= NUM_BPRED_POLICIES)
+    {
+        return false;
+    }
+    *policy = (BPredPolicy)number;
+    return true;
+}
+
+uint32_t bpred_max_hist_len(BPredPolicy policy)
+{
+    switch (policy)
+    {
+    case BPRED_GSHARE:
+    case BPRED_TOURNAMENT:
+    case BPRED_PERCEPTRON:
+        return BPRED_MAX_WORD_HIST_LEN;
+    default:
+        return BPRED_MAX_HIST_LEN;
+    }
+}
+
+/**
+ * Implement BPredAlgorithm::replay() for an algorithm by calling its own
+ * predict() and update() directly, so that they can be inlined.
+ */
+template <class Algorithm>
+static uint64_t bpred_replay(Algorithm *algorithm, const uint64_t *pcs,
+                             const BranchDirection *dirs, size_t count)
+{
+    uint64_t num_mispred = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        num_mispred += algorithm->Algorithm::predict(pcs[i]) != dirs[i];
+        algorithm->Algorithm::update(pcs[i], dirs[i]);
+    }
+    return num_mispred;
+}
+
+/** Predicts every branch taken. */
+class AlwaysTakenBPred : public BPredAlgorithm
+{
+public:
+    BranchDirection predict(uint64_t pc)
+    {
+        return TAKEN;
+    }
+
+    void update(uint64_t pc, BranchDirection resolution)
+    {
+    }
+
+    uint64_t replay(const uint64_t *pcs, const BranchDirection *dirs,
+                    size_t count)
+    {
+        return bpred_replay(this, pcs, dirs, count);
+    }
+};
+
+/** The outcomes of the last hist_len branches, the latest in bit 0. */
+class GlobalHistory
+{
+private:
+    uint64_t history;
+    uint64_t mask;
+    uint32_t fold_bits;
+
+public:
+    /**
+     * @param hist_len the number of outcomes to keep
+     * @param fold_bits the width of the value fold() returns
+     */
+    GlobalHistory(uint32_t hist_len, uint32_t fold_bits)
+        : history(0),
+          mask(hist_len >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << hist_len) - 1),
+          fold_bits(fold_bits)
+    {
+    }
+
+    /** Get outcome i branches ago, as 1 for taken or 0 for not taken. */
+    uint32_t outcome(uint32_t i) const
+    {
+        return (history >> i) & 1;
+    }
+
+    /** XOR the history down to fold_bits bits, to index a table. */
+    uint64_t fold() const
+    {
+        uint64_t folded = 0;
+        for (uint64_t h = history; h != 0; h >>= fold_bits)
+        {
+            folded ^= h;
+        }
+        return folded;
+    }
+
+    void push(BranchDirection resolution)
+    {
+        history = ((history << 1) | (resolution == TAKEN)) & mask;
+    }
+};
+
+/** Predicts each branch from a counter indexed by its address. */
+class BimodalBPred : public BPredAlgorithm
+{
+private:
+    CounterTable pht;
+    uint32_t last_index;
+
+public:
+    BimodalBPred(uint32_t table_bits) : pht(table_bits), last_index(0)
+    {
+    }
+
+    BranchDirection predict(uint64_t pc)
+    {
+        last_index = pht.index(pc);
+        return pht.predict(last_index);
+    }
+
+    void update(uint64_t pc, BranchDirection resolution)
+    {
+        pht.update(last_index, resolution);
+    }
+
+    uint64_t replay(const uint64_t *pcs, const BranchDirection *dirs,
+                    size_t count)
+    {
+        return bpred_replay(this, pcs, dirs, count);
+    }
+};
+
+/**
+ * Predicts each branch from a counter indexed by its address XORed with the
+ * global history.
+ */
+class GshareBPred : public BPredAlgorithm
+{
+private:
+    CounterTable pht;
+    GlobalHistory ghr;
+    uint32_t last_index;
+
+public:
+    GshareBPred(uint32_t table_bits, uint32_t hist_len)
+        : pht(table_bits), ghr(hist_len, table_bits), last_index(0)
+    {
+    }
+
+    BranchDirection predict(uint64_t pc)
+    {
+        last_index = pht.index(pc ^ ghr.fold());
+        return pht.predict(last_index);
+    }
+
+    void update(uint64_t pc, BranchDirection resolution)
+    {
+        pht.update(last_index, resolution);
+        ghr.push(resolution);
+    }
+
+    uint64_t replay(const uint64_t *pcs, const BranchDirection *dirs,
+                    size_t count)
+    {
+        return bpred_replay(this, pcs, dirs, count);
+    }
+};
+
+/**
+ * Predicts each branch with Bimodal or Gshare, whichever a counter indexed by
+ * the branch's address says has been right more often for it lately.
+ */
+class TournamentBPred : public BPredAlgorithm
+{
+private:
+    BimodalBPred bimodal;
+    GshareBPred gshare;
+    /** Counters of 2 or more choose Gshare. */
+    CounterTable chooser;
+    BranchDirection last_bimodal;
+    BranchDirection last_gshare;
+    uint32_t last_index;
+
+public:
+    TournamentBPred(uint32_t table_bits, uint32_t hist_len)
+        : bimodal(table_bits), gshare(table_bits, hist_len),
+          chooser(table_bits), last_bimodal(NOT_TAKEN),
+          last_gshare(NOT_TAKEN), last_index(0)
+    {
+    }
+
+    BranchDirection predict(uint64_t pc)
+    {
+        last_bimodal = bimodal.predict(pc);
+        last_gshare = gshare.predict(pc);
+        last_index = chooser.index(pc);
+        return chooser.predict(last_index) == TAKEN ? last_gshare
+                                                    : last_bimodal;
+    }
+
+    void update(uint64_t pc, BranchDirection resolution)
+    {
+        if (last_bimodal != last_gshare)
+        {
+            chooser.update(last_index,
+                           last_gshare == resolution ? TAKEN : NOT_TAKEN);
+        }
+        bimodal.update(pc, resolution);
+        gshare.update(pc, resolution);
+    }
+
+    uint64_t replay(const uint64_t *pcs, const BranchDirection *dirs,
+                    size_t count)
+    {
+        return bpred_replay(this, pcs, dirs, count);
+    }
+};
+
+/**
+ * Predicts each branch from the sign of a perceptron's dot product with the
+ * global history (Jimenez and Lin, HPCA 2001).
+ */
+class PerceptronBPred : public BPredAlgorithm
+{
+private:
+    /** The bias weight, then one weight per history bit, per perceptron. */
+    std::vector<int8_t> weights;
+    uint32_t mask;
+    uint32_t hist_len;
+    GlobalHistory ghr;
+    /** Train when the output is no further than this from 0. */
+    int32_t threshold;
+    int8_t *last_weights;
+    int32_t last_output;
+
+    static int8_t train(int8_t weight, bool agree)
+    {
+        if (agree)
+        {
+            return weight < 127 ? weight + 1 : weight;
+        }
+        return weight > -127 ? weight - 1 : weight;
+    }
+
+public:
+    PerceptronBPred(uint32_t table_bits, uint32_t hist_len)
+        : weights(((size_t)1 << table_bits) * (hist_len + 1), 0),
+          mask((1u << table_bits) - 1), hist_len(hist_len),
+          ghr(hist_len, table_bits), threshold((int32_t)(1.93 * hist_len + 14)),
+          last_weights(&weights[0]), last_output(0)
+    {
+    }
+
+    BranchDirection predict(uint64_t pc)
+    {
+        last_weights = &weights[((uint32_t)pc & mask) * (size_t)(hist_len + 1)];
+        int32_t output = last_weights[0];
+        for (uint32_t i = 0; i < hist_len; i++)
+        {
+            output += ghr.outcome(i) ? last_weights[i + 1]
+                                     : -last_weights[i + 1];
+        }
+        last_output = output;
+        return output >= 0 ? TAKEN : NOT_TAKEN;
+    }
+
+    void update(uint64_t pc, BranchDirection resolution)
+    {
+        bool taken = (resolution == TAKEN);
+        if ((last_output >= 0) != taken || abs(last_output) <= threshold)
+        {
+            last_weights[0] = train(last_weights[0], taken);
+            for (uint32_t i = 0; i < hist_len; i++)
+            {
+                last_weights[i + 1] = train(last_weights[i + 1],
+                                            (ghr.outcome(i) == 1) == taken);
+            }
+        }
+        ghr.push(resolution);
+    }
+
+    uint64_t replay(const uint64_t *pcs, const BranchDirection *dirs,
+                    size_t count)
+    {
+        return bpred_replay(this, pcs, dirs, count);
+    }
+};
+
+/** The number of tagged tables of TAGE. */
+#define TAGE_NUM_TABLES 7
+
+/** The history length of TAGE's first tagged table. */
+#define TAGE_MIN_HIST 4
+
+/** The number of branches between halvings of TAGE's useful counters. */
+#define TAGE_U_RESET_PERIOD (1 << 18)
+
+/**
+ * A history register folded down to a table's index or tag width, kept up to
+ * date one outcome at a time instead of refolding the whole history
+ * (Michaud, "A PPM-like, tag-based branch predictor", JILP 2005).
+ */
+class FoldedHistory
+{
+private:
+    uint32_t value;
+    uint32_t hist_len;
+    uint32_t width;
+    /** Where the outcome leaving the history lands in the folded value. */
+    uint32_t outpoint;
+
+public:
+    FoldedHistory() : value(0), hist_len(0), width(1), outpoint(0)
+    {
+    }
+
+    /**
+     * @param hist_len the number of outcomes folded
+     * @param width the width of the folded value
+     */
+    void init(uint32_t hist_len, uint32_t width)
+    {
+        this->value = 0;
+        this->hist_len = hist_len;
+        this->width = width;
+        this->outpoint = hist_len % width;
+    }
+
+    uint32_t get() const
+    {
+        return value;
+    }
+
+    /**
+     * @param newest the outcome just pushed, 1 for taken
+     * @param oldest the outcome hist_len branches before it, which just left
+     */
+    void push(uint32_t newest, uint32_t oldest)
+    {
+        value = (value << 1) | newest;
+        value ^= oldest << outpoint;
+        value ^= value >> width;
+        value &= (1u << width) - 1;
+    }
+};
+
+/** An entry of a TAGE tagged table. */
+typedef struct TageEntry
+{
+    uint16_t tag;
+    /** A 3-bit signed counter, predicting taken when 0 or more. */
+    int8_t ctr;
+    /** A 2-bit counter of how often this entry was right when it mattered. */
+    uint8_t u;
+} TageEntry;
+
+/**
+ * Predicts each branch with the tagged table of the longest global history
+ * that has an entry for it, falling back to a bimodal table (Seznec and
+ * Michaud, "A case for (partially) TAgged GEometric history length branch
+ * prediction", JILP 2006).
+ *
+ * The tagged tables use history lengths in a geometric series from
+ * TAGE_MIN_HIST up to hist_len. A mispredicted branch allocates an entry in a
+ * table of longer history than the one that predicted it, taking one whose
+ * useful counter is 0; the useful counters are halved every
+ * TAGE_U_RESET_PERIOD branches so that stale entries can be replaced.
+ */
+class TageBPred : public BPredAlgorithm
+{
+private:
+    CounterTable base;
+    std::vector<TageEntry> entries;
+    uint32_t table_bits;
+    uint32_t mask;
+    uint32_t hist_lens[TAGE_NUM_TABLES];
+    uint32_t tag_bits[TAGE_NUM_TABLES];
+
+    /** The global history, the latest outcome at history[history_pos]. */
+    std::vector<uint8_t> history;
+    uint32_t history_mask;
+    uint32_t history_pos;
+    FoldedHistory index_fold[TAGE_NUM_TABLES];
+    FoldedHistory tag_fold[TAGE_NUM_TABLES][2];
+
+    /** Chooses the alternate prediction over a new entry when 0 or more. */
+    int32_t use_alt_on_new;
+    uint32_t num_updates;
+    uint32_t random;
+
+    // The lookup of the branch last predicted.
+    uint32_t last_index[TAGE_NUM_TABLES];
+    uint16_t last_tag[TAGE_NUM_TABLES];
+    int provider;
+    int alt_provider;
+    BranchDirection provider_pred;
+    BranchDirection alt_pred;
+    BranchDirection last_pred;
+
+    TageEntry *entry(int table, uint32_t index)
+    {
+        return &entries[((size_t)table << table_bits) + index];
+    }
+
+    uint32_t outcome(uint32_t i) const
+    {
+        return history[(history_pos + i) & history_mask];
+    }
+
+    /** Whether the provider's entry is new and its prediction unproven. */
+    bool provider_is_new()
+    {
+        TageEntry *e = entry(provider, last_index[provider]);
+        return (e->ctr == 0 || e->ctr == -1) && e->u == 0;
+    }
+
+    /** A xorshift generator, so that runs are repeatable. */
+    uint32_t next_random()
+    {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        return random;
+    }
+
+    static int8_t train(int8_t ctr, BranchDirection resolution)
+    {
+        if (resolution == TAKEN)
+        {
+            return ctr < 3 ? ctr + 1 : ctr;
+        }
+        return ctr > -4 ? ctr - 1 : ctr;
+    }
+
+    void allocate(BranchDirection resolution)
+    {
+        // Start one table further on half the time, to spread allocations.
+        int start = provider + 1;
+        if ((next_random() & 1) && start < TAGE_NUM_TABLES - 1)
+        {
+            start++;
+        }
+        for (int i = start; i <= TAGE_NUM_TABLES; i++)
+        {
+            // Wrap around to the table skipped, if any, last.
+            int table = i < TAGE_NUM_TABLES ? i : provider + 1;
+            TageEntry *e = entry(table, last_index[table]);
+            if (e->u == 0)
+            {
+                e->tag = last_tag[table];
+                e->ctr = resolution == TAKEN ? 0 : -1;
+                return;
+            }
+        }
+
+        // Every candidate is useful; age them so that one is free next time.
+        for (int i = provider + 1; i < TAGE_NUM_TABLES; i++)
+        {
+            entry(i, last_index[i])->u--;
+        }
+    }
+
+public:
+    TageBPred(uint32_t table_bits, uint32_t hist_len)
+        : base(table_bits),
+          entries(((size_t)TAGE_NUM_TABLES << table_bits), TageEntry()),
+          table_bits(table_bits), mask((1u << table_bits) - 1),
+          use_alt_on_new(0), num_updates(0), random(0x2545F491), provider(-1),
+          alt_provider(-1), provider_pred(NOT_TAKEN), alt_pred(NOT_TAKEN),
+          last_pred(NOT_TAKEN)
+    {
+        uint32_t max_len = hist_len;
+        if (max_len < TAGE_MIN_HIST + TAGE_NUM_TABLES - 1)
+        {
+            max_len = TAGE_MIN_HIST + TAGE_NUM_TABLES - 1;
+        }
+        for (int i = 0; i < TAGE_NUM_TABLES; i++)
+        {
+            double ratio = (double)max_len / TAGE_MIN_HIST;
+            double len = TAGE_MIN_HIST *
+                         pow(ratio, (double)i / (TAGE_NUM_TABLES - 1));
+            hist_lens[i] = (uint32_t)(len + 0.5);
+            if (i > 0 && hist_lens[i] <= hist_lens[i - 1])
+            {
+                hist_lens[i] = hist_lens[i - 1] + 1;
+            }
+            tag_bits[i] = 9 + i / 2;
+
+            index_fold[i].init(hist_lens[i], table_bits);
+            tag_fold[i][0].init(hist_lens[i], tag_bits[i]);
+            tag_fold[i][1].init(hist_lens[i], tag_bits[i] - 1);
+        }
+
+        uint32_t history_size = 1;
+        while (history_size <= hist_lens[TAGE_NUM_TABLES - 1])
+        {
+            history_size <<= 1;
+        }
+        history.assign(history_size, 0);
+        history_mask = history_size - 1;
+        history_pos = 0;
+    }
+
+    BranchDirection predict(uint64_t pc)
+    {
+        provider = -1;
+        alt_provider = -1;
+        for (int i = 0; i < TAGE_NUM_TABLES; i++)
+        {
+            last_index[i] = (pc ^ (pc >> table_bits) ^ index_fold[i].get()) &
+                            mask;
+            last_tag[i] = (pc ^ tag_fold[i][0].get() ^
+                           (tag_fold[i][1].get() << 1)) &
+                          ((1u << tag_bits[i]) - 1);
+        }
+        for (int i = TAGE_NUM_TABLES - 1; i >= 0; i--)
+        {
+            if (entry(i, last_index[i])->tag == last_tag[i])
+            {
+                if (provider == -1)
+                {
+                    provider = i;
+                }
+                else
+                {
+                    alt_provider = i;
+                    break;
+                }
+            }
+        }
+
+        alt_pred = alt_provider >= 0
+                       ? (entry(alt_provider, last_index[alt_provider])->ctr >= 0
+                              ? TAKEN
+                              : NOT_TAKEN)
+                       : base.predict(base.index(pc));
+        if (provider < 0)
+        {
+            provider_pred = alt_pred;
+            last_pred = alt_pred;
+            return last_pred;
+        }
+        provider_pred = entry(provider, last_index[provider])->ctr >= 0
+                            ? TAKEN
+                            : NOT_TAKEN;
+        last_pred = use_alt_on_new >= 0 && provider_is_new() ? alt_pred
+                                                             : provider_pred;
+        return last_pred;
+    }
+
+    void update(uint64_t pc, BranchDirection resolution)
+    {
+        if (provider >= 0 && provider_is_new() && provider_pred != alt_pred)
+        {
+            if (alt_pred == resolution)
+            {
+                use_alt_on_new += use_alt_on_new < 7 ? 1 : 0;
+            }
+            else
+            {
+                use_alt_on_new -= use_alt_on_new > -8 ? 1 : 0;
+            }
+        }
+        if (last_pred != resolution && provider < TAGE_NUM_TABLES - 1)
+        {
+            allocate(resolution);
+        }
+
+        if (provider >= 0)
+        {
+            TageEntry *e = entry(provider, last_index[provider]);
+            if (e->u == 0)
+            {
+                // An unproven entry leaves the alternate trained too.
+                if (alt_provider >= 0)
+                {
+                    TageEntry *alt = entry(alt_provider,
+                                           last_index[alt_provider]);
+                    alt->ctr = train(alt->ctr, resolution);
+                }
+                else
+                {
+                    base.update(base.index(pc), resolution);
+                }
+            }
+            if (provider_pred != alt_pred)
+            {
+                if (provider_pred == resolution)
+                {
+                    e->u += e->u < 3 ? 1 : 0;
+                }
+                else
+                {
+                    e->u -= e->u > 0 ? 1 : 0;
+                }
+            }
+            e->ctr = train(e->ctr, resolution);
+        }
+        else
+        {
+            base.update(base.index(pc), resolution);
+        }
+
+        if (++num_updates % TAGE_U_RESET_PERIOD == 0)
+        {
+            for (size_t i = 0; i < entries.size(); i++)
+            {
+                entries[i].u >>= 1;
+            }
+        }
+
+        history_pos = (history_pos - 1) & history_mask;
+        history[history_pos] = resolution == TAKEN;
+        for (int i = 0; i < TAGE_NUM_TABLES; i++)
+        {
+            uint32_t oldest = outcome(hist_lens[i]);
+            index_fold[i].push(history[history_pos], oldest);
+            tag_fold[i][0].push(history[history_pos], oldest);
+            tag_fold[i][1].push(history[history_pos], oldest);
+        }
+    }
+
+    uint64_t replay(const uint64_t *pcs, const BranchDirection *dirs,
+                    size_t count)
+    {
+        return bpred_replay(this, pcs, dirs, count);
+    }
+};
+
+BPredAlgorithm *bpred_algorithm_new(BPredPolicy policy, uint32_t table_bits,
+                                    uint32_t hist_len)
+{
+    switch (policy)
+    {
+    case BPRED_ALWAYS_TAKEN:
+        return new AlwaysTakenBPred();
+    case BPRED_GSHARE:
+        return new GshareBPred(table_bits, hist_len);
+    case BPRED_BIMODAL:
+        return new BimodalBPred(table_bits);
+    case BPRED_TOURNAMENT:
+        return new TournamentBPred(table_bits, hist_len);
+    case BPRED_PERCEPTRON:
+        return new PerceptronBPred(table_bits, hist_len);
+    case BPRED_TAGE:
+        return new TageBPred(table_bits, hist_len);
+    default:
+        return NULL;
+    }
+}
 
 /**
- * Construct a branch predictor with the given policy.
+ * Construct a branch predictor with the given policy, sized by
+ * BPRED_TABLE_BITS and BPRED_HIST_LEN.
  * 
  * In part B of the lab, you must implement this constructor.
  * 
@@ -18,13 +698,15 @@
  */
 BPred::BPred(BPredPolicy policy)
 {
-    // TODO: Initialize member variables here.
     this->policy = policy;
-    pht.resize(4096,2);
-    ghr = 0;
-    pattern = 0;
-    // As a reminder, you can declare any additional member variables you need
-    // in the BPred class in bpred.h and initialize them here.
+    algorithm = bpred_algorithm_new(policy, BPRED_TABLE_BITS, BPRED_HIST_LEN);
+    stat_num_branches = 0;
+    stat_num_mispred = 0;
+}
+
+BPred::~BPred()
+{
+    delete algorithm;
 }
 
 /**
@@ -37,29 +719,11 @@ BPred::BPred(BPredPolicy policy)
  */
 BranchDirection BPred::predict(uint64_t pc)
 {
-    // TODO: Return a prediction for whether the branch at address pc will be
-    // TAKEN or NOT_TAKEN according to this branch predictor's policy.
     // Note that you do not have to handle the BPRED_PERFECT policy here; this
     // function will not be called for that policy.
-    if(this->policy == 1){
-        return TAKEN;
-    }
-    else {
-        uint16_t pc_lower = pc & 0xFFF;
-        uint16_t ghr_lower = ghr & 0xFFF;
-        pattern = pc_lower ^ ghr_lower;
-        prediction = pht[pattern];
-        if(prediction == 2 || prediction == 3){
-            return TAKEN;
-        }
-        else{
-            return NOT_TAKEN;
-        }
-    }
-   
+    return algorithm->predict(pc);
 }
 
-
 /**
  * Update the branch predictor statistics (stat_num_branches and
  * stat_num_mispred), as well as any other internal state you may need to
@@ -74,29 +738,10 @@ BranchDirection BPred::predict(uint64_t pc)
 void BPred::update(uint64_t pc, BranchDirection prediction,
                    BranchDirection resolution)
 {
-    // TODO: Update the stat_num_branches and stat_num_mispred member variables
-    // according to the prediction and resolution of the branch.
     stat_num_branches++;
-    if(prediction != resolution){
+    if (prediction != resolution)
+    {
         stat_num_mispred++;
-        
     }
-    if(resolution){
-        if(pht[pattern] != 3){
-            pht[pattern]++;
-        }
-    }
-    else{
-        if(pht[pattern] != 0){
-            pht[pattern]--;
-        }
-    }
-    ghr = ghr << 1;
-    if(resolution){
-        ghr |= 0x1;
-    }
-    // TODO: Update any other internal state you may need to keep track of.
-
-    // Note that you do not have to handle the BPRED_PERFECT policy here; this
-    // function will not be called for that policy.
+    algorithm->update(pc, resolution);
 }
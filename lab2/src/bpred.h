@@ -13,7 +13,8 @@
 #define _BPRED_H_
 
 #include <inttypes.h>
-#include <vector>
+#include <stddef.h>
+
 /**
  * The possible branch prediction policies the simulator can use.
  * 
@@ -24,9 +25,47 @@ typedef enum BPredPolicyEnum
     BPRED_PERFECT,      // The branch predictor is (magically) always correct.
     BPRED_ALWAYS_TAKEN, // The branch predictor always predicts a branch taken.
     BPRED_GSHARE,       // The branch predictor uses the Gshare algorithm.
+    BPRED_BIMODAL,      // The branch predictor uses a PC-indexed counter table.
+    BPRED_TOURNAMENT,   // The branch predictor chooses between Bimodal and
+                        // Gshare per branch.
+    BPRED_PERCEPTRON,   // The branch predictor uses the Perceptron algorithm.
+    BPRED_TAGE,         // The branch predictor uses the TAGE algorithm.
     NUM_BPRED_POLICIES
 } BPredPolicy;
 
+/**
+ * The log2 of the number of entries in each table of the branch predictor:
+ * counters for Bimodal and Gshare, counters and choices for Tournament,
+ * perceptrons for Perceptron, and the base counters and each tagged table for
+ * TAGE.
+ * 
+ * You should not modify this value directly; it is set by the command-line
+ * argument -bpredbits.
+ */
+extern uint32_t BPRED_TABLE_BITS;
+
+/**
+ * The number of past branch outcomes the branch predictor uses, for the
+ * policies that keep a global history. For TAGE, this is the longest history
+ * of its tagged tables.
+ * 
+ * You should not modify this value directly; it is set by the command-line
+ * argument -bpredhist.
+ */
+extern uint32_t BPRED_HIST_LEN;
+
+/** [Internal] The maximum value of BPRED_TABLE_BITS. */
+#define BPRED_MAX_TABLE_BITS 24
+
+/** [Internal] The maximum value of BPRED_HIST_LEN. */
+#define BPRED_MAX_HIST_LEN 1024
+
+/**
+ * [Internal] The maximum value of BPRED_HIST_LEN for Gshare, Tournament, and
+ * Perceptron, which keep their history in a single word.
+ */
+#define BPRED_MAX_WORD_HIST_LEN 64
+
 /**
  * Whether a branch is taken or not taken.
  * 
@@ -38,6 +77,81 @@ typedef enum BranchDirectionEnum
     TAKEN = 1      // The branch is taken.
 } BranchDirection;
 
+/**
+ * [Internal] The algorithm of a branch prediction policy. BPred keeps the
+ * statistics, and forwards each prediction and update to one of these.
+ */
+class BPredAlgorithm
+{
+public:
+    virtual ~BPredAlgorithm() {}
+
+    /**
+     * Get a prediction for the branch with the given address.
+     * 
+     * @param pc the address (program counter) of the branch to predict
+     * @return the prediction for whether the branch is taken or not taken
+     */
+    virtual BranchDirection predict(uint64_t pc) = 0;
+
+    /**
+     * Train on the outcome of the branch last passed to predict().
+     * 
+     * @param pc the address (program counter) of the branch
+     * @param resolution the actual outcome of the branch
+     */
+    virtual void update(uint64_t pc, BranchDirection resolution) = 0;
+
+    /**
+     * Predict and train on a run of branches, as predict() and then update()
+     * would on each in turn, but without a virtual call per branch.
+     * 
+     * @param pcs the addresses of the branches
+     * @param dirs the actual outcomes of the branches
+     * @param count the number of branches
+     * @return the number of branches mispredicted
+     */
+    virtual uint64_t replay(const uint64_t *pcs, const BranchDirection *dirs,
+                            size_t count) = 0;
+};
+
+/**
+ * [Internal] Allocate the algorithm of a branch prediction policy.
+ * 
+ * @param policy the policy, which must not be BPRED_PERFECT
+ * @param table_bits the log2 of the number of entries in each table
+ * @param hist_len the number of past branch outcomes to use
+ * @return a pointer to a newly allocated algorithm
+ */
+BPredAlgorithm *bpred_algorithm_new(BPredPolicy policy, uint32_t table_bits,
+                                    uint32_t hist_len);
+
+/**
+ * Get the name of a branch prediction policy, as accepted by -bpredpolicy.
+ * 
+ * @param policy the policy
+ * @return the name, e.g. "gshare"
+ */
+const char *bpred_policy_name(BPredPolicy policy);
+
+/**
+ * Look up a branch prediction policy by name or number.
+ * 
+ * @param name the name of the policy, e.g. "gshare", or its number
+ * @param policy set to the policy
+ * @return true if the policy exists
+ */
+bool bpred_policy_parse(const char *name, BPredPolicy *policy);
+
+/**
+ * Get the longest history a branch prediction policy can use.
+ * 
+ * @param policy the policy
+ * @return BPRED_MAX_WORD_HIST_LEN for the policies that keep their history in
+ *         a single word, or BPRED_MAX_HIST_LEN otherwise
+ */
+uint32_t bpred_max_hist_len(BPredPolicy policy);
+
 /**
  * A branch predictor.
  * 
@@ -49,24 +163,17 @@ class BPred
 private:
     /** The policy this branch predictor uses. */
     BPredPolicy policy;
-    uint16_t ghr;
-    std::vector<uint8_t>pht;
-    uint16_t pattern;
-    uint8_t prediction;
+    /** The algorithm of the policy. */
+    BPredAlgorithm *algorithm;
 public:
     /** The total number of branches this branch predictor has seen. */
     uint64_t stat_num_branches;
     /** The number of branches this branch predictor has mispredicted. */
     uint64_t stat_num_mispred;
 
-    // inline uint64_t getId(){
-    //     return stall_id;
-    // }
-    // inline void setId(uint64_t op_id){
-    //     this->stall_id = op_id;
-    // }
     /**
-     * Construct a branch predictor with the given policy.
+     * Construct a branch predictor with the given policy, sized by
+     * BPRED_TABLE_BITS and BPRED_HIST_LEN.
      * 
      * In part B of the lab, you must implement this constructor.
      * 
@@ -74,6 +181,8 @@ public:
      */
     BPred(BPredPolicy policy);
 
+    ~BPred();
+
     /**
      * Get a prediction for the branch with the given address.
      * 
@@ -0,0 +1,393 @@
+// bpredbench.cpp
+// Measures how fast Gshare predicts and trains with each kind of pattern
+// history table, the packed CounterTable and the byte-per-counter
+// ByteCounterTable, over a range of table sizes.
+//
+// The branches come from a branch trace file made by trace2br, or are made up:
+// branches at random among a million addresses, each mostly going one way. The
+// cache misses of each run are counted with the hardware performance counters
+// where the kernel allows it.
+
+#include "brtrace.h"
+#include "pht.h"
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+/** The number of distinct addresses of made-up branches. */
+#define BENCH_STATIC_BRANCHES (1 << 20)
+
+/** The number of branches read from a branch trace file at a time. */
+#define BENCH_READ_BRANCHES BRTRACE_BLOCK_BRANCHES
+
+/** The results of one run. */
+typedef struct BenchResult
+{
+    /** The number of branches mispredicted. */
+    uint64_t num_mispred;
+
+    /** The size of the table in bytes. */
+    size_t table_bytes;
+
+    /** The time the run took, in seconds. */
+    double seconds;
+
+    /** The number of L1 data cache read misses, or -1 if not counted. */
+    int64_t l1d_misses;
+
+    /** The number of last-level cache misses, or -1 if not counted. */
+    int64_t llc_misses;
+} BenchResult;
+
+static void print_usage(char *program_name)
+{
+    fprintf(stderr, "Usage: %s [options] [<branch trace file>]\n\n",
+            program_name);
+    fprintf(stderr, "Compares Gshare's throughput with packed and byte-per-counter pattern\n");
+    fprintf(stderr, "history tables, on the branches of a trace made by trace2br or on made-up\n");
+    fprintf(stderr, "branches\n\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "    -minbits <bits>     Set log2 of the smallest table size (Default: 12)\n");
+    fprintf(stderr, "    -maxbits <bits>     Set log2 of the largest table size (Default: 20)\n");
+    fprintf(stderr, "    -bpredhist <len>    Set number of past branch outcomes Gshare uses\n");
+    fprintf(stderr, "                        (Default: 12)\n");
+    fprintf(stderr, "    -branches <num>     Set number of made-up branches (Default: 20000000)\n");
+}
+
+/**
+ * Get the time from a monotonic clock.
+ *
+ * @return the time in seconds
+ */
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/**
+ * Open a disabled hardware performance counter for this thread.
+ *
+ * @param type the type of the event, e.g. PERF_TYPE_HW_CACHE
+ * @param config the event
+ * @return the file descriptor of the counter, or -1 if it can't be counted
+ */
+static int counter_open(uint32_t type, uint64_t config)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/**
+ * Read a performance counter.
+ *
+ * @param fd the file descriptor of the counter, or -1
+ * @return the count, or -1 if the counter isn't available
+ */
+static int64_t counter_read(int fd)
+{
+    uint64_t count;
+    if (fd == -1 || read(fd, &count, sizeof(count)) != sizeof(count))
+    {
+        return -1;
+    }
+    return count;
+}
+
+/**
+ * Predict and train on every branch with Gshare, as GshareBPred does but
+ * with a given kind of table.
+ *
+ * @param table_bits the log2 of the number of counters
+ * @param hist_len the number of past branch outcomes used
+ * @param pcs the addresses of the branches
+ * @param dirs the directions of the branches
+ * @param count the number of branches
+ * @return the results
+ */
+template <class Table>
+static BenchResult bench_table(uint32_t table_bits, uint32_t hist_len,
+                               const uint64_t *pcs, const BranchDirection *dirs,
+                               size_t count)
+{
+    Table pht(table_bits);
+    uint64_t hist_mask =
+        hist_len >= 64 ? ~(uint64_t)0 : ((uint64_t)1 << hist_len) - 1;
+    uint64_t history = 0;
+    uint64_t num_mispred = 0;
+
+    int fds[2];
+    fds[0] = counter_open(PERF_TYPE_HW_CACHE,
+                          PERF_COUNT_HW_CACHE_L1D |
+                              (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    fds[1] = counter_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    for (int i = 0; i < 2; i++)
+    {
+        if (fds[i] != -1)
+        {
+            ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+    double start = now_seconds();
+
+    for (size_t i = 0; i < count; i++)
+    {
+        uint64_t folded = 0;
+        for (uint64_t h = history; h != 0; h >>= table_bits)
+        {
+            folded ^= h;
+        }
+        uint32_t index = pht.index(pcs[i] ^ folded);
+        num_mispred += pht.predict(index) != dirs[i];
+        pht.update(index, dirs[i]);
+        history = ((history << 1) | (dirs[i] == TAKEN)) & hist_mask;
+    }
+
+    BenchResult result;
+    result.seconds = now_seconds() - start;
+    for (int i = 0; i < 2; i++)
+    {
+        if (fds[i] != -1)
+        {
+            ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+    result.l1d_misses = counter_read(fds[0]);
+    result.llc_misses = counter_read(fds[1]);
+    for (int i = 0; i < 2; i++)
+    {
+        if (fds[i] != -1)
+        {
+            close(fds[i]);
+        }
+    }
+    result.num_mispred = num_mispred;
+    result.table_bytes = pht.size_bytes();
+    return result;
+}
+
+/**
+ * Read every branch of a branch trace file.
+ *
+ * @param filename the path of the trace file
+ * @param pcs set to the addresses of the branches
+ * @param dirs set to the directions of the branches
+ * @return 0 on success, or -1 on error
+ */
+static int load_branches(const char *filename, std::vector<uint64_t> *pcs,
+                         std::vector<BranchDirection> *dirs)
+{
+    BranchTrace *bt = brtrace_open(filename);
+    if (bt == NULL)
+    {
+        return -1;
+    }
+    pcs->resize(bt->header.num_branches);
+    dirs->resize(bt->header.num_branches);
+
+    static uint8_t dir_bits[BENCH_READ_BRANCHES];
+    size_t count = 0;
+    ssize_t num_read;
+    while (count < pcs->size() &&
+           (num_read = brtrace_read(bt, &(*pcs)[count], dir_bits, NULL,
+                                    BENCH_READ_BRANCHES)) > 0)
+    {
+        for (ssize_t i = 0; i < num_read; i++)
+        {
+            (*dirs)[count + i] = (BranchDirection)dir_bits[i];
+        }
+        count += num_read;
+    }
+    brtrace_close(bt);
+    return count == pcs->size() ? 0 : -1;
+}
+
+/**
+ * Make up branches at random among BENCH_STATIC_BRANCHES addresses, each
+ * going the same way 7 times out of 8.
+ *
+ * @param count the number of branches
+ * @param pcs set to the addresses of the branches
+ * @param dirs set to the directions of the branches
+ */
+static void make_branches(size_t count, std::vector<uint64_t> *pcs,
+                          std::vector<BranchDirection> *dirs)
+{
+    pcs->resize(count);
+    dirs->resize(count);
+    uint64_t seed = 1;
+    for (size_t i = 0; i < count; i++)
+    {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint64_t branch = (seed >> 33) % BENCH_STATIC_BRANCHES;
+        bool usual = ((branch * 0x9E3779B97F4A7C15ULL) >> 63) != 0;
+        bool flip = ((seed >> 20) & 7) == 0;
+        (*pcs)[i] = 0x400000 + 5 * branch;
+        (*dirs)[i] = usual != flip ? TAKEN : NOT_TAKEN;
+    }
+}
+
+/**
+ * Print the results of one run.
+ *
+ * @param name the name of the statistic
+ * @param kind the kind of table
+ * @param table_bits the log2 of the number of counters
+ * @param result the results
+ * @param count the number of branches
+ */
+static void print_result(const char *name, const char *kind,
+                         uint32_t table_bits, const BenchResult *result,
+                         size_t count)
+{
+    char l1d[16] = "n/a";
+    char llc[16] = "n/a";
+    if (result->l1d_misses >= 0)
+    {
+        snprintf(l1d, sizeof(l1d), "%.2f",
+                 1000.0 * (double)result->l1d_misses / (double)count);
+    }
+    if (result->llc_misses >= 0)
+    {
+        snprintf(llc, sizeof(llc), "%.2f",
+                 1000.0 * (double)result->llc_misses / (double)count);
+    }
+    printf("%-24s\t : %-6s  bits %2u  %8zu bytes  %8.1f M branches/sec"
+           "  %10" PRIu64 " mispred  L1D miss/Kbr %7s  LLC miss/Kbr %7s\n",
+           name, kind, table_bits, result->table_bytes,
+           (double)count / result->seconds / 1e6, result->num_mispred, l1d,
+           llc);
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t min_bits = 12;
+    uint32_t max_bits = 20;
+    uint32_t hist_len = 12;
+    uint64_t num_branches = 20000000;
+    char *filename = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-minbits") == 0 ||
+            strcmp(argv[i], "-maxbits") == 0)
+        {
+            if (i + 1 >= argc)
+            {
+                fprintf(stderr, "Error: missing argument to %s\n", argv[i]);
+                return 2;
+            }
+
+            int table_bits = atoi(argv[i + 1]);
+            if (table_bits < 1 || table_bits > BPRED_MAX_TABLE_BITS)
+            {
+                fprintf(stderr, "Error: predictor table bits must be between 1 and %d\n", BPRED_MAX_TABLE_BITS);
+                return 2;
+            }
+
+            *(strcmp(argv[i], "-minbits") == 0 ? &min_bits : &max_bits) =
+                table_bits;
+            i++;
+        }
+        else if (strcmp(argv[i], "-bpredhist") == 0)
+        {
+            if (++i >= argc)
+            {
+                fprintf(stderr, "Error: missing argument to -bpredhist\n");
+                return 2;
+            }
+
+            int len = atoi(argv[i]);
+            if (len < 0 || len > BPRED_MAX_WORD_HIST_LEN)
+            {
+                fprintf(stderr, "Error: predictor history length must be between 0 and %d\n", BPRED_MAX_WORD_HIST_LEN);
+                return 2;
+            }
+
+            hist_len = len;
+        }
+        else if (strcmp(argv[i], "-branches") == 0)
+        {
+            if (++i >= argc)
+            {
+                fprintf(stderr, "Error: missing argument to -branches\n");
+                return 2;
+            }
+
+            num_branches = strtoull(argv[i], NULL, 10);
+            if (num_branches == 0)
+            {
+                fprintf(stderr, "Error: number of branches must be positive\n");
+                return 2;
+            }
+        }
+        else if (argv[i][0] == '-' || filename != NULL)
+        {
+            print_usage(argv[0]);
+            return 2;
+        }
+        else
+        {
+            filename = argv[i];
+        }
+    }
+    if (min_bits > max_bits)
+    {
+        fprintf(stderr, "Error: -minbits must be at most -maxbits\n");
+        return 2;
+    }
+
+    std::vector<uint64_t> pcs;
+    std::vector<BranchDirection> dirs;
+    if (filename != NULL)
+    {
+        if (load_branches(filename, &pcs, &dirs) != 0)
+        {
+            return 1;
+        }
+    }
+    else
+    {
+        make_branches(num_branches, &pcs, &dirs);
+    }
+    if (pcs.empty())
+    {
+        fprintf(stderr, "Error: no branches to predict\n");
+        return 1;
+    }
+
+    printf("** BENCHMARKING GSHARE ON %zu BRANCHES **\n\n", pcs.size());
+    char name[64];
+    for (uint32_t bits = min_bits; bits <= max_bits; bits++)
+    {
+        BenchResult byte_result = bench_table<ByteCounterTable>(
+            bits, hist_len, &pcs[0], &dirs[0], pcs.size());
+        BenchResult packed_result = bench_table<CounterTable>(
+            bits, hist_len, &pcs[0], &dirs[0], pcs.size());
+        if (byte_result.num_mispred != packed_result.num_mispred)
+        {
+            fprintf(stderr, "Error: the tables disagree at %u bits\n", bits);
+            return 1;
+        }
+
+        snprintf(name, sizeof(name), "BPREDBENCH_BYTE_%u", bits);
+        print_result(name, "byte", bits, &byte_result, pcs.size());
+        snprintf(name, sizeof(name), "BPREDBENCH_PACKED_%u", bits);
+        print_result(name, "packed", bits, &packed_result, pcs.size());
+    }
+    return 0;
+}
@@ -0,0 +1,286 @@
+// bpredsweep.cpp
+// Implements branch predictor sweeps.
+
+#include "bpredsweep.h"
+#include "trace.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+/** The number of branches collected from the trace before predicting them. */
+#define BPRED_SWEEP_BLOCK_BRANCHES 65536
+
+/** The number of trace records read from the trace file at a time. */
+#define BPRED_SWEEP_READ_RECS 256
+
+/**
+ * A block of conditional branches of the trace, kept as separate arrays as
+ * BPredAlgorithm::replay() takes them.
+ */
+typedef struct BPredSweepBlock
+{
+    uint64_t pcs[BPRED_SWEEP_BLOCK_BRANCHES];
+    BranchDirection dirs[BPRED_SWEEP_BLOCK_BRANCHES];
+} BPredSweepBlock;
+
+/**
+ * Parse a table size or history length of a configuration.
+ *
+ * @param text the text, which must be a whole number
+ * @param max the largest value allowed
+ * @param value set to the value
+ * @return true if the text is a number no larger than max
+ */
+static bool bpred_sweep_parse_size(const char *text, uint32_t max,
+                                   uint32_t *value)
+{
+    char *end;
+    unsigned long number = strtoul(text, &end, 10);
+    if (*text == '\0' || *end != '\0' || number > max)
+    {
+        return false;
+    }
+    *value = (uint32_t)number;
+    return true;
+}
+
+BPredSweep *bpred_sweep_parse(const char *spec, uint32_t table_bits,
+                              uint32_t hist_len)
+{
+    std::vector<BPredSweepEntry> entries;
+    char *copy = strdup(spec);
+    char *saveptr;
+    bool ok = true;
+    for (char *config = strtok_r(copy, ",", &saveptr); ok && config != NULL;
+         config = strtok_r(NULL, ",", &saveptr))
+    {
+        BPredSweepEntry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.table_bits = table_bits;
+        entry.hist_len = hist_len;
+
+        char *bits = strchr(config, ':');
+        char *hist = NULL;
+        if (bits != NULL)
+        {
+            *bits++ = '\0';
+            hist = strchr(bits, ':');
+            if (hist != NULL)
+            {
+                *hist++ = '\0';
+            }
+        }
+
+        if (!bpred_policy_parse(config, &entry.policy) ||
+            entry.policy == BPRED_PERFECT)
+        {
+            fprintf(stderr, "Error: invalid branch predictor in sweep: %s\n",
+                    config);
+            ok = false;
+        }
+        else if ((bits != NULL &&
+                  (!bpred_sweep_parse_size(bits, BPRED_MAX_TABLE_BITS,
+                                           &entry.table_bits) ||
+                   entry.table_bits == 0)) ||
+                 (hist != NULL &&
+                  !bpred_sweep_parse_size(hist, BPRED_MAX_HIST_LEN,
+                                          &entry.hist_len)))
+        {
+            fprintf(stderr, "Error: invalid sizes for %s in sweep: table bits "
+                            "must be between 1 and %d, history length between "
+                            "0 and %d\n",
+                    config, BPRED_MAX_TABLE_BITS, BPRED_MAX_HIST_LEN);
+            ok = false;
+        }
+        else if (entry.hist_len > bpred_max_hist_len(entry.policy))
+        {
+            fprintf(stderr, "Error: history length of %s in sweep must be at "
+                            "most %u\n",
+                    config, bpred_max_hist_len(entry.policy));
+            ok = false;
+        }
+        entries.push_back(entry);
+    }
+    free(copy);
+
+    if (ok && entries.empty())
+    {
+        fprintf(stderr, "Error: branch predictor sweep is empty\n");
+        ok = false;
+    }
+    if (!ok)
+    {
+        return NULL;
+    }
+
+    BPredSweep *sweep = (BPredSweep *)calloc(1, sizeof(BPredSweep));
+    sweep->count = entries.size();
+    sweep->entries =
+        (BPredSweepEntry *)calloc(sweep->count, sizeof(BPredSweepEntry));
+    for (uint32_t i = 0; i < sweep->count; i++)
+    {
+        sweep->entries[i] = entries[i];
+        sweep->entries[i].algorithm = bpred_algorithm_new(
+            entries[i].policy, entries[i].table_bits, entries[i].hist_len);
+    }
+    return sweep;
+}
+
+void bpred_sweep_free(BPredSweep *sweep)
+{
+    if (sweep == NULL)
+    {
+        return;
+    }
+    for (uint32_t i = 0; i < sweep->count; i++)
+    {
+        delete sweep->entries[i].algorithm;
+    }
+    free(sweep->entries);
+    free(sweep);
+}
+
+/**
+ * Collect the next block of conditional branches from a trace.
+ *
+ * @param sweep the sweep, whose instruction count is updated
+ * @param trace the trace file
+ * @param block where to put the branches
+ * @param end set to true at the end of the trace, or at an invalid record
+ * @return the number of branches collected, or -1 on error
+ */
+static ssize_t bpred_sweep_read(BPredSweep *sweep, TraceFile *trace,
+                                BPredSweepBlock *block, bool *end)
+{
+    size_t count = 0;
+    while (!*end && count < BPRED_SWEEP_BLOCK_BRANCHES)
+    {
+        // Every record read might be a branch, so never read more records
+        // than there is room for.
+        size_t num_recs = BPRED_SWEEP_BLOCK_BRANCHES - count;
+        if (num_recs > BPRED_SWEEP_READ_RECS)
+        {
+            num_recs = BPRED_SWEEP_READ_RECS;
+        }
+
+        const void *data;
+        ssize_t bytes_read =
+            tracefile_next(trace, &data, num_recs * sizeof(TraceRec));
+        if (bytes_read == -1)
+        {
+            // tracefile_next() has already reported the error.
+            return -1;
+        }
+        if ((size_t)bytes_read < num_recs * sizeof(TraceRec))
+        {
+            *end = true;
+        }
+
+        const TraceRec *recs = (const TraceRec *)data;
+        bool invalid = (size_t)bytes_read % sizeof(TraceRec) != 0;
+        for (size_t i = 0; i < (size_t)bytes_read / sizeof(TraceRec); i++)
+        {
+            if (recs[i].op_type >= NUM_OP_TYPES)
+            {
+                invalid = true;
+                break;
+            }
+            sweep->num_inst++;
+            if (recs[i].op_type == OP_CBR)
+            {
+                block->pcs[count] = recs[i].inst_addr;
+                block->dirs[count] = (BranchDirection)recs[i].br_dir;
+                count++;
+            }
+        }
+        if (invalid)
+        {
+            // Too few bytes read or invalid op_type
+            fprintf(stderr, "\n");
+            fprintf(stderr, "Error: Invalid trace file\n");
+            *end = true;
+        }
+    }
+    return count;
+}
+
+/**
+ * Predict a block of branches with every configuration of one shard of a
+ * sweep.
+ *
+ * @param sweep the sweep
+ * @param shard the shard: every num_shards-th configuration from this one
+ * @param num_shards the number of shards
+ * @param block the branches
+ * @param count the number of branches in the block
+ */
+static void bpred_sweep_predict(BPredSweep *sweep, unsigned int shard,
+                                unsigned int num_shards,
+                                const BPredSweepBlock *block, size_t count)
+{
+    for (uint32_t i = shard; i < sweep->count; i += num_shards)
+    {
+        BPredSweepEntry *entry = &sweep->entries[i];
+        entry->num_branches += count;
+        entry->num_mispred +=
+            entry->algorithm->replay(block->pcs, block->dirs, count);
+    }
+}
+
+int bpred_sweep_run(BPredSweep *sweep, TraceFile *trace,
+                    unsigned int num_threads)
+{
+    if (num_threads > sweep->count)
+    {
+        num_threads = sweep->count;
+    }
+    if (num_threads == 0)
+    {
+        num_threads = 1;
+    }
+
+    std::vector<BPredSweepBlock> blocks(2);
+    bool end = false;
+    ssize_t count = bpred_sweep_read(sweep, trace, &blocks[0], &end);
+    std::vector<std::thread> threads;
+    for (unsigned int cur = 0; count > 0; cur = 1 - cur)
+    {
+        // Predict this block on the shard threads while reading the next.
+        for (unsigned int i = 0; i < num_threads; i++)
+        {
+            threads.push_back(std::thread(bpred_sweep_predict, sweep, i,
+                                          num_threads, &blocks[cur],
+                                          (size_t)count));
+        }
+        count = bpred_sweep_read(sweep, trace, &blocks[1 - cur], &end);
+        for (unsigned int i = 0; i < num_threads; i++)
+        {
+            threads[i].join();
+        }
+        threads.clear();
+    }
+    return count == -1 ? -1 : 0;
+}
+
+void bpred_sweep_print(const BPredSweep *sweep, const char *prefix)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "%s_NUM_INST", prefix);
+    printf("%-24s\t : %10" PRIu64 "\n", name, sweep->num_inst);
+    for (uint32_t i = 0; i < sweep->count; i++)
+    {
+        const BPredSweepEntry *entry = &sweep->entries[i];
+        double rate = entry->num_branches > 0
+                          ? 100.0 * (double)entry->num_mispred /
+                                (double)entry->num_branches
+                          : 0.0;
+        snprintf(name, sizeof(name), "%s_BPRED_SWEEP_%u", prefix, i);
+        printf("%-24s\t : %-10s  bits %2u  hist %2u  %10" PRIu64
+               " branches  %10" PRIu64 " mispred  rate %7.3f\n",
+               name, bpred_policy_name(entry->policy), entry->table_bits,
+               entry->hist_len, entry->num_branches, entry->num_mispred, rate);
+    }
+}
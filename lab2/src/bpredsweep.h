@@ -0,0 +1,102 @@
+// bpredsweep.h
+// Declares branch predictor sweeps: evaluating many branch predictor
+// configurations on a trace in a single pass.
+//
+// Branch predictors are trained at fetch, as soon as a branch is predicted,
+// so their accuracy depends only on the sequence of branches in the trace and
+// not on the timing of the pipeline. A sweep therefore skips the pipeline: it
+// reads the trace once, collects its conditional branches in blocks, and feeds
+// every block to every configuration, sharding the configurations across
+// threads.
+//
+// A sweep is given as a comma-separated list of configurations, each of the
+// form
+//
+//     <policy>[:<table bits>[:<history length>]]
+//
+// where the policy is a name or number accepted by -bpredpolicy, and omitted
+// sizes take the values of -bpredbits and -bpredhist. For example:
+//
+//     gshare:12:12,gshare:16:16,bimodal:14,perceptron:8:32
+
+#ifndef _BPREDSWEEP_H_
+#define _BPREDSWEEP_H_
+
+#include "bpred.h"
+#include "tracefile.h"
+#include <inttypes.h>
+
+/** One branch predictor configuration of a sweep, and its results. */
+typedef struct BPredSweepEntry
+{
+    /** The branch prediction policy. */
+    BPredPolicy policy;
+
+    /** The log2 of the number of entries in each table. */
+    uint32_t table_bits;
+
+    /** The number of past branch outcomes used. */
+    uint32_t hist_len;
+
+    /** The predictor, which only the thread of its shard touches. */
+    BPredAlgorithm *algorithm;
+
+    /** The number of branches predicted. */
+    uint64_t num_branches;
+
+    /** The number of branches mispredicted. */
+    uint64_t num_mispred;
+} BPredSweepEntry;
+
+/** A list of branch predictor configurations to evaluate together. */
+typedef struct BPredSweep
+{
+    /** The configurations. */
+    BPredSweepEntry *entries;
+
+    /** The number of configurations. */
+    uint32_t count;
+
+    /** The number of instructions read from the trace. */
+    uint64_t num_inst;
+} BPredSweep;
+
+/**
+ * Parse a list of branch predictor configurations.
+ *
+ * @param spec the comma-separated list
+ * @param table_bits the table bits of configurations that don't give them
+ * @param hist_len the history length of configurations that don't give it
+ * @return a pointer to a newly allocated sweep, or NULL if the list is invalid
+ */
+BPredSweep *bpred_sweep_parse(const char *spec, uint32_t table_bits,
+                              uint32_t hist_len);
+
+/**
+ * Free a sweep and its predictors.
+ *
+ * @param sweep the sweep to free
+ */
+void bpred_sweep_free(BPredSweep *sweep);
+
+/**
+ * Run every configuration of a sweep over the branches of a trace.
+ *
+ * @param sweep the sweep
+ * @param trace the trace file, of lab2 trace records
+ * @param num_threads the number of threads to shard the configurations across
+ * @return 0 on success, or -1 on error
+ */
+int bpred_sweep_run(BPredSweep *sweep, TraceFile *trace,
+                    unsigned int num_threads);
+
+/**
+ * Print the number of branches and the misprediction rate of every
+ * configuration of a sweep.
+ *
+ * @param sweep the sweep
+ * @param prefix the prefix of every statistic, e.g. "LAB2"
+ */
+void bpred_sweep_print(const BPredSweep *sweep, const char *prefix);
+
+#endif
@@ -0,0 +1,202 @@
+// brreplay.cpp
+// Runs branch predictors against a branch trace file made by trace2br,
+// without reading the full trace or simulating the pipeline.
+//
+// The branches are decoded a block at a time, and every block is run through
+// every predictor before the next is decoded, so each block is decoded once
+// and stays in cache while the predictors run. The time each predictor spends
+// is measured separately from the time spent decoding. Predictors have no use
+// for the targets of the branches, so those are skipped without decoding.
+
+#include "bpred.h"
+#include "bpredsweep.h"
+#include "brtrace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** The number of branches decoded at a time: one block of the trace. */
+#define REPLAY_BLOCK_BRANCHES BRTRACE_BLOCK_BRANCHES
+
+/**
+ * The log2 of the number of entries in each branch predictor table, for
+ * predictors that don't give their own.
+ * 
+ * You should not modify this value directly; it is set by the command-line
+ * argument -bpredbits.
+ */
+uint32_t BPRED_TABLE_BITS = 12;
+
+/**
+ * The number of past branch outcomes used, for predictors that don't give
+ * their own.
+ * 
+ * You should not modify this value directly; it is set by the command-line
+ * argument -bpredhist.
+ */
+uint32_t BPRED_HIST_LEN = 12;
+
+static void print_usage(char *program_name)
+{
+    fprintf(stderr, "Usage: %s [options] <branch trace file> <predictor list>\n\n",
+            program_name);
+    fprintf(stderr, "Reports the misprediction rate and speed of every branch predictor in\n");
+    fprintf(stderr, "<predictor list>, e.g. gshare:12:12,bimodal:14,perceptron, each\n");
+    fprintf(stderr, "<policy>[:<bits>[:<hist>]] as for sim -bpredsweep\n\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "    -bpredbits <bits>   Set log2 of the number of entries in each branch\n");
+    fprintf(stderr, "                        predictor table (Default: 12)\n");
+    fprintf(stderr, "    -bpredhist <len>    Set number of past branch outcomes the branch\n");
+    fprintf(stderr, "                        predictor uses (Default: 12)\n");
+}
+
+/**
+ * Get the time from a monotonic clock.
+ *
+ * @return the time in seconds
+ */
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+    static uint64_t pcs[REPLAY_BLOCK_BRANCHES];
+    static uint8_t dir_bits[REPLAY_BLOCK_BRANCHES];
+    static BranchDirection dirs[REPLAY_BLOCK_BRANCHES];
+    char *args[2];
+    int num_args = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-bpredbits") == 0)
+        {
+            if (++i >= argc)
+            {
+                fprintf(stderr, "Error: missing argument to -bpredbits\n");
+                return 2;
+            }
+
+            int table_bits = atoi(argv[i]);
+            if (table_bits < 1 || table_bits > BPRED_MAX_TABLE_BITS)
+            {
+                fprintf(stderr, "Error: predictor table bits must be between 1 and %d\n", BPRED_MAX_TABLE_BITS);
+                return 2;
+            }
+
+            BPRED_TABLE_BITS = table_bits;
+        }
+        else if (strcmp(argv[i], "-bpredhist") == 0)
+        {
+            if (++i >= argc)
+            {
+                fprintf(stderr, "Error: missing argument to -bpredhist\n");
+                return 2;
+            }
+
+            int hist_len = atoi(argv[i]);
+            if (hist_len < 0 || hist_len > BPRED_MAX_HIST_LEN)
+            {
+                fprintf(stderr, "Error: predictor history length must be between 0 and %d\n", BPRED_MAX_HIST_LEN);
+                return 2;
+            }
+
+            BPRED_HIST_LEN = hist_len;
+        }
+        else if (argv[i][0] == '-' || num_args == 2)
+        {
+            print_usage(argv[0]);
+            return 2;
+        }
+        else
+        {
+            args[num_args++] = argv[i];
+        }
+    }
+    if (num_args != 2)
+    {
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    BPredSweep *sweep =
+        bpred_sweep_parse(args[1], BPRED_TABLE_BITS, BPRED_HIST_LEN);
+    if (sweep == NULL)
+    {
+        return 2;
+    }
+    BranchTrace *bt = brtrace_open(args[0]);
+    if (bt == NULL)
+    {
+        bpred_sweep_free(sweep);
+        return 1;
+    }
+    sweep->num_inst = bt->header.num_inst;
+    printf("** REPLAYING %" PRIu64 " BRANCHES ON %u BRANCH PREDICTORS **\n",
+           bt->header.num_branches, sweep->count);
+
+    double *seconds = (double *)calloc(sweep->count, sizeof(double));
+    double decode_seconds = 0.0;
+    int status = 0;
+    while (true)
+    {
+        double start = now_seconds();
+        ssize_t count =
+            brtrace_read(bt, pcs, dir_bits, NULL, REPLAY_BLOCK_BRANCHES);
+        if (count == -1)
+        {
+            status = 1;
+            break;
+        }
+        if (count == 0)
+        {
+            break;
+        }
+        for (ssize_t i = 0; i < count; i++)
+        {
+            dirs[i] = (BranchDirection)dir_bits[i];
+        }
+        decode_seconds += now_seconds() - start;
+
+        for (uint32_t i = 0; i < sweep->count; i++)
+        {
+            start = now_seconds();
+            BPredSweepEntry *entry = &sweep->entries[i];
+            entry->num_branches += count;
+            entry->num_mispred += entry->algorithm->replay(pcs, dirs, count);
+            seconds[i] += now_seconds() - start;
+        }
+    }
+    brtrace_close(bt);
+
+    if (status == 0)
+    {
+        printf("\n");
+        bpred_sweep_print(sweep, "BRREPLAY");
+
+        char name[64];
+        uint64_t num_branches = sweep->entries[0].num_branches;
+        double rate = decode_seconds > 0.0
+                          ? (double)num_branches / decode_seconds / 1e6
+                          : 0.0;
+        printf("%-24s\t : %10.3f seconds  %10.1f M branches/sec\n",
+               "BRREPLAY_DECODE", decode_seconds, rate);
+        for (uint32_t i = 0; i < sweep->count; i++)
+        {
+            rate = seconds[i] > 0.0
+                       ? (double)num_branches / seconds[i] / 1e6
+                       : 0.0;
+            snprintf(name, sizeof(name), "BRREPLAY_SPEED_%u", i);
+            printf("%-24s\t : %10.3f seconds  %10.1f M branches/sec\n", name,
+                   seconds[i], rate);
+        }
+    }
+
+    free(seconds);
+    bpred_sweep_free(sweep);
+    return status;
+}
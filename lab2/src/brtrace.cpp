@@ -0,0 +1,394 @@
+// brtrace.cpp
+// Implements the reader and writer for branch trace files.
+
+#include "brtrace.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(sizeof(BranchTraceHeader) == 32,
+              "BranchTraceHeader must be packed");
+
+/** The largest number of bytes a varint can take. */
+#define MAX_VARINT_BYTES 10
+
+/** The size of the header of a block: its branch, PC, and target counts. */
+#define BLOCK_HEADER_BYTES 12
+
+/**
+ * Write exactly size bytes at the current position of the trace file.
+ *
+ * @param bt the trace
+ * @param buf the bytes to write
+ * @param size the number of bytes to write
+ * @return 0 on success, or -1 on error
+ */
+static int write_full(BranchTrace *bt, const void *buf, size_t size)
+{
+    const uint8_t *bytes = (const uint8_t *)buf;
+    while (size > 0)
+    {
+        ssize_t bytes_written = write(bt->fd, bytes, size);
+        if (bytes_written == -1)
+        {
+            perror("Couldn't write to branch trace file");
+            return -1;
+        }
+        bytes += bytes_written;
+        size -= bytes_written;
+    }
+    return 0;
+}
+
+/**
+ * Append a varint to a buffer.
+ *
+ * @param out where to write the varint
+ * @param value the value to encode
+ * @return a pointer just past the varint
+ */
+static inline uint8_t *put_varint(uint8_t *out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        *out++ = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    *out++ = value;
+    return out;
+}
+
+/**
+ * Decode a varint from a buffer.
+ *
+ * Varints of up to 8 bytes are decoded from a single 8-byte load without
+ * branching on their length, which is as unpredictable as the branches of the
+ * trace are.
+ *
+ * @param in the varint
+ * @param end the end of the buffer
+ * @param value set to the value decoded
+ * @return a pointer just past the varint, or NULL if the buffer ends first
+ */
+static inline const uint8_t *get_varint(const uint8_t *in, const uint8_t *end,
+                                        uint64_t *value)
+{
+    if (end - in >= 8)
+    {
+        uint64_t word;
+        memcpy(&word, in, sizeof(word));
+        uint64_t stops = ~word & 0x8080808080808080ULL;
+        if (stops != 0)
+        {
+            // Keep the bytes up to the first without the continuation bit,
+            // then squeeze the 7-bit groups together.
+            unsigned int bits = __builtin_ctzll(stops) + 1;
+            word &= (~0ULL >> (64 - bits)) & 0x7F7F7F7F7F7F7F7FULL;
+            word = ((word & 0x7F007F007F007F00ULL) >> 1) |
+                   (word & 0x007F007F007F007FULL);
+            word = ((word & 0x3FFF00003FFF0000ULL) >> 2) |
+                   (word & 0x00003FFF00003FFFULL);
+            word = ((word & 0x0FFFFFFF00000000ULL) >> 4) |
+                   (word & 0x000000000FFFFFFFULL);
+            *value = word;
+            return in + bits / 8;
+        }
+    }
+
+    uint64_t result = 0;
+    for (unsigned int shift = 0; in < end && shift < 64; shift += 7)
+    {
+        uint8_t byte = *in++;
+        result |= (uint64_t)(byte & 0x7F) << shift;
+        if (byte < 0x80)
+        {
+            *value = result;
+            return in;
+        }
+    }
+    return NULL;
+}
+
+BranchTrace *brtrace_open(const char *filename)
+{
+    BranchTrace *bt = (BranchTrace *)calloc(1, sizeof(BranchTrace));
+
+    bt->fd = open(filename, O_RDONLY);
+    if (bt->fd == -1)
+    {
+        perror("Couldn't open branch trace file");
+        free(bt);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(bt->fd, &st) == -1)
+    {
+        perror("Couldn't open branch trace file");
+        close(bt->fd);
+        free(bt);
+        return NULL;
+    }
+    if ((size_t)st.st_size >= sizeof(bt->header))
+    {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, bt->fd, 0);
+        if (map == MAP_FAILED)
+        {
+            perror("Couldn't map branch trace file");
+            close(bt->fd);
+            free(bt);
+            return NULL;
+        }
+        bt->map = (uint8_t *)map;
+        bt->map_size = st.st_size;
+        madvise(bt->map, bt->map_size, MADV_SEQUENTIAL);
+        memcpy(&bt->header, bt->map, sizeof(bt->header));
+    }
+
+    if (bt->map == NULL ||
+        memcmp(bt->header.magic, BRTRACE_MAGIC, sizeof(bt->header.magic)) != 0 ||
+        bt->header.version != BRTRACE_VERSION)
+    {
+        fprintf(stderr, "Error: not a version %d branch trace file\n",
+                BRTRACE_VERSION);
+        brtrace_close(bt);
+        return NULL;
+    }
+
+    bt->next_block = sizeof(bt->header);
+    return bt;
+}
+
+/**
+ * Start reading the next block of a trace.
+ *
+ * @param bt the trace, at the end of a block
+ * @return 0 on success, or -1 if the block is truncated or invalid
+ */
+static int start_block(BranchTrace *bt)
+{
+    uint32_t counts[3];
+    if (bt->map_size - bt->next_block < BLOCK_HEADER_BYTES)
+    {
+        fprintf(stderr, "Error: branch trace file is truncated\n");
+        return -1;
+    }
+    memcpy(counts, bt->map + bt->next_block, BLOCK_HEADER_BYTES);
+    bt->next_block += BLOCK_HEADER_BYTES;
+    if (counts[0] == 0 || counts[0] > BRTRACE_BLOCK_BRANCHES ||
+        counts[0] > bt->header.num_branches - bt->branch)
+    {
+        fprintf(stderr, "Error: Invalid branch trace file\n");
+        return -1;
+    }
+    if (bt->map_size - bt->next_block < (uint64_t)counts[1] + counts[2])
+    {
+        fprintf(stderr, "Error: branch trace file is truncated\n");
+        return -1;
+    }
+
+    bt->block_branches = counts[0];
+    bt->pc_pos = bt->map + bt->next_block;
+    bt->pc_end = bt->pc_pos + counts[1];
+    bt->target_pos = bt->pc_end;
+    bt->target_end = bt->target_pos + counts[2];
+    bt->next_block += (uint64_t)counts[1] + counts[2];
+    return 0;
+}
+
+ssize_t brtrace_read(BranchTrace *bt, uint64_t *pcs, uint8_t *dirs,
+                     uint64_t *targets, size_t max_branches)
+{
+    size_t count = 0;
+    while (count < max_branches && bt->branch < bt->header.num_branches)
+    {
+        if (bt->block_branches == 0 && start_block(bt) != 0)
+        {
+            return -1;
+        }
+
+        size_t num_branches = max_branches - count;
+        if (num_branches > bt->block_branches)
+        {
+            num_branches = bt->block_branches;
+        }
+
+        // The PCs, then the targets, which are relative to them.
+        const uint8_t *in = bt->pc_pos;
+        uint64_t pc = bt->last_pc;
+        for (size_t i = count; i < count + num_branches; i++)
+        {
+            uint64_t field;
+            in = get_varint(in, bt->pc_end, &field);
+            if (in == NULL)
+            {
+                fprintf(stderr, "Error: Invalid branch trace file\n");
+                return -1;
+            }
+            uint64_t zigzag = field >> 1;
+            pc += (zigzag >> 1) ^ -(zigzag & 1);
+            pcs[i] = pc;
+            dirs[i] = field & 1;
+        }
+        bt->pc_pos = in;
+        bt->last_pc = pc;
+
+        if (targets != NULL)
+        {
+            in = bt->target_pos;
+            for (size_t i = count; i < count + num_branches; i++)
+            {
+                uint64_t field;
+                in = get_varint(in, bt->target_end, &field);
+                if (in == NULL)
+                {
+                    fprintf(stderr, "Error: Invalid branch trace file\n");
+                    return -1;
+                }
+                targets[i] = pcs[i] + ((field >> 1) ^ -(field & 1));
+            }
+            bt->target_pos = in;
+        }
+
+        bt->block_branches -= num_branches;
+        bt->branch += num_branches;
+        count += num_branches;
+    }
+    return count;
+}
+
+BranchTrace *brtrace_create(const char *filename)
+{
+    BranchTrace *bt = (BranchTrace *)calloc(1, sizeof(BranchTrace));
+    bt->writing = true;
+
+    bt->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (bt->fd == -1)
+    {
+        perror("Couldn't create branch trace file");
+        free(bt);
+        return NULL;
+    }
+
+    // Leave room for the header, which is written last.
+    memcpy(bt->header.magic, BRTRACE_MAGIC, sizeof(bt->header.magic));
+    bt->header.version = BRTRACE_VERSION;
+    if (write_full(bt, &bt->header, sizeof(bt->header)) != 0)
+    {
+        close(bt->fd);
+        free(bt);
+        return NULL;
+    }
+
+    bt->pc_buf = (uint8_t *)malloc(BRTRACE_BLOCK_BRANCHES * MAX_VARINT_BYTES);
+    bt->target_buf =
+        (uint8_t *)malloc(BRTRACE_BLOCK_BRANCHES * MAX_VARINT_BYTES);
+    return bt;
+}
+
+/**
+ * Write out the block being written, if it has any branches.
+ *
+ * @param bt the trace, opened with brtrace_create()
+ * @return 0 on success, or -1 on error
+ */
+static int flush_block(BranchTrace *bt)
+{
+    if (bt->block_branches == 0)
+    {
+        return 0;
+    }
+
+    uint32_t counts[3] = {bt->block_branches, bt->pc_bytes, bt->target_bytes};
+    if (write_full(bt, counts, BLOCK_HEADER_BYTES) != 0 ||
+        write_full(bt, bt->pc_buf, bt->pc_bytes) != 0 ||
+        write_full(bt, bt->target_buf, bt->target_bytes) != 0)
+    {
+        return -1;
+    }
+    bt->block_branches = 0;
+    bt->pc_bytes = 0;
+    bt->target_bytes = 0;
+    return 0;
+}
+
+int brtrace_write(BranchTrace *bt, const BranchRec *rec)
+{
+    // The direction takes the lowest bit, so the zigzag-encoded PC delta must
+    // fit in 63 bits, which it does unless the branches are over 2^62 bytes
+    // apart.
+    uint64_t delta = rec->pc - bt->last_pc;
+    uint64_t zigzag = (delta << 1) ^ -(delta >> 63);
+    if (zigzag >> 63)
+    {
+        fprintf(stderr, "Error: branch at 0x%" PRIx64 " is too far from the "
+                        "last one\n", rec->pc);
+        return -1;
+    }
+    uint64_t target_delta = rec->target - rec->pc;
+
+    uint8_t *out = put_varint(bt->pc_buf + bt->pc_bytes,
+                              (zigzag << 1) | (rec->dir & 1));
+    bt->pc_bytes = out - bt->pc_buf;
+    out = put_varint(bt->target_buf + bt->target_bytes,
+                     (target_delta << 1) ^ -(target_delta >> 63));
+    bt->target_bytes = out - bt->target_buf;
+    bt->last_pc = rec->pc;
+    bt->branch++;
+
+    if (++bt->block_branches == BRTRACE_BLOCK_BRANCHES)
+    {
+        return flush_block(bt);
+    }
+    return 0;
+}
+
+/**
+ * Write out the last block and the final header.
+ *
+ * @param bt the trace, opened with brtrace_create()
+ * @return 0 on success, or -1 on error
+ */
+static int finish_writing(BranchTrace *bt)
+{
+    if (flush_block(bt) != 0)
+    {
+        return -1;
+    }
+
+    bt->header.num_branches = bt->branch;
+    if (lseek(bt->fd, 0, SEEK_SET) == -1)
+    {
+        perror("Couldn't seek in branch trace file");
+        return -1;
+    }
+    return write_full(bt, &bt->header, sizeof(bt->header));
+}
+
+int brtrace_close(BranchTrace *bt)
+{
+    int status = 0;
+
+    if (bt->writing)
+    {
+        status = finish_writing(bt);
+        free(bt->pc_buf);
+        free(bt->target_buf);
+    }
+    else if (bt->map != NULL)
+    {
+        munmap(bt->map, bt->map_size);
+    }
+    if (close(bt->fd) != 0)
+    {
+        perror("Couldn't close branch trace file");
+        status = -1;
+    }
+
+    free(bt);
+    return status;
+}
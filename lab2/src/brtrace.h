@@ -0,0 +1,192 @@
+// brtrace.h
+// Declares a reader and writer for branch trace files: the conditional
+// branches of a lab2 trace, and nothing else.
+//
+// Branch predictors only look at the address, direction, and target of each
+// conditional branch, so a branch trace keeps just those, in a few bytes per
+// branch instead of a 48-byte TraceRec per instruction. Branches are grouped
+// into blocks of up to BRTRACE_BLOCK_BRANCHES, and each block stores two
+// separate streams of little-endian base-128 varints:
+//
+// - For each branch, the difference of its PC from the previous branch's PC
+//   (the first PC of the trace is relative to 0), zigzag-encoded, shifted
+//   left by one, with the direction in the lowest bit.
+// - For each branch, the difference of its target from its PC,
+//   zigzag-encoded.
+//
+// Keeping the targets apart lets a reader that only wants PCs and directions,
+// like a branch predictor, skip them without decoding them.
+//
+// File layout, all integers little-endian:
+//
+//   BranchTraceHeader
+//   For each block:
+//     uint32_t num_branches
+//     uint32_t pc_bytes
+//     uint32_t target_bytes
+//     uint8_t  pcs[pc_bytes]
+//     uint8_t  targets[target_bytes]
+
+#ifndef _BRTRACE_H_
+#define _BRTRACE_H_
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/** The magic bytes at the start of every branch trace file. */
+#define BRTRACE_MAGIC "LAB2BRTR"
+
+/** The version of the format written by brtrace_create(). */
+#define BRTRACE_VERSION 1
+
+/** The largest number of branches in a block. */
+#define BRTRACE_BLOCK_BRANCHES 65536
+
+/** The header at the start of a branch trace file. */
+typedef struct BranchTraceHeader
+{
+    /** BRTRACE_MAGIC, without the terminating NUL. */
+    char magic[8];
+
+    /** BRTRACE_VERSION. */
+    uint32_t version;
+
+    /** Unused; zero. */
+    uint32_t reserved;
+
+    /** The number of branches in the trace. */
+    uint64_t num_branches;
+
+    /** The number of instructions in the trace the branches came from. */
+    uint64_t num_inst;
+} BranchTraceHeader;
+
+/** A conditional branch. */
+typedef struct BranchRec
+{
+    /** The address of the branch. */
+    uint64_t pc;
+
+    /** The address the branch jumps to if taken. */
+    uint64_t target;
+
+    /** 1 if the branch was taken, 0 if not. */
+    uint8_t dir;
+} BranchRec;
+
+/** An open branch trace file, for reading or writing. */
+typedef struct BranchTrace
+{
+    /** The file descriptor of the trace file. */
+    int fd;
+
+    /** Whether the trace was opened with brtrace_create(). */
+    bool writing;
+
+    /**
+     * The header of the trace file. When writing, set header.num_inst before
+     * closing.
+     */
+    BranchTraceHeader header;
+
+    /** The number of branches read or written so far. */
+    uint64_t branch;
+
+    /** The PC of the last branch read or written. */
+    uint64_t last_pc;
+
+    /** When reading, the mapping of the whole file. */
+    uint8_t *map;
+
+    /** The size of the mapping. */
+    size_t map_size;
+
+    /** When reading, the offset of the next block in the mapping. */
+    size_t next_block;
+
+    /**
+     * When reading, the number of branches left in the current block; when
+     * writing, the number of branches in it so far.
+     */
+    uint32_t block_branches;
+
+    /** When reading, the next PC of the block. */
+    const uint8_t *pc_pos;
+
+    /** When reading, the end of the PCs of the block. */
+    const uint8_t *pc_end;
+
+    /** When reading, the next target of the block. */
+    const uint8_t *target_pos;
+
+    /** When reading, the end of the targets of the block. */
+    const uint8_t *target_end;
+
+    /** When writing, the PCs of the block, encoded. */
+    uint8_t *pc_buf;
+
+    /** When writing, the number of bytes in pc_buf. */
+    uint32_t pc_bytes;
+
+    /** When writing, the targets of the block, encoded. */
+    uint8_t *target_buf;
+
+    /** When writing, the number of bytes in target_buf. */
+    uint32_t target_bytes;
+} BranchTrace;
+
+/**
+ * Open a branch trace file for reading.
+ *
+ * @param filename the path of the trace file
+ * @return a pointer to a newly allocated trace, or NULL on failure
+ */
+BranchTrace *brtrace_open(const char *filename);
+
+/**
+ * Read and decode branches.
+ *
+ * The buffers are filled as far as possible, and fewer than max_branches
+ * branches are returned only at the end of the trace.
+ *
+ * @param bt the trace, opened with brtrace_open()
+ * @param pcs where to put the addresses of the branches
+ * @param dirs where to put the directions of the branches
+ * @param targets where to put the targets of the branches, or NULL to skip
+ *                them
+ * @param max_branches the size of the buffers
+ * @return the number of branches read, 0 at the end of the trace, or -1 on
+ *         error
+ */
+ssize_t brtrace_read(BranchTrace *bt, uint64_t *pcs, uint8_t *dirs,
+                     uint64_t *targets, size_t max_branches);
+
+/**
+ * Create a branch trace file for writing, replacing any existing file.
+ *
+ * @param filename the path of the trace file
+ * @return a pointer to a newly allocated trace, or NULL on failure
+ */
+BranchTrace *brtrace_create(const char *filename);
+
+/**
+ * Encode and write a branch.
+ *
+ * @param bt the trace, opened with brtrace_create()
+ * @param rec the branch
+ * @return 0 on success, or -1 on error
+ */
+int brtrace_write(BranchTrace *bt, const BranchRec *rec);
+
+/**
+ * Close a branch trace file and free it.
+ *
+ * When writing, this first writes out the last block and the final header.
+ *
+ * @param bt the trace
+ * @return 0 on success, or -1 on error
+ */
+int brtrace_close(BranchTrace *bt);
+
+#endif
@@ -0,0 +1,174 @@
+// btb.cpp
+// Implements the branch target buffer and return address stack.
+
+#include "btb.h"
+#include <stdlib.h>
+#include <string.h>
+
+/** The names of the BTB replacement policies, as accepted by -btbrepl. */
+static const char *const BTB_REPL_NAMES[NUM_BTB_REPL_POLICIES] = {"lru",
+                                                                  "random"};
+
+BTB *btb_new(uint32_t num_entries, uint32_t ways, BTBReplPolicy repl)
+{
+    BTB *btb = (BTB *)calloc(1, sizeof(BTB));
+    btb->entries = (BTBEntry *)calloc(num_entries, sizeof(BTBEntry));
+    btb->set_mask = num_entries / ways - 1;
+    btb->ways = ways;
+    btb->repl = repl;
+    btb->random = 0x2545F491;
+    return btb;
+}
+
+/**
+ * Find a branch in its set of the BTB.
+ *
+ * @param btb the BTB
+ * @param pc the address of the branch
+ * @param set set to the first entry of the branch's set
+ * @return the entry of the branch, or NULL if it is not in the BTB
+ */
+static BTBEntry *btb_find(BTB *btb, uint64_t pc, BTBEntry **set)
+{
+    *set = &btb->entries[(size_t)(pc & btb->set_mask) * btb->ways];
+    for (uint32_t i = 0; i < btb->ways; i++)
+    {
+        if ((*set)[i].valid && (*set)[i].pc == pc)
+        {
+            return &(*set)[i];
+        }
+    }
+    return NULL;
+}
+
+bool btb_lookup(BTB *btb, uint64_t pc, uint64_t *target)
+{
+    BTBEntry *set;
+    BTBEntry *entry = btb_find(btb, pc, &set);
+    btb->stat_lookups++;
+    if (entry == NULL)
+    {
+        return false;
+    }
+
+    btb->stat_hits++;
+    entry->last_access = ++btb->num_accesses;
+    *target = entry->target;
+    return true;
+}
+
+void btb_update(BTB *btb, uint64_t pc, uint64_t target)
+{
+    BTBEntry *set;
+    BTBEntry *entry = btb_find(btb, pc, &set);
+    if (entry == NULL)
+    {
+        // Fill an empty way first, then evict by the replacement policy.
+        for (uint32_t i = 0; i < btb->ways && entry == NULL; i++)
+        {
+            if (!set[i].valid)
+            {
+                entry = &set[i];
+            }
+        }
+        if (entry == NULL && btb->repl == BTB_RANDOM)
+        {
+            btb->random ^= btb->random << 13;
+            btb->random ^= btb->random >> 17;
+            btb->random ^= btb->random << 5;
+            entry = &set[btb->random % btb->ways];
+        }
+        else if (entry == NULL)
+        {
+            entry = &set[0];
+            for (uint32_t i = 1; i < btb->ways; i++)
+            {
+                if (set[i].last_access < entry->last_access)
+                {
+                    entry = &set[i];
+                }
+            }
+        }
+        entry->valid = true;
+        entry->pc = pc;
+    }
+    entry->target = target;
+    entry->last_access = ++btb->num_accesses;
+}
+
+void btb_free(BTB *btb)
+{
+    if (btb == NULL)
+    {
+        return;
+    }
+    free(btb->entries);
+    free(btb);
+}
+
+const char *btb_repl_name(BTBReplPolicy repl)
+{
+    return BTB_REPL_NAMES[repl];
+}
+
+bool btb_repl_parse(const char *name, BTBReplPolicy *repl)
+{
+    for (int i = 0; i < NUM_BTB_REPL_POLICIES; i++)
+    {
+        if (strcmp(name, BTB_REPL_NAMES[i]) == 0)
+        {
+            *repl = (BTBReplPolicy)i;
+            return true;
+        }
+    }
+
+    char *end;
+    long number = strtol(name, &end, 10);
+    if (*name == '\0' || *end != '\0' || number < 0 ||
+        number >= NUM_BTB_REPL_POLICIES)
+    {
+        return false;
+    }
+    *repl = (BTBReplPolicy)number;
+    return true;
+}
+
+RAS *ras_new(uint32_t size)
+{
+    RAS *ras = (RAS *)calloc(1, sizeof(RAS));
+    ras->entries = (uint64_t *)calloc(size, sizeof(uint64_t));
+    ras->size = size;
+    return ras;
+}
+
+void ras_push(RAS *ras, uint64_t pc)
+{
+    ras->entries[ras->top] = pc;
+    ras->top = (ras->top + 1) % ras->size;
+    if (ras->count < ras->size)
+    {
+        ras->count++;
+    }
+}
+
+bool ras_pop(RAS *ras, uint64_t *pc)
+{
+    if (ras->count == 0)
+    {
+        return false;
+    }
+    ras->top = (ras->top + ras->size - 1) % ras->size;
+    ras->count--;
+    *pc = ras->entries[ras->top];
+    return true;
+}
+
+void ras_free(RAS *ras)
+{
+    if (ras == NULL)
+    {
+        return;
+    }
+    free(ras->entries);
+    free(ras);
+}
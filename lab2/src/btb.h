@@ -0,0 +1,230 @@
+// btb.h
+// Declares the branch target buffer (BTB) and return address stack (RAS) of
+// the fetch stage.
+//
+// The branch predictor only says whether a branch is taken. To keep fetching
+// past a taken branch without waiting for it to be decoded, the fetch stage
+// must also know where it goes: the BTB remembers the last target of each
+// branch, and the RAS predicts the target of a return as the instruction after
+// the most recent call. A taken branch whose target the fetch stage gets wrong
+// stalls fetch just like a mispredicted direction.
+//
+// The trace gives targets only for conditional branches. Any other
+// instruction followed by one more than BTB_MAX_INST_BYTES ahead of it, or
+// behind it, is taken to be a jump; a jump that writes memory is taken to be a
+// call, pushing its return address, and one that only reads memory a return.
+
+#ifndef _BTB_H_
+#define _BTB_H_
+
+#include <inttypes.h>
+
+/**
+ * The number of entries in the BTB, or 0 to predict every target perfectly
+ * and model neither the BTB nor the RAS.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -btbentries.
+ */
+extern uint32_t BTB_ENTRIES;
+
+/**
+ * The number of ways in each set of the BTB.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -btbways.
+ */
+extern uint32_t BTB_WAYS;
+
+/**
+ * The number of entries in the RAS, or 0 to predict returns with the BTB.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -rasentries.
+ */
+extern uint32_t RAS_ENTRIES;
+
+/** [Internal] The maximum value of BTB_ENTRIES. */
+#define BTB_MAX_ENTRIES (1 << 20)
+
+/** [Internal] The maximum value of RAS_ENTRIES. */
+#define RAS_MAX_ENTRIES 1024
+
+/**
+ * [Internal] The length of the longest instruction. An instruction followed
+ * by one at most this many bytes after it did not jump.
+ */
+#define BTB_MAX_INST_BYTES 15
+
+/** The replacement policies of the BTB. */
+typedef enum BTBReplPolicyEnum
+{
+    BTB_LRU = 0,    // Evict the least recently used entry of the set.
+    BTB_RANDOM = 1, // Evict a random entry of the set.
+    NUM_BTB_REPL_POLICIES
+} BTBReplPolicy;
+
+/**
+ * The replacement policy of the BTB.
+ *
+ * You should not modify this value directly; it is set by the command-line
+ * argument -btbrepl.
+ */
+extern BTBReplPolicy BTB_REPL;
+
+/** An entry of the BTB: the last target of one branch. */
+typedef struct BTBEntry
+{
+    /** The address of the branch. */
+    uint64_t pc;
+
+    /** The address the branch last jumped to. */
+    uint64_t target;
+
+    /** The value of BTB::num_accesses when the entry was last used. */
+    uint64_t last_access;
+
+    /** Whether the entry holds a branch. */
+    bool valid;
+} BTBEntry;
+
+/** A set-associative branch target buffer. */
+typedef struct BTB
+{
+    /** The entries, ways consecutive entries to a set. */
+    BTBEntry *entries;
+
+    /** The number of sets, minus 1. */
+    uint32_t set_mask;
+
+    /** The number of ways in each set. */
+    uint32_t ways;
+
+    /** The replacement policy. */
+    BTBReplPolicy repl;
+
+    /** The number of lookups and updates so far, to order uses for LRU. */
+    uint64_t num_accesses;
+
+    /** The state of a xorshift generator, so that runs are repeatable. */
+    uint32_t random;
+
+    /** The number of taken branches looked up. */
+    uint64_t stat_lookups;
+
+    /** The number of lookups that found the branch. */
+    uint64_t stat_hits;
+
+    /** The number of taken branches whose target fetch got wrong. */
+    uint64_t stat_mispred;
+} BTB;
+
+/** A return address stack, which overwrites its oldest entry when full. */
+typedef struct RAS
+{
+    /** The addresses of the calls pushed, as a circular buffer. */
+    uint64_t *entries;
+
+    /** The number of entries. */
+    uint32_t size;
+
+    /** The index of the entry above the newest one. */
+    uint32_t top;
+
+    /** The number of entries in use. */
+    uint32_t count;
+
+    /** The number of returns predicted. */
+    uint64_t stat_returns;
+
+    /** The number of returns whose target was mispredicted. */
+    uint64_t stat_mispred;
+} RAS;
+
+/**
+ * Allocate an empty BTB.
+ *
+ * @param num_entries the number of entries, a power of two times ways
+ * @param ways the number of ways in each set
+ * @param repl the replacement policy
+ * @return a pointer to a newly allocated BTB
+ */
+BTB *btb_new(uint32_t num_entries, uint32_t ways, BTBReplPolicy repl);
+
+/**
+ * Look up the target of a taken branch, and count the lookup.
+ *
+ * @param btb the BTB
+ * @param pc the address of the branch
+ * @param target set to the last target of the branch, if it is in the BTB
+ * @return whether the branch is in the BTB
+ */
+bool btb_lookup(BTB *btb, uint64_t pc, uint64_t *target);
+
+/**
+ * Record the target of a taken branch, replacing an entry of its set if the
+ * branch is not in the BTB.
+ *
+ * @param btb the BTB
+ * @param pc the address of the branch
+ * @param target the address the branch jumped to
+ */
+void btb_update(BTB *btb, uint64_t pc, uint64_t target);
+
+/**
+ * Free a BTB.
+ *
+ * @param btb the BTB to free
+ */
+void btb_free(BTB *btb);
+
+/**
+ * Get the name of a BTB replacement policy, as accepted by -btbrepl.
+ *
+ * @param repl the policy
+ * @return the name, e.g. "lru"
+ */
+const char *btb_repl_name(BTBReplPolicy repl);
+
+/**
+ * Look up a BTB replacement policy by name or number.
+ *
+ * @param name the name of the policy, e.g. "lru", or its number
+ * @param repl set to the policy
+ * @return true if the policy exists
+ */
+bool btb_repl_parse(const char *name, BTBReplPolicy *repl);
+
+/**
+ * Allocate an empty RAS.
+ *
+ * @param size the number of entries
+ * @return a pointer to a newly allocated RAS
+ */
+RAS *ras_new(uint32_t size);
+
+/**
+ * Push the address of a call.
+ *
+ * @param ras the RAS
+ * @param pc the address of the call
+ */
+void ras_push(RAS *ras, uint64_t pc);
+
+/**
+ * Pop the address of the newest call.
+ *
+ * @param ras the RAS
+ * @param pc set to the address of the call, if the RAS is not empty
+ * @return whether the RAS was not empty
+ */
+bool ras_pop(RAS *ras, uint64_t *pc);
+
+/**
+ * Free a RAS.
+ *
+ * @param ras the RAS to free
+ */
+void ras_free(RAS *ras);
+
+#endif
@@ -0,0 +1,105 @@
+// pht.h
+// Declares pattern history tables: tables of 2-bit saturating counters, each
+// predicting taken when it is 2 or more. Counters start weakly taken.
+//
+// CounterTable, which the branch predictors use, packs 32 counters into each
+// 64-bit word, so that a table of 1M counters takes 256 KiB and more of it
+// stays in cache than with one counter per byte. ByteCounterTable keeps one
+// counter per byte, and is only kept for bpredbench to compare against.
+
+#ifndef _PHT_H_
+#define _PHT_H_
+
+#include "bpred.h"
+#include <inttypes.h>
+#include <vector>
+
+/** A table of 2-bit counters packed 32 to a 64-bit word. */
+class CounterTable
+{
+private:
+    std::vector<uint64_t> words;
+    uint32_t mask;
+
+public:
+    // 0xAA... sets every counter to 2, binary 10.
+    CounterTable(uint32_t bits)
+        : words(bits > 5 ? 1u << (bits - 5) : 1, 0xAAAAAAAAAAAAAAAAULL),
+          mask((1u << bits) - 1)
+    {
+    }
+
+    /** Get the index of the counter for a hash of the branch. */
+    uint32_t index(uint64_t hash) const
+    {
+        return (uint32_t)hash & mask;
+    }
+
+    /** The high bit of a counter is its prediction. */
+    BranchDirection predict(uint32_t index) const
+    {
+        uint64_t word = words[index >> 5];
+        return (BranchDirection)((word >> (2 * (index & 31) + 1)) & 1);
+    }
+
+    /**
+     * Saturate without branching: the next value of a counter is looked up in
+     * a 16-bit constant holding a 2-bit entry for each counter value and
+     * outcome, at bit 4 * counter + 2 * taken.
+     */
+    void update(uint32_t index, BranchDirection resolution)
+    {
+        uint64_t &word = words[index >> 5];
+        uint32_t shift = 2 * (index & 31);
+        uint32_t counter = (word >> shift) & 3;
+        uint32_t taken = resolution == TAKEN;
+        uint32_t next = (0xED84 >> (4 * counter + 2 * taken)) & 3;
+        word ^= (uint64_t)(counter ^ next) << shift;
+    }
+
+    /** Get the size of the table in bytes. */
+    size_t size_bytes() const
+    {
+        return words.size() * sizeof(uint64_t);
+    }
+};
+
+/** A table of 2-bit counters kept one to a byte. */
+class ByteCounterTable
+{
+private:
+    std::vector<uint8_t> counters;
+    uint32_t mask;
+
+public:
+    ByteCounterTable(uint32_t bits)
+        : counters(1u << bits, 2), mask((1u << bits) - 1)
+    {
+    }
+
+    /** Get the index of the counter for a hash of the branch. */
+    uint32_t index(uint64_t hash) const
+    {
+        return (uint32_t)hash & mask;
+    }
+
+    BranchDirection predict(uint32_t index) const
+    {
+        return counters[index] >= 2 ? TAKEN : NOT_TAKEN;
+    }
+
+    void update(uint32_t index, BranchDirection resolution)
+    {
+        counters[index] = resolution == TAKEN
+                              ? sat_increment(counters[index], 3)
+                              : sat_decrement(counters[index]);
+    }
+
+    /** Get the size of the table in bytes. */
+    size_t size_bytes() const
+    {
+        return counters.size();
+    }
+};
+
+#endif
@@ -11,11 +11,98 @@
 #include "pipeline.h"
 #include <cstdlib>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
-#include <vector>
+
+/**
+ * Get the next trace record, taking it from the pipeline's trace buffer and
+ * refilling the buffer with many records at once when it runs out.
+ * 
+ * @param p the pipeline whose trace file should be read
+ * @param data set to point at the record
+ * @return the number of bytes available at *data, which is less than
+ *         sizeof(TraceRec) only at the end of the trace, 0 at the end of the
+ *         trace, or -1 on error
+ */
+static ssize_t pipe_read_trace_rec(Pipeline *p, const void **data)
+{
+    if (p->simpoints != NULL)
+    {
+        // Simulation points may end at any record.
+        return simpoints_next(p->simpoints, p->trace, data, sizeof(TraceRec));
+    }
+
+    if (p->trace_buf_left == 0)
+    {
+        const void *buf;
+        ssize_t bytes_read = tracefile_next(
+            p->trace, &buf, PIPE_TRACE_BUF_RECS * sizeof(TraceRec));
+        if (bytes_read <= 0)
+        {
+            return bytes_read;
+        }
+        p->trace_buf = (const uint8_t *)buf;
+        p->trace_buf_left = bytes_read;
+    }
+
+    size_t bytes_read = p->trace_buf_left < sizeof(TraceRec)
+                            ? p->trace_buf_left
+                            : sizeof(TraceRec);
+    *data = p->trace_buf;
+    p->trace_buf += bytes_read;
+    p->trace_buf_left -= bytes_read;
+    return bytes_read;
+}
+
+/**
+ * Get the next trace record, as pipe_read_trace_rec() does, unless
+ * pipe_peek_next_pc() has already read it.
+ * 
+ * @param p the pipeline whose trace file should be read
+ * @param data set to point at the record
+ * @return as for pipe_read_trace_rec()
+ */
+static ssize_t pipe_next_trace_rec(Pipeline *p, const void **data)
+{
+    if (p->peeked)
+    {
+        p->peeked = false;
+        *data = p->peek_data;
+        return p->peek_bytes;
+    }
+    return pipe_read_trace_rec(p, data);
+}
+
+/**
+ * Get the address of the instruction after the last one fetched, without
+ * fetching it.
+ * 
+ * The record of the last instruction fetched has already been copied out of
+ * the trace buffer, so reading the next one can't overwrite it.
+ * 
+ * @param p the pipeline whose trace file should be read
+ * @param pc set to the address of the next instruction, if there is one
+ * @return whether there is a next instruction
+ */
+static bool pipe_peek_next_pc(Pipeline *p, uint64_t *pc)
+{
+    if (!p->peeked)
+    {
+        p->peek_bytes = pipe_read_trace_rec(p, &p->peek_data);
+        p->peeked = true;
+    }
+    if (p->peek_bytes != sizeof(TraceRec))
+    {
+        return false;
+    }
+    memcpy(pc, p->peek_data, sizeof(*pc));
+    return true;
+}
+
 /**
- * Read a single trace record from the trace file and use it to populate the
- * given fetch_op.
+ * Read a single trace record from the trace file into the next free entry of
+ * the pipeline's in-flight operations, and populate the given fetch_op to
+ * refer to it.
  * 
  * You should not modify this function.
  * 
@@ -24,29 +111,21 @@
  */
 void pipe_get_fetch_op(Pipeline *p, PipelineLatch *fetch_op)
 {
-    TraceRec *trace_rec = &fetch_op->trace_rec;
-    uint8_t *trace_rec_buf = (uint8_t *)trace_rec;
-    size_t bytes_read_total = 0;
-    ssize_t bytes_read_last = 0;
-    size_t bytes_left = sizeof(*trace_rec);
+    fetch_op->op = (uint32_t)((p->last_op_id + 1) & p->ops_mask);
+    PipelineOp *op = pipe_op(p, fetch_op);
+    TraceRec *trace_rec = &op->trace_rec;
+    const void *data;
 
-    // Read a total of sizeof(TraceRec) bytes from the trace file.
-    while (bytes_left > 0)
+    // Get the next sizeof(TraceRec) bytes from the trace buffer, skipping
+    // ahead to the next simulation point if needed.
+    ssize_t bytes_read = pipe_next_trace_rec(p, &data);
+    if (bytes_read == sizeof(*trace_rec))
     {
-        bytes_read_last = read(p->trace_fd, trace_rec_buf, bytes_left);
-        if (bytes_read_last <= 0)
-        {
-            // EOF or error
-            break;
-        }
-
-        trace_rec_buf += bytes_read_last;
-        bytes_read_total += bytes_read_last;
-        bytes_left -= bytes_read_last;
+        memcpy(trace_rec, data, sizeof(*trace_rec));
     }
 
     // Check for error conditions.
-    if (bytes_left > 0 || trace_rec->op_type >= NUM_OP_TYPES)
+    if (bytes_read != sizeof(*trace_rec) || trace_rec->op_type >= NUM_OP_TYPES)
     {
         fetch_op->valid = false;
         p->halt_op_id = p->last_op_id;
@@ -56,14 +135,13 @@ void pipe_get_fetch_op(Pipeline *p, PipelineLatch *fetch_op)
             p->halt = true;
         }
 
-        if (bytes_read_last == -1)
+        if (bytes_read == -1)
         {
-            fprintf(stderr, "\n");
-            perror("Couldn't read from pipe");
+            // tracefile_next() has already reported the error.
             return;
         }
 
-        if (bytes_read_total == 0)
+        if (bytes_read == 0)
         {
             // No more trace records to read
             return;
@@ -79,7 +157,8 @@ void pipe_get_fetch_op(Pipeline *p, PipelineLatch *fetch_op)
     fetch_op->valid = true;
     fetch_op->stall = false;
     fetch_op->is_mispred_cbr = false;
-    fetch_op->op_id = ++p->last_op_id;
+    fetch_op->is_mispred_target = false;
+    op->op_id = ++p->last_op_id;
 }
 
 /**
@@ -87,10 +166,10 @@ void pipe_get_fetch_op(Pipeline *p, PipelineLatch *fetch_op)
  * 
  * You should not need to modify this function.
  * 
- * @param trace_fd the file descriptor from which to read trace records
+ * @param trace the trace file from which to read trace records
  * @return a pointer to a newly allocated pipeline
  */
-Pipeline *pipe_init(int trace_fd)
+Pipeline *pipe_init(TraceFile *trace)
 {
     printf("\n** PIPELINE IS %d WIDE **\n\n", PIPE_WIDTH);
 
@@ -98,8 +177,38 @@ Pipeline *pipe_init(int trace_fd)
     Pipeline *p = (Pipeline *)calloc(1, sizeof(Pipeline));
 
     // Initialize pipeline.
-    p->trace_fd = trace_fd;
+    p->trace = trace;
     p->halt_op_id = (uint64_t)(-1) - 3;
+    for (unsigned int i = 0; i < NUM_LATCH_TYPES; i++)
+    {
+        p->pipe_latch[i] =
+            (PipelineLatch *)calloc(PIPE_WIDTH, sizeof(PipelineLatch));
+    }
+    uint32_t num_ops = 1;
+    while (num_ops <= NUM_LATCH_TYPES * PIPE_WIDTH)
+    {
+        num_ops *= 2;
+    }
+    p->ops = (PipelineOp *)calloc(num_ops, sizeof(PipelineOp));
+    p->ops_mask = num_ops - 1;
+
+    // Allocate the scoreboard, empty.
+    Scoreboard *sb = &p->scoreboard;
+    for (unsigned int i = 0; i <= SCOREBOARD_CC; i++)
+    {
+        sb->heads[i] = -1;
+    }
+    sb->entries = (ScoreboardEntry *)calloc(2 * (NUM_LATCH_TYPES - 1) *
+                                                PIPE_WIDTH,
+                                            sizeof(ScoreboardEntry));
+    for (unsigned int i = ID_LATCH; i <= MA_LATCH; i++)
+    {
+        sb->refs[i] = (uint8_t *)calloc(num_ops, sizeof(uint8_t));
+        sb->valid_refs[i] = (uint8_t *)calloc(num_ops, sizeof(uint8_t));
+    }
+    sb->stall_op_id = (uint64_t *)calloc(PIPE_WIDTH, sizeof(uint64_t));
+    sb->lane_hits = (uint8_t *)calloc(PIPE_WIDTH, sizeof(uint8_t));
+    sb->hit_lanes = (uint32_t *)calloc(PIPE_WIDTH, sizeof(uint32_t));
 
     // Allocate and initialize a branch predictor if needed.
     if (BPRED_POLICY != BPRED_PERFECT)
@@ -107,6 +216,16 @@ Pipeline *pipe_init(int trace_fd)
         p->b_pred = new BPred(BPRED_POLICY);
     }
 
+    // Allocate the BTB and RAS if targets aren't predicted perfectly.
+    if (BTB_ENTRIES > 0)
+    {
+        p->btb = btb_new(BTB_ENTRIES, BTB_WAYS, BTB_REPL);
+        if (RAS_ENTRIES > 0)
+        {
+            p->ras = ras_new(RAS_ENTRIES);
+        }
+    }
+
     return p;
 }
 
@@ -152,8 +271,8 @@ void pipe_print_state(Pipeline *p)
         {
             if (p->pipe_latch[latch_type][i].valid)
             {
-                printf(" %6lu ",
-                       (unsigned long)p->pipe_latch[latch_type][i].op_id);
+                printf(" %6lu ", (unsigned long)pipe_op(
+                                     p, &p->pipe_latch[latch_type][i])->op_id);
             }
             else
             {
@@ -169,30 +288,31 @@ void pipe_print_state(Pipeline *p)
         {
             if (p->pipe_latch[latch_type][i].valid)
             {
-                int dest = (p->pipe_latch[latch_type][i].trace_rec.dest_needed) ? 
-                        p->pipe_latch[latch_type][i].trace_rec.dest_reg : -1;
-                int src1 = (p->pipe_latch[latch_type][i].trace_rec.src1_needed) ? 
-                        p->pipe_latch[latch_type][i].trace_rec.src1_reg : -1;
-                int src2 = (p->pipe_latch[latch_type][i].trace_rec.src2_needed) ? 
-                        p->pipe_latch[latch_type][i].trace_rec.src2_reg : -1;
-                int cc_read = p->pipe_latch[latch_type][i].trace_rec.cc_read;
-                int cc_write = p->pipe_latch[latch_type][i].trace_rec.cc_write;
-                int br_dir = p->pipe_latch[latch_type][i].trace_rec.br_dir;
+                const PipelineOp *op = pipe_op(p, &p->pipe_latch[latch_type][i]);
+                int dest = (op->trace_rec.dest_needed) ? 
+                        op->trace_rec.dest_reg : -1;
+                int src1 = (op->trace_rec.src1_needed) ? 
+                        op->trace_rec.src1_reg : -1;
+                int src2 = (op->trace_rec.src2_needed) ? 
+                        op->trace_rec.src2_reg : -1;
+                int cc_read = op->trace_rec.cc_read;
+                int cc_write = op->trace_rec.cc_write;
+                int br_dir = op->trace_rec.br_dir;
 
                 const char *op_type;
-                if (p->pipe_latch[latch_type][i].trace_rec.op_type == OP_ALU)
+                if (op->trace_rec.op_type == OP_ALU)
                     op_type = "ALU";
-                else if (p->pipe_latch[latch_type][i].trace_rec.op_type == OP_LD)
+                else if (op->trace_rec.op_type == OP_LD)
                     op_type = "LD";
-                else if (p->pipe_latch[latch_type][i].trace_rec.op_type == OP_ST)
+                else if (op->trace_rec.op_type == OP_ST)
                     op_type = "ST";
-                else if (p->pipe_latch[latch_type][i].trace_rec.op_type == OP_CBR)
+                else if (op->trace_rec.op_type == OP_CBR)
                     op_type = "BR";
                 else
                     op_type = "OTHER";
 
                 printf("(%lu : %s) dest: %d, src1: %d, src2: %d , ccread: %d, ccwrite: %d, br_dir: %d\n",
-                       (unsigned long)p->pipe_latch[latch_type][i].op_id,
+                       (unsigned long)op->op_id,
                        op_type,
                        dest,
                        src1,
@@ -209,8 +329,6 @@ void pipe_print_state(Pipeline *p)
         printf("\n");
     }
 }
-std::vector<uint64_t>track_id(PIPE_WIDTH);
-std::vector<uint64_t>last_stall(PIPE_WIDTH);
 /**
  * Simulate one cycle of all stages of a pipeline.
  * 
@@ -270,12 +388,13 @@ void pipe_cycle_WB(Pipeline *p)
     {
         if (p->pipe_latch[MA_LATCH][i].valid)
         {
-            if(p->pipe_latch[MA_LATCH][i].is_mispred_cbr){
+            if(p->pipe_latch[MA_LATCH][i].is_mispred_cbr ||
+               p->pipe_latch[MA_LATCH][i].is_mispred_target){
                 p->fetch_cbr_stall = false;
             }
             p->stat_retired_inst++;
 
-            if (p->pipe_latch[MA_LATCH][i].op_id >= p->halt_op_id)
+            if (pipe_op(p, &p->pipe_latch[MA_LATCH][i])->op_id >= p->halt_op_id)
             {
                 // Halt the pipeline if we've reached the end of the trace.
                 p->halt = true;
@@ -283,7 +402,7 @@ void pipe_cycle_WB(Pipeline *p)
         }
         #ifdef DEBUG
                 if(p->pipe_latch[MA_LATCH][i].valid){   
-                    printf("Retiring I%lu!\n", p->pipe_latch[MA_LATCH][i].op_id);
+                    printf("Retiring I%lu!\n", pipe_op(p, &p->pipe_latch[MA_LATCH][i])->op_id);
                 }
                 else{
                     printf("Retiring NOP!\n");
@@ -308,7 +427,7 @@ void pipe_cycle_MA(Pipeline *p)
         p->pipe_latch[MA_LATCH][i] = p->pipe_latch[EX_LATCH][i];
         #ifdef DEBUG
             if(p->pipe_latch[MA_LATCH][i].valid){
-                printf("Moving I%lu from EX to MA...\n", p->pipe_latch[MA_LATCH][i].op_id);
+                printf("Moving I%lu from EX to MA...\n", pipe_op(p, &p->pipe_latch[MA_LATCH][i])->op_id);
             }
             else{
                 printf("Moving NOP from EX to MA...\n");
@@ -334,11 +453,385 @@ void pipe_cycle_EX(Pipeline *p)
             p->pipe_latch[EX_LATCH][i].valid = false;
        }
        #ifdef DEBUG
-            printf("Moving I%lu from ID to EX...\n", p->pipe_latch[EX_LATCH][i].op_id);
+            printf("Moving I%lu from ID to EX...\n", pipe_op(p, &p->pipe_latch[EX_LATCH][i])->op_id);
         #endif
     }
 }
 
+/**
+ * Get the op_id of the operation in a pipeline latch, which for a bubble is
+ * that of the operation it was copied from.
+ */
+static inline uint64_t pipe_latch_op_id(const Pipeline *p, LatchType type,
+                                        unsigned int i)
+{
+    return pipe_op(p, &p->pipe_latch[type][i])->op_id;
+}
+
+/**
+ * Count the latches of each type referring to each entry of Pipeline::ops,
+ * the first time this cycle that an operation is looked up by op_id.
+ * 
+ * @param p the pipeline
+ */
+static void pipe_scoreboard_count_refs(Pipeline *p)
+{
+    Scoreboard *sb = &p->scoreboard;
+    if (sb->refs_counted)
+    {
+        return;
+    }
+    sb->refs_counted = true;
+
+    for (int type = ID_LATCH; type <= MA_LATCH; type++)
+    {
+        for (unsigned int lane = 0; lane < PIPE_WIDTH; lane++)
+        {
+            const PipelineLatch *latch = &p->pipe_latch[type][lane];
+            if (pipe_op(p, latch)->op_id == 0)
+            {
+                sb->zero_refs[type]++;
+                sb->zero_valid_refs[type] += latch->valid;
+            }
+            else
+            {
+                sb->refs[type][latch->op]++;
+                sb->valid_refs[type][latch->op] += latch->valid;
+            }
+        }
+    }
+}
+
+/**
+ * Check whether any latch of a type holds the operation with a given op_id.
+ * 
+ * @param p the pipeline
+ * @param type the type of latch to look in
+ * @param op_id the op_id to look for
+ * @param valid_only whether to leave out bubbles
+ * @param load_only whether to look only for a load
+ * @return whether such a latch holds the operation
+ */
+static bool pipe_scoreboard_holds(Pipeline *p, LatchType type,
+                                  uint64_t op_id, bool valid_only,
+                                  bool load_only)
+{
+    pipe_scoreboard_count_refs(p);
+    const Scoreboard *sb = &p->scoreboard;
+    if (op_id == 0)
+    {
+        // An entry never fetched into has no trace record, so no load.
+        uint32_t refs = valid_only ? sb->zero_valid_refs[type]
+                                   : sb->zero_refs[type];
+        return refs > 0 && !load_only;
+    }
+
+    // Only the entry at op_id & ops_mask can have this op_id.
+    uint32_t index = (uint32_t)(op_id & p->ops_mask);
+    const PipelineOp *op = &p->ops[index];
+    uint8_t refs = valid_only ? sb->valid_refs[type][index]
+                              : sb->refs[type][index];
+    return refs > 0 && op->op_id == op_id &&
+           (!load_only || op->trace_rec.op_type == OP_LD);
+}
+
+/**
+ * Check whether an operation that an instruction stalled on still holds up
+ * the younger instructions behind it: it is in the EX latch with no
+ * forwarding from EX, or is a load there; it is in the MA latch with no
+ * forwarding from MA; or, with both, it is still in the ID latch.
+ * 
+ * @param p the pipeline
+ * @param op_id the op_id of the operation
+ * @param check_id whether to look in the ID latches too
+ * @return whether the operation holds up younger instructions
+ */
+static bool pipe_scoreboard_holds_up(Pipeline *p, uint64_t op_id,
+                                     bool check_id)
+{
+    return pipe_scoreboard_holds(p, EX_LATCH, op_id, false, ENABLE_EXE_FWD) ||
+           (!ENABLE_MEM_FWD &&
+            pipe_scoreboard_holds(p, MA_LATCH, op_id, false, false)) ||
+           (check_id && ENABLE_EXE_FWD && ENABLE_MEM_FWD &&
+            pipe_scoreboard_holds(p, ID_LATCH, op_id, false, false));
+}
+
+/**
+ * Record in the scoreboard whether the instruction in a lane's ID latch is
+ * stalled on an operation that holds up younger instructions.
+ * 
+ * @param p the pipeline
+ * @param lane the lane
+ */
+static void pipe_scoreboard_mark_lane(Pipeline *p, unsigned int lane)
+{
+    Scoreboard *sb = &p->scoreboard;
+    const PipelineLatch *latch = &p->pipe_latch[ID_LATCH][lane];
+    uint64_t bit = (uint64_t)1 << lane;
+    sb->held_lanes &= ~bit;
+    sb->held_valid_lanes &= ~bit;
+    if (!latch->stall)
+    {
+        return;
+    }
+
+    uint64_t op_id = sb->stall_op_id[lane];
+    if (pipe_scoreboard_holds_up(p, op_id, true))
+    {
+        sb->held_lanes |= bit;
+    }
+    if (latch->valid && pipe_scoreboard_holds_up(p, op_id, false))
+    {
+        sb->held_valid_lanes |= bit;
+    }
+}
+
+/**
+ * Find the last of a set of lanes whose ID instruction is older than a given
+ * instruction.
+ * 
+ * @param p the pipeline
+ * @param lanes the lanes, one bit per lane
+ * @param op_id the op_id of the instruction
+ * @return the lane, or -1 if there is none
+ */
+static int pipe_scoreboard_last_older(const Pipeline *p, uint64_t lanes,
+                                      uint64_t op_id)
+{
+    while (lanes != 0)
+    {
+        int lane = 63 - __builtin_clzll(lanes);
+        if (pipe_latch_op_id(p, ID_LATCH, lane) < op_id)
+        {
+            return lane;
+        }
+        lanes &= ~((uint64_t)1 << lane);
+    }
+    return -1;
+}
+
+/**
+ * Add an operation that writes a register or the condition code to the
+ * scoreboard.
+ * 
+ * @param p the pipeline
+ * @param key the register, or SCOREBOARD_CC
+ * @param lane the lane of the latch holding the operation
+ * @param type the latch holding the operation
+ */
+static void pipe_scoreboard_add(Pipeline *p, uint32_t key, unsigned int lane,
+                                LatchType type)
+{
+    Scoreboard *sb = &p->scoreboard;
+    ScoreboardEntry *entry = &sb->entries[sb->num_entries];
+    entry->key = key;
+    entry->lane = lane;
+    entry->latch = type;
+    entry->next = sb->heads[key];
+    sb->heads[key] = (int32_t)sb->num_entries++;
+}
+
+/**
+ * Fill the scoreboard from the ID, EX, and MA latches.
+ * 
+ * @param p the pipeline
+ */
+static void pipe_scoreboard_build(Pipeline *p)
+{
+    for (unsigned int lane = 0; lane < PIPE_WIDTH; lane++)
+    {
+        // Only a lane decoding an instruction is checked.
+        if (!p->pipe_latch[ID_LATCH][lane].valid)
+        {
+            continue;
+        }
+
+        // MA is only checked without forwarding from it.
+        int last_type = ENABLE_MEM_FWD ? EX_LATCH : MA_LATCH;
+        for (int type = ID_LATCH; type <= last_type; type++)
+        {
+            const PipelineLatch *latch = &p->pipe_latch[type][lane];
+            const TraceRec *rec = &pipe_op(p, latch)->trace_rec;
+            if (!rec->cc_write)
+            {
+                continue;
+            }
+            pipe_scoreboard_add(p, SCOREBOARD_CC, lane, (LatchType)type);
+            if (rec->dest_needed)
+            {
+                pipe_scoreboard_add(p, rec->dest_reg, lane, (LatchType)type);
+            }
+        }
+    }
+
+    for (unsigned int lane = 0; lane < PIPE_WIDTH; lane++)
+    {
+        pipe_scoreboard_mark_lane(p, lane);
+    }
+}
+
+/**
+ * Empty the scoreboard once the ID stage is done with it. The latches haven't
+ * moved since it was built, so they say which counts to clear.
+ * 
+ * @param p the pipeline
+ */
+static void pipe_scoreboard_clear(Pipeline *p)
+{
+    Scoreboard *sb = &p->scoreboard;
+    for (uint32_t i = 0; i < sb->num_entries; i++)
+    {
+        sb->heads[sb->entries[i].key] = -1;
+    }
+    sb->num_entries = 0;
+
+    if (!sb->refs_counted)
+    {
+        return;
+    }
+    sb->refs_counted = false;
+    for (int type = ID_LATCH; type <= MA_LATCH; type++)
+    {
+        for (unsigned int lane = 0; lane < PIPE_WIDTH; lane++)
+        {
+            uint32_t index = p->pipe_latch[type][lane].op;
+            sb->refs[type][index] = 0;
+            sb->valid_refs[type][index] = 0;
+        }
+        sb->zero_refs[type] = 0;
+        sb->zero_valid_refs[type] = 0;
+    }
+}
+
+/**
+ * Check whether an instruction stalled in the ID stage must stay stalled:
+ * the operation it stalled on still holds it up, or an older instruction is
+ * still stalled on one that does.
+ * 
+ * @param p the pipeline
+ * @param lane the lane of the instruction
+ * @return whether the instruction stays stalled
+ */
+static bool pipe_scoreboard_still_stalled(Pipeline *p, unsigned int lane)
+{
+    const Scoreboard *sb = &p->scoreboard;
+    uint64_t op_id = sb->stall_op_id[lane];
+    if (pipe_scoreboard_holds(p, EX_LATCH, op_id, true, ENABLE_EXE_FWD) ||
+        (!ENABLE_MEM_FWD &&
+         pipe_scoreboard_holds(p, MA_LATCH, op_id, false, false)) ||
+        (ENABLE_EXE_FWD && ENABLE_MEM_FWD &&
+         pipe_scoreboard_holds(p, ID_LATCH, op_id, true, false)))
+    {
+        return true;
+    }
+    return pipe_scoreboard_last_older(p, sb->held_lanes,
+                                      pipe_latch_op_id(p, ID_LATCH, lane)) != -1;
+}
+
+/**
+ * Check whether an instruction just decoded must stall, and remember the
+ * youngest operation it waits on.
+ * 
+ * The lanes that write what it reads are visited in order, as the ID stage
+ * always has: the last one decides, taking back the stall if the operation
+ * can be forwarded from EX and is younger than any stalled on so far. An
+ * older instruction held up in a later lane stalls it too.
+ * 
+ * @param p the pipeline
+ * @param lane the lane of the instruction
+ * @return whether the instruction stalls
+ */
+static bool pipe_scoreboard_stalls(Pipeline *p, unsigned int lane)
+{
+    Scoreboard *sb = &p->scoreboard;
+    const PipelineOp *curr = pipe_op(p, &p->pipe_latch[ID_LATCH][lane]);
+    const TraceRec *rec = &curr->trace_rec;
+
+    // A register is only checked for an instruction that writes the
+    // condition code or accesses memory.
+    uint32_t keys[3];
+    unsigned int num_keys = 0;
+    if (rec->cc_read)
+    {
+        keys[num_keys++] = SCOREBOARD_CC;
+    }
+    if (rec->cc_write || rec->mem_addr)
+    {
+        if (rec->src1_needed)
+        {
+            keys[num_keys++] = rec->src1_reg;
+        }
+        if (rec->src2_needed)
+        {
+            keys[num_keys++] = rec->src2_reg;
+        }
+    }
+
+    uint32_t num_hit_lanes = 0;
+    for (unsigned int k = 0; k < num_keys; k++)
+    {
+        for (int32_t e = sb->heads[keys[k]]; e != -1; e = sb->entries[e].next)
+        {
+            const ScoreboardEntry *entry = &sb->entries[e];
+            if (entry->latch == ID_LATCH &&
+                pipe_latch_op_id(p, ID_LATCH, entry->lane) >= curr->op_id)
+            {
+                continue; // Not older than this instruction.
+            }
+            if (sb->lane_hits[entry->lane] == 0)
+            {
+                // Keep the lanes in increasing order.
+                uint32_t i = num_hit_lanes++;
+                while (i > 0 && sb->hit_lanes[i - 1] > entry->lane)
+                {
+                    sb->hit_lanes[i] = sb->hit_lanes[i - 1];
+                    i--;
+                }
+                sb->hit_lanes[i] = entry->lane;
+            }
+            sb->lane_hits[entry->lane] |= 1 << entry->latch;
+        }
+    }
+
+    bool stall = false;
+    int last_lane = -1;
+    uint64_t stall_op_id = sb->stall_op_id[lane];
+    for (uint32_t i = 0; i < num_hit_lanes; i++)
+    {
+        uint32_t hit_lane = sb->hit_lanes[i];
+        uint8_t hits = sb->lane_hits[hit_lane];
+        sb->lane_hits[hit_lane] = 0;
+
+        // The ID latch is checked last, then EX, then MA.
+        LatchType type = (hits & (1 << ID_LATCH))   ? ID_LATCH
+                         : (hits & (1 << EX_LATCH)) ? EX_LATCH
+                                                    : MA_LATCH;
+        const PipelineOp *producer =
+            pipe_op(p, &p->pipe_latch[type][hit_lane]);
+        stall = !(type == EX_LATCH && ENABLE_EXE_FWD &&
+                  producer->trace_rec.op_type != OP_LD &&
+                  producer->op_id > stall_op_id);
+        if (producer->op_id > stall_op_id)
+        {
+            stall_op_id = producer->op_id;
+        }
+        last_lane = (int)hit_lane;
+    }
+    sb->stall_op_id[lane] = stall_op_id;
+
+    uint64_t later_lanes = ~(uint64_t)0;
+    if (last_lane != -1)
+    {
+        later_lanes = ~(((uint64_t)2 << last_lane) - 1);
+    }
+    if (pipe_scoreboard_last_older(p, sb->held_valid_lanes & later_lanes,
+                                   curr->op_id) != -1)
+    {
+        stall = true;
+    }
+    return stall;
+}
+
 /**
  * Simulate one cycle of the Instruction Decode stage (ID) of a pipeline.
  * 
@@ -353,172 +846,67 @@ void pipe_cycle_ID(Pipeline *p)
         // Copy each instruction from the IF latch to the ID latch.
         p->pipe_latch[ID_LATCH][i] = p->pipe_latch[IF_LATCH][i];
     }
+
+    pipe_scoreboard_build(p);
     for (unsigned int i = 0; i < PIPE_WIDTH; i++)
     {
-        PipelineLatch currInst = p->pipe_latch[ID_LATCH][i];
-        uint64_t temp_id = 0;
-        if(currInst.stall){
-            p->pipe_latch[ID_LATCH][i].stall = false;
-            for(unsigned int j = 0; j < PIPE_WIDTH; j++){
-                if(p->pipe_latch[ID_LATCH][j].op_id < currInst.op_id && p->pipe_latch[ID_LATCH][j].stall){
-                    for(unsigned int k = 0; k < PIPE_WIDTH;k++){
-                        if(p->pipe_latch[EX_LATCH][k].op_id == track_id[j]){
-                            if(!ENABLE_EXE_FWD){
-                                p->pipe_latch[ID_LATCH][i].stall = true;
-                            }
-                            else {
-                                if(p->pipe_latch[EX_LATCH][k].trace_rec.op_type == OP_LD){
-                                    p->pipe_latch[ID_LATCH][i].stall = true;
-                                }
-                            }
-                        }
-                        if(p->pipe_latch[MA_LATCH][k].op_id == track_id[j] && !ENABLE_MEM_FWD){
-                            p->pipe_latch[ID_LATCH][i].stall = true;
-                        }
-                        if(p->pipe_latch[ID_LATCH][k].op_id == track_id[j] && ENABLE_EXE_FWD && ENABLE_MEM_FWD){
-                            p->pipe_latch[ID_LATCH][i].stall = true;
-                        }
-                    }
-                }
-                if(p->pipe_latch[EX_LATCH][j].op_id == track_id[i] && p->pipe_latch[EX_LATCH][j].valid){
-                    if(!ENABLE_EXE_FWD){
-                        p->pipe_latch[ID_LATCH][i].stall = true;
-                    }
-                    else {
-                        if(p->pipe_latch[EX_LATCH][j].trace_rec.op_type == OP_LD ){
-                            p->pipe_latch[ID_LATCH][i].stall = true;
-                        }
-                    }
-                }
-                if( p->pipe_latch[MA_LATCH][j].op_id == track_id[i] && !ENABLE_MEM_FWD){
-                    p->pipe_latch[ID_LATCH][i].stall = true;
-                }
-                if(p->pipe_latch[ID_LATCH][j].op_id == track_id[i] && p->pipe_latch[ID_LATCH][j].valid && ENABLE_EXE_FWD && ENABLE_MEM_FWD){
-                    p->pipe_latch[ID_LATCH][i].stall = true;
-                }
-            }
+        PipelineLatch *curr_latch = &p->pipe_latch[ID_LATCH][i];
+        bool was_stalled = curr_latch->stall;
+        if (was_stalled)
+        {
+            curr_latch->stall = pipe_scoreboard_still_stalled(p, i);
         }
-        else{
-            
-            for (unsigned int j = 0; j < PIPE_WIDTH; j++){
-                if(!p->pipe_latch[ID_LATCH][i].valid || !p->pipe_latch[ID_LATCH][j].valid){
-                    continue;
-                }
-                if(p->pipe_latch[ID_LATCH][j].op_id < currInst.op_id && p->pipe_latch[ID_LATCH][j].stall){
-                    for(unsigned int k = 0; k < PIPE_WIDTH;k++){
-                        if(p->pipe_latch[EX_LATCH][k].op_id == track_id[j]){
-                            if(!ENABLE_EXE_FWD){
-                                p->pipe_latch[ID_LATCH][i].stall = true;
-                            }
-                            else {
-                                if(p->pipe_latch[EX_LATCH][k].trace_rec.op_type == OP_LD){
-                                    p->pipe_latch[ID_LATCH][i].stall = true;
-                                }
-                            }
-                        }
-                        if(p->pipe_latch[MA_LATCH][k].op_id == track_id[j] && !ENABLE_MEM_FWD){
-                            p->pipe_latch[ID_LATCH][i].stall = true;
-                        }
-                    }
-                }
-                if(p->pipe_latch[MA_LATCH][j].trace_rec.cc_write && !ENABLE_MEM_FWD){
-                    if(currInst.trace_rec.cc_read){
-                        p->pipe_latch[ID_LATCH][i].stall = true;
-                        temp_id = p->pipe_latch[MA_LATCH][j].op_id;
-                    }
-                }
-                if(p->pipe_latch[MA_LATCH][j].trace_rec.cc_write && p->pipe_latch[MA_LATCH][j].trace_rec.dest_needed && !ENABLE_MEM_FWD){
-                    if((currInst.trace_rec.cc_write || currInst.trace_rec.mem_addr) && currInst.trace_rec.src1_needed){
-                        if(currInst.trace_rec.src1_reg == p->pipe_latch[MA_LATCH][j].trace_rec.dest_reg){
-                            p->pipe_latch[ID_LATCH][i].stall = true;
-                            temp_id = p->pipe_latch[MA_LATCH][j].op_id;
-                        }
-                    }
-                    if((currInst.trace_rec.cc_write || currInst.trace_rec.mem_addr) && currInst.trace_rec.src2_needed){
-                        if(currInst.trace_rec.src2_reg == p->pipe_latch[MA_LATCH][j].trace_rec.dest_reg){
-                            p->pipe_latch[ID_LATCH][i].stall = true;
-                            temp_id = p->pipe_latch[MA_LATCH][j].op_id;
-                        }
-                    }
-                }
-                if(p->pipe_latch[EX_LATCH][j].trace_rec.cc_write){
-                    if(currInst.trace_rec.cc_read){
-                        if(!ENABLE_EXE_FWD){
-                            p->pipe_latch[ID_LATCH][i].stall = true;
-                            temp_id = p->pipe_latch[EX_LATCH][j].op_id;
-                        }
-                        else {
-                            p->pipe_latch[ID_LATCH][i].stall = true;
-                            if(p->pipe_latch[EX_LATCH][j].trace_rec.op_type != OP_LD && p->pipe_latch[EX_LATCH][j].op_id > track_id[i]){
-                                p->pipe_latch[ID_LATCH][i].stall = false;
-                            }
-                            temp_id = p->pipe_latch[EX_LATCH][j].op_id;
-                        }
-                    }
-                }
-                if(p->pipe_latch[EX_LATCH][j].trace_rec.cc_write && p->pipe_latch[EX_LATCH][j].trace_rec.dest_needed){
-                    if((currInst.trace_rec.cc_write || currInst.trace_rec.mem_addr)&& currInst.trace_rec.src1_needed){
-                        if(currInst.trace_rec.src1_reg == p->pipe_latch[EX_LATCH][j].trace_rec.dest_reg){
-                            if(!ENABLE_EXE_FWD){
-                                p->pipe_latch[ID_LATCH][i].stall = true;
-                                temp_id = p->pipe_latch[EX_LATCH][j].op_id;
-                            }
-                            else {
-                                p->pipe_latch[ID_LATCH][i].stall = true;
-                                if(p->pipe_latch[EX_LATCH][j].trace_rec.op_type != OP_LD && p->pipe_latch[EX_LATCH][j].op_id > track_id[i]){
-                                    p->pipe_latch[ID_LATCH][i].stall = false;
-                                }
-                                temp_id = p->pipe_latch[EX_LATCH][j].op_id;
-                            }
-                        }
-                    }
-                    if((currInst.trace_rec.cc_write || currInst.trace_rec.mem_addr) && currInst.trace_rec.src2_needed){
-                        if(currInst.trace_rec.src2_reg == p->pipe_latch[EX_LATCH][j].trace_rec.dest_reg){
-                            if(!ENABLE_EXE_FWD){
-                                p->pipe_latch[ID_LATCH][i].stall = true;
-                                temp_id = p->pipe_latch[EX_LATCH][j].op_id;
-                            }
-                            else {
-                                p->pipe_latch[ID_LATCH][i].stall = true;
-                                if(p->pipe_latch[EX_LATCH][j].trace_rec.op_type != OP_LD && p->pipe_latch[EX_LATCH][j].op_id > track_id[i]){
-                                    p->pipe_latch[ID_LATCH][i].stall = false;
-                                }
-                                temp_id = p->pipe_latch[EX_LATCH][j].op_id;
-                            }
-                        }
-                    }
-                }
-                if(currInst.op_id > p->pipe_latch[ID_LATCH][j].op_id){
-                    if(p->pipe_latch[ID_LATCH][j].trace_rec.cc_write){
-                        if(currInst.trace_rec.cc_read ){
-                            p->pipe_latch[ID_LATCH][i].stall = true;
-                            temp_id = p->pipe_latch[ID_LATCH][j].op_id;
-                        }
-                    }
-                    if(p->pipe_latch[ID_LATCH][j].trace_rec.cc_write && p->pipe_latch[ID_LATCH][j].trace_rec.dest_needed){
-                        if((currInst.trace_rec.cc_write || currInst.trace_rec.mem_addr)&& currInst.trace_rec.src1_needed){
-                            if(currInst.trace_rec.src1_reg == p->pipe_latch[ID_LATCH][j].trace_rec.dest_reg){
-                                p->pipe_latch[ID_LATCH][i].stall = true;
-                                temp_id = p->pipe_latch[ID_LATCH][j].op_id;
-                            }
-                        }
-                        if((currInst.trace_rec.cc_write || currInst.trace_rec.mem_addr) && currInst.trace_rec.src2_needed){
-                            if(currInst.trace_rec.src2_reg == p->pipe_latch[ID_LATCH][j].trace_rec.dest_reg){
-                                p->pipe_latch[ID_LATCH][i].stall = true;
-                                temp_id = p->pipe_latch[ID_LATCH][j].op_id;
-                            }
-                        }
-                    }
-                }
-                if(temp_id > track_id[i]){
-                    track_id[i] = temp_id;
-                } 
-            }
+        else if (curr_latch->valid)
+        {
+            curr_latch->stall = pipe_scoreboard_stalls(p, i);
+        }
+
+        // A lane staying stalled keeps its operation, so only a change of
+        // stall needs the lane marked again.
+        if (curr_latch->stall != was_stalled)
+        {
+            pipe_scoreboard_mark_lane(p, i);
         }
         #ifdef DEBUG
-            printf("Moving I%lu from IF to ID...\n", p->pipe_latch[ID_LATCH][i].op_id);
+            printf("Moving I%lu from IF to ID...\n",
+                   (unsigned long)pipe_op(p, curr_latch)->op_id);
         #endif
     }
+    pipe_scoreboard_clear(p);
+}
+
+/**
+ * If the next instruction to be fetched is the first one measured of a window,
+ * reset the statistics kept at fetch, so that they leave out warm-up. The
+ * statistics of a list of simulation points cover the whole run.
+ * 
+ * @param p the pipeline
+ */
+static void pipe_check_warmup(Pipeline *p)
+{
+    if (p->simpoints == NULL ||
+        !simpoints_fetch(p->simpoints, p->last_op_id) ||
+        p->simpoints->interval_size > 0)
+    {
+        return;
+    }
+
+    if (p->b_pred != NULL)
+    {
+        p->b_pred->stat_num_branches = 0;
+        p->b_pred->stat_num_mispred = 0;
+    }
+    if (p->btb != NULL)
+    {
+        p->btb->stat_lookups = 0;
+        p->btb->stat_hits = 0;
+        p->btb->stat_mispred = 0;
+    }
+    if (p->ras != NULL)
+    {
+        p->ras->stat_returns = 0;
+        p->ras->stat_mispred = 0;
+    }
 }
 
 /**
@@ -537,10 +925,11 @@ void pipe_cycle_IF(Pipeline *p)
             if(!p->fetch_cbr_stall){
                 // Read an instruction from the trace file.
                 PipelineLatch fetch_op;
+                pipe_check_warmup(p);
                 pipe_get_fetch_op(p, &fetch_op);
 
                 // Handle branch (mis)prediction.
-                if (BPRED_POLICY != BPRED_PERFECT)
+                if (p->b_pred != NULL || p->btb != NULL)
                 {
                     pipe_check_bpred(p, &fetch_op);
                 }
@@ -558,21 +947,94 @@ void pipe_cycle_IF(Pipeline *p)
         
         #ifdef DEBUG
             if(!p->pipe_latch[ID_LATCH][i].stall){
-                printf("Fetching %lu!\n", p->pipe_latch[IF_LATCH][i].op_id);
+                printf("Fetching %lu!\n", pipe_op(p, &p->pipe_latch[IF_LATCH][i])->op_id);
             }
             else{
-                printf("Stalling P%d's IF because I%lu is stalled in ID!\n",i,p->pipe_latch[ID_LATCH][i].op_id);
+                printf("Stalling P%d's IF because I%lu is stalled in ID!\n",i,pipe_op(p, &p->pipe_latch[ID_LATCH][i])->op_id);
             }
-            //printf("tracked ID: %lu\n", track_id[i]);
+            //printf("tracked ID: %lu\n", p->scoreboard.stall_op_id[i]);
         #endif
         
     }
 }
 
+/**
+ * Check the BTB's target for a taken branch, jump, or call, stalling the IF
+ * stage if fetch would have gone the wrong way, and update the BTB.
+ * 
+ * @param p the pipeline
+ * @param fetch_op the pipeline latch containing the operation fetched
+ * @param target the address the operation jumped to
+ * @param predicted_taken whether fetch was to follow the BTB; if not, a
+ *                        mispredicted direction has already stalled it
+ */
+static void pipe_check_btb(Pipeline *p, PipelineLatch *fetch_op,
+                           uint64_t target, bool predicted_taken)
+{
+    uint64_t pc = pipe_op(p, fetch_op)->trace_rec.inst_addr;
+    uint64_t predicted_target;
+    bool hit = btb_lookup(p->btb, pc, &predicted_target);
+    if (predicted_taken && (!hit || predicted_target != target))
+    {
+        p->btb->stat_mispred++;
+        fetch_op->is_mispred_target = true;
+        p->fetch_cbr_stall = true;
+    }
+    btb_update(p->btb, pc, target);
+}
+
+/**
+ * If the instruction just fetched is not a conditional branch but jumped, as
+ * told by where the next instruction is, check the target the BTB or RAS
+ * gives for it.
+ * 
+ * @param p the pipeline
+ * @param fetch_op the pipeline latch containing the operation fetched
+ */
+static void pipe_check_jump(Pipeline *p, PipelineLatch *fetch_op)
+{
+    const TraceRec *trace_rec = &pipe_op(p, fetch_op)->trace_rec;
+    uint64_t pc = trace_rec->inst_addr;
+    uint64_t target;
+    if (!pipe_peek_next_pc(p, &target) ||
+        (target > pc && target - pc <= BTB_MAX_INST_BYTES))
+    {
+        return;
+    }
+
+    if (trace_rec->mem_write)
+    {
+        // A call pushes its return address.
+        if (p->ras != NULL)
+        {
+            ras_push(p->ras, pc);
+        }
+        pipe_check_btb(p, fetch_op, target, true);
+    }
+    else if (trace_rec->mem_read && p->ras != NULL)
+    {
+        // A return should go to the instruction after the newest call.
+        uint64_t call_pc;
+        p->ras->stat_returns++;
+        if (!ras_pop(p->ras, &call_pc) || target <= call_pc ||
+            target - call_pc > BTB_MAX_INST_BYTES)
+        {
+            p->ras->stat_mispred++;
+            fetch_op->is_mispred_target = true;
+            p->fetch_cbr_stall = true;
+        }
+    }
+    else
+    {
+        pipe_check_btb(p, fetch_op, target, true);
+    }
+}
+
 /**
  * If the instruction just fetched is a conditional branch, check for a branch
  * misprediction, update the branch predictor, and set appropriate flags in the
- * pipeline.
+ * pipeline. If the BTB is modeled, do the same for the target of any taken
+ * branch, jump, call, or return.
  * 
  * You must implement this function in part B of the lab.
  * 
@@ -585,15 +1047,28 @@ void pipe_check_bpred(Pipeline *p, PipelineLatch *fetch_op)
     // branch predictor.
     BranchDirection prediction;
     BranchDirection resolution;
-    uint64_t pc = fetch_op->trace_rec.inst_addr;
-    if(fetch_op->trace_rec.op_type == OP_CBR){
-        prediction = p->b_pred->predict(fetch_op->trace_rec.inst_addr);
-        resolution = static_cast<BranchDirection>(fetch_op->trace_rec.br_dir);
-        p->b_pred->update(pc,prediction,resolution);
-        if(prediction != resolution){
-            fetch_op->is_mispred_cbr = true;
-            p->fetch_cbr_stall = true;
+    const TraceRec *trace_rec = &pipe_op(p, fetch_op)->trace_rec;
+    uint64_t pc = trace_rec->inst_addr;
+    // Past the end of the trace, the trace record is garbage.
+    if(fetch_op->valid && trace_rec->op_type == OP_CBR){
+        resolution = static_cast<BranchDirection>(trace_rec->br_dir);
+        prediction = resolution;
+        if(p->b_pred != NULL){
+            prediction = p->b_pred->predict(trace_rec->inst_addr);
+            p->b_pred->update(pc,prediction,resolution);
+            if(prediction != resolution){
+                fetch_op->is_mispred_cbr = true;
+                p->fetch_cbr_stall = true;
+            }
         }
+        if(p->btb != NULL && resolution == TAKEN){
+            pipe_check_btb(p, fetch_op, trace_rec->br_target,
+                           prediction == TAKEN);
+        }
+    }
+    else if(fetch_op->valid && trace_rec->op_type == OP_OTHER &&
+            p->btb != NULL){
+        pipe_check_jump(p, fetch_op);
     }
 
     // TODO: If the branch predictor mispredicted, mark the fetch_op
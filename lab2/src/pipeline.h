@@ -12,16 +12,28 @@
 #define _PIPELINE_H_
 
 #include "trace.h"
+#include "tracefile.h"
+#include "simpoints.h"
 #include "bpred.h"
+#include "btb.h"
 #include <inttypes.h>
 
 /**
  * [Internal] The maximum allowed width of the pipeline.
  * 
- * This is an implementation detail that defines the array size of
- * Pipeline::pipe_latch; you should not have to use this value directly.
+ * Pipeline::pipe_latch is allocated to PIPE_WIDTH, so this only bounds the
+ * -pipewidth argument; you should not have to use this value directly.
  */
-#define MAX_PIPE_WIDTH 8
+#define MAX_PIPE_WIDTH 64
+
+/**
+ * [Internal] The number of trace records read from the trace file at a time.
+ * 
+ * Fetching then takes records from Pipeline::trace_buf instead of calling into
+ * the trace file for every instruction. Kept small enough that a read rarely
+ * straddles two of the trace file's own buffer fills, which costs a copy.
+ */
+#define PIPE_TRACE_BUF_RECS 256
 
 /**
  * The width of the pipeline; that is, the maximum number of instructions that
@@ -64,6 +76,37 @@ extern uint32_t ENABLE_EXE_FWD;
  */
 extern BPredPolicy BPRED_POLICY;
 
+/**
+ * An operation in flight in the pipeline, from the cycle it is fetched until
+ * it retires.
+ * 
+ * Operations live in Pipeline::ops, and pipeline latches refer to them by
+ * index, so that moving an operation from one stage to the next copies a
+ * latch rather than the whole trace record.
+ */
+typedef struct PipelineOpStruct
+{
+    /**
+     * A unique, monotonically increasing ID for this operation in the trace
+     * file.
+     * 
+     * Unlike the instruction's PC (trace_rec.inst_addr), this is guaranteed
+     * to be unique for each operation in the trace file.
+     * 
+     * Additionally, it is monotonically increasing, which allows it to be used
+     * for ordering operations: if A's op_id is less than B's op_id, then A was
+     * issued before B.
+     */
+    uint64_t op_id;
+
+    /**
+     * The trace record containing information about this instruction, such as
+     * what type of instruction it is, its address, what registers it reads and
+     * writes, and so on.
+     */
+    TraceRec trace_rec;
+} PipelineOp;
+
 /**
  * One of the latches in the pipeline. Each one of these can contain one
  * operation to be processed by the next pipeline stage.
@@ -82,19 +125,6 @@ typedef struct PipelineLatchStruct
      */
     bool valid;
 
-    /**
-     * A unique, monotonically increasing ID for this operation in the trace
-     * file.
-     * 
-     * Unlike the instruction's PC (trace_rec->inst_addr), this is guaranteed
-     * to be unique for each operation in the trace file.
-     * 
-     * Additionally, it is monotonically increasing, which allows it to be used
-     * for ordering operations: if A's op_id is less than B's op_id, then A was
-     * issued before B.
-     */
-    uint64_t op_id;
-
     /**
      * Should this operation be stalled?
      * 
@@ -105,13 +135,6 @@ typedef struct PipelineLatchStruct
      */
     bool stall;
 
-    /**
-     * The trace record containing information about this instruction, such as
-     * what type of instruction it is, its address, what registers it reads and
-     * writes, and so on.
-     */
-    TraceRec trace_rec;
-
     /**
      * Is this operation a conditional branch that the branch predictor
      * mispredicted?
@@ -122,6 +145,21 @@ typedef struct PipelineLatchStruct
      * This is only relevant for part B of the lab.
      */
     bool is_mispred_cbr;
+
+    /**
+     * [Internal] Is this operation a taken branch, jump, call, or return
+     * whose target the BTB or RAS mispredicted?
+     * 
+     * Like a mispredicted conditional branch, it stalls the IF stage until it
+     * retires.
+     */
+    bool is_mispred_target;
+
+    /**
+     * The index of this operation in Pipeline::ops. Use pipe_op() to get the
+     * operation itself.
+     */
+    uint32_t op;
 } PipelineLatch;
 
 /**
@@ -137,6 +175,100 @@ typedef enum LatchTypeEnum
     NUM_LATCH_TYPES
 } LatchType;
 
+/** [Internal] The number of architectural registers a trace record can name. */
+#define NUM_ARCH_REGS 256
+
+/**
+ * [Internal] The key of the condition code in Scoreboard::heads, after those
+ * of the registers.
+ */
+#define SCOREBOARD_CC NUM_ARCH_REGS
+
+/**
+ * [Internal] An entry of the scoreboard: an operation in the ID, EX, or MA
+ * latch of a lane that writes a register or the condition code, and so may
+ * hold up an instruction in the ID stage.
+ */
+typedef struct ScoreboardEntryStruct
+{
+    /** The register written, or SCOREBOARD_CC. */
+    uint32_t key;
+
+    /** The lane of the latch holding the operation. */
+    uint32_t lane;
+
+    /** The latch holding the operation: ID_LATCH, EX_LATCH, or MA_LATCH. */
+    LatchType latch;
+
+    /** The index of the next entry with the same key, or -1. */
+    int32_t next;
+} ScoreboardEntry;
+
+/**
+ * [Internal] The scoreboard of the ID stage, which finds the hazards of an
+ * instruction by looking up what it reads instead of scanning every latch.
+ * 
+ * It is rebuilt from the ID, EX, and MA latches at the start of each ID
+ * stage, since every latch moves on each cycle. Like the checks it replaces,
+ * it counts the operation a bubble was copied from as still in its latch,
+ * and leaves out the lanes whose ID latch holds a bubble.
+ */
+typedef struct ScoreboardStruct
+{
+    /**
+     * For each register, then the condition code, the index in entries of
+     * the last operation to write it, or -1.
+     */
+    int32_t heads[NUM_ARCH_REGS + 1];
+
+    /** The entries, at most two for each ID, EX, and MA latch. */
+    ScoreboardEntry *entries;
+    /** The number of entries in use. */
+    uint32_t num_entries;
+
+    /**
+     * Whether refs and the counts after it are up to date this cycle; they
+     * are only counted once an operation is looked up by op_id.
+     */
+    bool refs_counted;
+    /**
+     * For each latch type, the number of its latches referring to each entry
+     * of Pipeline::ops, to look operations up by op_id.
+     */
+    uint8_t *refs[NUM_LATCH_TYPES];
+    /** The same, counting only latches holding valid operations. */
+    uint8_t *valid_refs[NUM_LATCH_TYPES];
+    /**
+     * For each latch type, the number of its latches referring to an entry of
+     * Pipeline::ops never fetched into, whose op_id is 0.
+     */
+    uint32_t zero_refs[NUM_LATCH_TYPES];
+    /** The same, counting only latches holding valid operations. */
+    uint32_t zero_valid_refs[NUM_LATCH_TYPES];
+
+    /**
+     * For each lane, the op_id of the youngest operation the ID stage last
+     * stalled its instruction on.
+     */
+    uint64_t *stall_op_id;
+
+    /**
+     * The stalled lanes whose operation stalled on still holds up younger
+     * stalled instructions, counting ID latches too; one bit per lane.
+     */
+    uint64_t held_lanes;
+    /**
+     * The valid stalled lanes whose operation stalled on still holds up
+     * younger instructions being decoded; one bit per lane.
+     */
+    uint64_t held_valid_lanes;
+
+    /** For each lane, the latches found writing what an instruction reads. */
+    uint8_t *lane_hits;
+    /** The lanes with hits, in increasing order once sorted. */
+    uint32_t *hit_lanes;
+} Scoreboard;
+
 /**
  * The data structure for a pipelined processor.
  */
@@ -150,10 +282,25 @@ typedef struct Pipeline
      * the IF stage writes are pipe_latch[IF_LATCH][0] and
      * pipe_latch[IF_LATCH][1].
      * 
-     * Refer to the global variable PIPE_WIDTH to see how many latches should
-     * be used in each stage of the pipeline.
+     * Each stage has PIPE_WIDTH latches, allocated contiguously by
+     * pipe_init().
+     */
+    PipelineLatch *pipe_latch[NUM_LATCH_TYPES];
+
+    /**
+     * [Internal] The operations in flight, indexed by op_id & ops_mask.
+     * 
+     * Operations in flight have consecutive op_ids, and each one is in a
+     * latch of its lane (a stalled one is in both IF and ID), so there are at
+     * most NUM_LATCH_TYPES * PIPE_WIDTH of them. Once there are more entries
+     * than that, an entry is never reused while its operation is in flight.
      */
-    PipelineLatch pipe_latch[NUM_LATCH_TYPES][MAX_PIPE_WIDTH];
+    PipelineOp *ops;
+    /** [Internal] The number of entries in ops, minus 1. */
+    uint32_t ops_mask;
+
+    /** [Internal] The scoreboard of the ID stage. */
+    Scoreboard scoreboard;
 
     /**
      * The branch predictor.
@@ -162,6 +309,11 @@ typedef struct Pipeline
      */
     BPred *b_pred;
 
+    /** [Internal] The BTB, or NULL to predict targets perfectly. */
+    BTB *btb;
+    /** [Internal] The RAS, or NULL to predict returns with the BTB. */
+    RAS *ras;
+
     /**
      * Is the Instruction Fetch stage (IF) stalled due to a branch
      * misprediction?
@@ -200,8 +352,29 @@ typedef struct Pipeline
      */
     uint64_t stat_num_cycle;
 
-    /** [Internal] The file descriptor from which to read trace records. */
-    int trace_fd;
+    /** [Internal] The trace file from which to read trace records. */
+    TraceFile *trace;
+    /**
+     * [Internal] Trace data read from the trace file in bulk but not yet
+     * fetched, which stays valid until the next read from the trace file.
+     */
+    const uint8_t *trace_buf;
+    /** [Internal] The number of bytes left at trace_buf. */
+    size_t trace_buf_left;
+    /**
+     * [Internal] Whether the next trace record has already been read, to see
+     * where the last instruction fetched went, into peek_data and peek_bytes.
+     */
+    bool peeked;
+    /** [Internal] The next trace record, if peeked. */
+    const void *peek_data;
+    /** [Internal] What reading the next trace record returned, if peeked. */
+    ssize_t peek_bytes;
+    /**
+     * [Internal] The simulation points to fetch, or NULL to fetch the whole
+     * trace.
+     */
+    SimPoints *simpoints;
     /** [Internal] The last op_id assigned. */
     uint64_t last_op_id;
     /** [Internal] The op_id of the last instruction in the trace. */
@@ -210,15 +383,27 @@ typedef struct Pipeline
     bool halt;
 } Pipeline;
 
+/**
+ * Get the operation in a pipeline latch.
+ * 
+ * @param p the pipeline
+ * @param latch a valid latch of the pipeline
+ * @return a pointer to the operation
+ */
+static inline PipelineOp *pipe_op(const Pipeline *p, const PipelineLatch *latch)
+{
+    return &p->ops[latch->op];
+}
+
 /**
  * Allocate and initialize a new pipeline.
  * 
  * You should not need to modify this function.
  * 
- * @param trace_fd the file descriptor from which to read trace records
+ * @param trace the trace file from which to read trace records
  * @return a pointer to a newly allocated pipeline
  */
-Pipeline *pipe_init(int trace_fd);
+Pipeline *pipe_init(TraceFile *trace);
 
 /**
  * Simulate one cycle of all stages of a pipeline.
@@ -284,7 +469,8 @@ void pipe_cycle_WB(Pipeline *p);
 /**
  * If the instruction just fetched is a conditional branch, check for a branch
  * misprediction, update the branch predictor, and set appropriate flags in the
- * pipeline.
+ * pipeline. If the BTB is modeled, do the same for the target of any taken
+ * branch, jump, call, or return.
  * 
  * You must implement this function in part B of the lab.
  * 
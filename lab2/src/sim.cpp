@@ -8,13 +8,13 @@
 
 #include "pipeline.h"
 #include "bpred.h"
+#include "bpredsweep.h"
+#include "btb.h"
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/types.h>
-#include <sys/wait.h>
-#include <unistd.h>
+#include <thread>
 
 /**
  * The width of the pipeline; that is, the maximum number of instructions that
@@ -57,6 +57,110 @@ uint32_t ENABLE_EXE_FWD = 0;
  */
 BPredPolicy BPRED_POLICY = BPRED_PERFECT;
 
+/**
+ * The log2 of the number of entries in each table of the branch predictor.
+ * 
+ * You should not modify this value directly; it is set by the command-line
+ * argument -bpredbits.
+ */
+uint32_t BPRED_TABLE_BITS = 12;
+
+/**
+ * The number of past branch outcomes the branch predictor uses.
+ * 
+ * You should not modify this value directly; it is set by the command-line
+ * argument -bpredhist.
+ */
+uint32_t BPRED_HIST_LEN = 12;
+
+/**
+ * The number of entries in the BTB, or 0 to predict every target perfectly.
+ * 
+ * You should not modify this value directly; it is set by the command-line
+ * argument -btbentries.
+ */
+uint32_t BTB_ENTRIES = 0;
+
+/**
+ * The number of ways in each set of the BTB.
+ * 
+ * You should not modify this value directly; it is set by the command-line
+ * argument -btbways.
+ */
+uint32_t BTB_WAYS = 4;
+
+/**
+ * The replacement policy of the BTB.
+ * 
+ * You should not modify this value directly; it is set by the command-line
+ * argument -btbrepl.
+ */
+BTBReplPolicy BTB_REPL = BTB_LRU;
+
+/**
+ * The number of entries in the RAS, or 0 to predict returns with the BTB.
+ * 
+ * You should not modify this value directly; it is set by the command-line
+ * argument -rasentries.
+ */
+uint32_t RAS_ENTRIES = 16;
+
+/**
+ * The branch predictor configurations to evaluate instead of simulating the
+ * pipeline, or NULL to simulate the pipeline.
+ * 
+ * You should not modify this value directly; it is parsed from the
+ * command-line argument -bpredsweep.
+ */
+BPredSweep *bpred_sweep = NULL;
+
+/**
+ * The number of threads to shard a branch predictor sweep across, or 0 for
+ * one per hardware thread.
+ * 
+ * You should not modify this value directly; it is set by the command-line
+ * argument -bpredthreads.
+ */
+uint32_t BPRED_SWEEP_THREADS = 0;
+
+/**
+ * A Boolean indicating whether the trace file should be decompressed by an
+ * external gunzip process instead of in-process with zlib.
+ * 
+ * You should not modify this value directly; it is set by the command-line
+ * argument -gunzip.
+ */
+uint32_t USE_GUNZIP = 0;
+
+/**
+ * A Boolean indicating whether the trace file should be decompressed on a
+ * separate thread, ahead of the fetch stage.
+ * 
+ * You should not modify this value directly; it is set by the command-line
+ * argument -prefetch.
+ */
+uint32_t USE_PREFETCH = 0;
+
+/**
+ * The simulation points to simulate, or NULL to simulate the whole trace.
+ * 
+ * You should not modify this value directly; it is loaded from the file given
+ * by the command-line argument -simpoints.
+ */
+SimPoints *simpoints = NULL;
+
+/**
+ * The number of trace records to skip before simulating, the number after
+ * those to simulate only to warm up the branch predictor and pipeline, and the
+ * number after those to simulate and measure (0 for the rest of the trace).
+ * 
+ * You should not modify these values directly; they are set by the
+ * command-line arguments -skip, -warmup, and -simulate.
+ */
+uint64_t SKIP_INST = 0;
+uint64_t WARMUP_INST = 0;
+uint64_t SIMULATE_INST = 0;
+
 #define HEARTBEAT_CYCLES 10000
 #define STAT_CYCLES (HEARTBEAT_CYCLES * 50)
 
@@ -64,7 +168,6 @@ Pipeline *pipeline;
 uint64_t last_hbeat_inst = 0;
 
 int parse_args(int argc, char *argv[], char **trace_filename);
-int open_gunzip_pipe(const char *filename, int *fd, pid_t *pid);
 int check_heartbeat();
 void print_stats();
 void print_usage(char *program_name);
@@ -81,35 +184,66 @@ int main(int argc, char *argv[])
         return status;
     }
 
-    // Open the trace file using gunzip.
-    int trace_fd;
-    pid_t pid;
-    printf("Opening trace file with gunzip: %s\n", trace_filename);
-    status = open_gunzip_pipe(trace_filename, &trace_fd, &pid);
-    if (status != 0)
+    // Open the trace file.
+    printf("Opening trace file with %s%s: %s\n", USE_GUNZIP ? "gunzip" : "zlib",
+           USE_PREFETCH ? " on a prefetch thread" : "", trace_filename);
+    TraceFile *trace = USE_PREFETCH
+                           ? tracefile_open_prefetch(trace_filename, USE_GUNZIP)
+                           : tracefile_open(trace_filename, USE_GUNZIP);
+    if (trace == NULL)
     {
-        return status;
+        return 1;
+    }
+
+    if (bpred_sweep != NULL)
+    {
+        // Branch predictors are trained at fetch, regardless of the timing
+        // of the pipeline, so a sweep only needs the branches of the trace.
+        unsigned int num_threads = BPRED_SWEEP_THREADS;
+        if (num_threads == 0)
+        {
+            num_threads = std::thread::hardware_concurrency();
+        }
+        printf("\n** SWEEPING %u BRANCH PREDICTORS ON UP TO %u THREADS **\n\n",
+               bpred_sweep->count, num_threads);
+        status = bpred_sweep_run(bpred_sweep, trace, num_threads);
+        int close_status = tracefile_close(trace);
+        if (status != 0 || close_status == 127)
+        {
+            return 1;
+        }
+
+        printf("\n\n");
+        bpred_sweep_print(bpred_sweep, "LAB2");
+        printf("\n");
+        return 0;
     }
 
     // Simulate the pipeline.
-    pipeline = pipe_init(trace_fd);
+    pipeline = pipe_init(trace);
+    pipeline->simpoints = simpoints;
     status = 0;
     while (status == 0 && !pipeline->halt)
     {
         pipe_cycle(pipeline);
+        if (simpoints != NULL)
+        {
+            simpoints_retire(simpoints, pipeline->stat_retired_inst,
+                             pipeline->stat_num_cycle);
+        }
         status = check_heartbeat();
     }
-    close(trace_fd);
+    if (simpoints != NULL)
+    {
+        simpoints_finish(simpoints, pipeline->stat_retired_inst,
+                         pipeline->stat_num_cycle);
+    }
+    int close_status = tracefile_close(trace);
     if (status != 0)
     {
-        waitpid(pid, NULL, 0);
         return status;
     }
-
-    // Wait for the child process to finish.
-    waitpid(pid, &status, 0);
-    status = WEXITSTATUS(status);
-    if (status == 127)
+    if (close_status == 127)
     {
         return 1;
     }
@@ -122,6 +256,7 @@ int main(int argc, char *argv[])
 int parse_args(int argc, char *argv[], char **trace_filename)
 {
     *trace_filename = NULL;
+    const char *sweep_spec = NULL;
 
     if (argc < 2)
     {
@@ -172,14 +307,167 @@ int parse_args(int argc, char *argv[], char **trace_filename)
                     return 2;
                 }
 
-                int policy = atoi(argv[i]);
-                if (policy < 0 || policy >= NUM_BPRED_POLICIES)
+                if (!bpred_policy_parse(argv[i], &BPRED_POLICY))
                 {
                     fprintf(stderr, "Error: invalid argument for -bpredpolicy\n");
                     return 2;
                 }
+            }
+            else if (strcmp(argv[i], "-bpredbits") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -bpredbits\n");
+                    return 2;
+                }
+
+                int table_bits = atoi(argv[i]);
+                if (table_bits < 1 || table_bits > BPRED_MAX_TABLE_BITS)
+                {
+                    fprintf(stderr, "Error: predictor table bits must be between 1 and %d\n", BPRED_MAX_TABLE_BITS);
+                    return 2;
+                }
+
+                BPRED_TABLE_BITS = table_bits;
+            }
+            else if (strcmp(argv[i], "-bpredhist") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -bpredhist\n");
+                    return 2;
+                }
+
+                int hist_len = atoi(argv[i]);
+                if (hist_len < 0 || hist_len > BPRED_MAX_HIST_LEN)
+                {
+                    fprintf(stderr, "Error: predictor history length must be between 0 and %d\n", BPRED_MAX_HIST_LEN);
+                    return 2;
+                }
+
+                BPRED_HIST_LEN = hist_len;
+            }
+            else if (strcmp(argv[i], "-btbentries") == 0 ||
+                     strcmp(argv[i], "-btbways") == 0 ||
+                     strcmp(argv[i], "-rasentries") == 0)
+            {
+                if (i + 1 >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to %s\n", argv[i]);
+                    return 2;
+                }
+
+                int num_entries = atoi(argv[i + 1]);
+                if (strcmp(argv[i], "-btbentries") == 0)
+                {
+                    if (num_entries < 0 || num_entries > BTB_MAX_ENTRIES)
+                    {
+                        fprintf(stderr, "Error: BTB entries must be between 0 and %d\n", BTB_MAX_ENTRIES);
+                        return 2;
+                    }
+                    BTB_ENTRIES = num_entries;
+                }
+                else if (strcmp(argv[i], "-btbways") == 0)
+                {
+                    if (num_entries < 1 || num_entries > BTB_MAX_ENTRIES)
+                    {
+                        fprintf(stderr, "Error: BTB ways must be between 1 and %d\n", BTB_MAX_ENTRIES);
+                        return 2;
+                    }
+                    BTB_WAYS = num_entries;
+                }
+                else
+                {
+                    if (num_entries < 0 || num_entries > RAS_MAX_ENTRIES)
+                    {
+                        fprintf(stderr, "Error: RAS entries must be between 0 and %d\n", RAS_MAX_ENTRIES);
+                        return 2;
+                    }
+                    RAS_ENTRIES = num_entries;
+                }
+                i++;
+            }
+            else if (strcmp(argv[i], "-btbrepl") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -btbrepl\n");
+                    return 2;
+                }
+
+                if (!btb_repl_parse(argv[i], &BTB_REPL))
+                {
+                    fprintf(stderr, "Error: invalid argument for -btbrepl\n");
+                    return 2;
+                }
+            }
+            else if (strcmp(argv[i], "-bpredsweep") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -bpredsweep\n");
+                    return 2;
+                }
+
+                sweep_spec = argv[i];
+            }
+            else if (strcmp(argv[i], "-bpredthreads") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -bpredthreads\n");
+                    return 2;
+                }
+
+                BPRED_SWEEP_THREADS = atoi(argv[i]);
+            }
+            else if (strcmp(argv[i], "-gunzip") == 0)
+            {
+                USE_GUNZIP = 1;
+            }
+            else if (strcmp(argv[i], "-prefetch") == 0)
+            {
+                USE_PREFETCH = 1;
+            }
+            else if (strcmp(argv[i], "-simpoints") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -simpoints\n");
+                    return 2;
+                }
+
+                simpoints_free(simpoints);
+                simpoints = simpoints_load(argv[i]);
+                if (simpoints == NULL)
+                {
+                    return 2;
+                }
+            }
+            else if (strcmp(argv[i], "-skip") == 0 ||
+                     strcmp(argv[i], "-warmup") == 0 ||
+                     strcmp(argv[i], "-simulate") == 0)
+            {
+                if (i + 1 >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to %s\n", argv[i]);
+                    return 2;
+                }
 
-                BPRED_POLICY = (BPredPolicy)policy;
+                uint64_t num_inst = strtoull(argv[i + 1], NULL, 10);
+                if (strcmp(argv[i], "-skip") == 0)
+                {
+                    SKIP_INST = num_inst;
+                }
+                else if (strcmp(argv[i], "-warmup") == 0)
+                {
+                    WARMUP_INST = num_inst;
+                }
+                else
+                {
+                    SIMULATE_INST = num_inst;
+                }
+                i++;
             }
             else
             {
@@ -205,45 +493,55 @@ int parse_args(int argc, char *argv[], char **trace_filename)
         return 2;
     }
 
-    return 0;
-}
-
-int open_gunzip_pipe(const char *filename, int *fd, pid_t *pid)
-{
-    int status;
-    int pipefd[2];
+    if (BPRED_HIST_LEN > bpred_max_hist_len(BPRED_POLICY))
+    {
+        fprintf(stderr, "Error: predictor history length of %s must be at most %u\n",
+                bpred_policy_name(BPRED_POLICY), bpred_max_hist_len(BPRED_POLICY));
+        return 2;
+    }
 
-    status = pipe(pipefd);
-    if (status != 0)
+    uint32_t btb_sets = BTB_ENTRIES / BTB_WAYS;
+    if (BTB_ENTRIES > 0 &&
+        (BTB_ENTRIES % BTB_WAYS != 0 || (btb_sets & (btb_sets - 1)) != 0))
     {
-        perror("Couldn't create pipe");
-        return 1;
+        fprintf(stderr, "Error: BTB entries must be a power of two times the BTB ways\n");
+        return 2;
     }
 
-    *pid = fork();
-    if (*pid == -1)
+    if (sweep_spec != NULL)
     {
-        perror("Couldn't fork");
-        close(pipefd[0]);
-        close(pipefd[1]);
-        return 1;
+        // Parse the sweep last, since it defaults to -bpredbits and
+        // -bpredhist wherever they appear.
+        if (simpoints != NULL || SKIP_INST > 0 || WARMUP_INST > 0 ||
+            SIMULATE_INST > 0)
+        {
+            fprintf(stderr, "Error: -bpredsweep cannot be used with "
+                            "-simpoints, -skip, -warmup, or -simulate\n");
+            return 2;
+        }
+        bpred_sweep = bpred_sweep_parse(sweep_spec, BPRED_TABLE_BITS,
+                                        BPRED_HIST_LEN);
+        if (bpred_sweep == NULL)
+        {
+            return 2;
+        }
     }
 
-    if (*pid == 0)
+    if (simpoints != NULL && (SKIP_INST > 0 || SIMULATE_INST > 0))
+    {
+        fprintf(stderr, "Error: -skip and -simulate cannot be used with "
+                        "-simpoints\n");
+        return 2;
+    }
+    if (simpoints != NULL)
+    {
+        simpoints_set_warmup(simpoints, WARMUP_INST);
+    }
+    else if (SKIP_INST > 0 || WARMUP_INST > 0 || SIMULATE_INST > 0)
     {
-        // Child process: exec gunzip.
-        dup2(pipefd[1], STDOUT_FILENO);
-        close(pipefd[0]);
-        close(pipefd[1]);
-        execlp("gunzip", "gunzip", "-c", filename, NULL);
-        perror("Couldn't exec gunzip");
-        fprintf(stderr, "Is gunzip installed?\n");
-        return 127;
+        simpoints = simpoints_window(SKIP_INST, WARMUP_INST, SIMULATE_INST);
     }
 
-    // Parent process: return the read end of the pipe.
-    *fd = pipefd[0];
-    close(pipefd[1]);
     return 0;
 }
 
@@ -289,6 +587,12 @@ void print_stats()
 {
     unsigned long stat_num_inst = pipeline->stat_retired_inst;
     unsigned long stat_num_cycle = pipeline->stat_num_cycle;
+    if (simpoints != NULL)
+    {
+        // Leave out warm-up.
+        stat_num_inst = simpoints->measured_inst;
+        stat_num_cycle = simpoints->measured_cycles;
+    }
     double cpi = (double)stat_num_cycle / (double)stat_num_inst;
 
     printf("\n\n");
@@ -308,6 +612,43 @@ void print_stats()
         printf("LAB2_MISPRED_RATE       \t : %10.3f\n", bpred_mispred_rate);
     }
 
+    if (pipeline->btb != NULL)
+    {
+        unsigned long stat_lookups = pipeline->btb->stat_lookups;
+        unsigned long stat_hits = pipeline->btb->stat_hits;
+        double btb_hit_rate = 0.0;
+        if (stat_lookups > 0)
+        {
+            btb_hit_rate = 100.0 * (double)stat_hits / (double)stat_lookups;
+        }
+
+        printf("LAB2_BTB_LOOKUPS        \t : %10lu\n", stat_lookups);
+        printf("LAB2_BTB_HITS           \t : %10lu\n", stat_hits);
+        printf("LAB2_BTB_HIT_RATE       \t : %10.3f\n", btb_hit_rate);
+        printf("LAB2_BTB_MISPRED        \t : %10lu\n",
+               (unsigned long)pipeline->btb->stat_mispred);
+    }
+    if (pipeline->ras != NULL)
+    {
+        printf("LAB2_RAS_RETURNS        \t : %10lu\n",
+               (unsigned long)pipeline->ras->stat_returns);
+        printf("LAB2_RAS_MISPRED        \t : %10lu\n",
+               (unsigned long)pipeline->ras->stat_mispred);
+    }
+
+    if (simpoints != NULL && simpoints->interval_size > 0 &&
+        (BPRED_POLICY != BPRED_PERFECT || pipeline->btb != NULL))
+    {
+        // Only cycles are measured point by point; see pipe_check_warmup().
+        printf("(Branch statistics include the warm-up before each point)\n");
+    }
+
+    if (simpoints != NULL && simpoints->interval_size > 0)
+    {
+        printf("\n");
+        simpoints_print(simpoints, "LAB2");
+    }
+
     printf("\n");
 }
 
@@ -321,6 +662,35 @@ void print_usage(char *program_name)
     fprintf(stderr, "                        (disabled by default)\n");
     fprintf(stderr, "    -enableexefwd       Enable forwarding from Execute (EX) stage (disabled by\n");
     fprintf(stderr, "                        default)\n");
-    fprintf(stderr, "    -bpredpolicy <num>  Set branch predictor [0: Perfect, 1: Always Taken,\n");
-    fprintf(stderr, "                        2: Gshare] (Default: 0)\n");
+    fprintf(stderr, "    -bpredpolicy <num>  Set branch predictor, by number or name [0: perfect,\n");
+    fprintf(stderr, "                        1: taken (Always Taken), 2: gshare, 3: bimodal,\n");
+    fprintf(stderr, "                        4: tournament, 5: perceptron, 6: tage] (Default: 0)\n");
+    fprintf(stderr, "    -bpredbits <bits>   Set log2 of the number of entries in each branch\n");
+    fprintf(stderr, "                        predictor table (Default: 12)\n");
+    fprintf(stderr, "    -bpredhist <len>    Set number of past branch outcomes the branch\n");
+    fprintf(stderr, "                        predictor uses (Default: 12)\n");
+    fprintf(stderr, "    -btbentries <num>   Set number of entries in the branch target buffer\n");
+    fprintf(stderr, "                        (Default: 0, predict every target perfectly)\n");
+    fprintf(stderr, "    -btbways <num>      Set number of ways in each BTB set (Default: 4)\n");
+    fprintf(stderr, "    -btbrepl <num>      Set BTB replacement policy, by number or name [0: lru,\n");
+    fprintf(stderr, "                        1: random] (Default: 0)\n");
+    fprintf(stderr, "    -rasentries <num>   Set number of entries in the return address stack,\n");
+    fprintf(stderr, "                        or 0 to predict returns with the BTB (Default: 16)\n");
+    fprintf(stderr, "    -bpredsweep <list>  Instead of simulating the pipeline, report the\n");
+    fprintf(stderr, "                        misprediction rate of every branch predictor in\n");
+    fprintf(stderr, "                        <list>, e.g. gshare:12:12,bimodal:14,perceptron,\n");
+    fprintf(stderr, "                        each <policy>[:<bits>[:<hist>]] as above\n");
+    fprintf(stderr, "    -bpredthreads <num> Set number of threads for -bpredsweep (Default: 0,\n");
+    fprintf(stderr, "                        one per hardware thread)\n");
+    fprintf(stderr, "    -gunzip             Decompress the trace with an external gunzip process\n");
+    fprintf(stderr, "                        instead of in-process with zlib\n");
+    fprintf(stderr, "    -prefetch           Decompress the trace on a separate thread, ahead of\n");
+    fprintf(stderr, "                        the fetch stage\n");
+    fprintf(stderr, "    -simpoints <file>   Simulate only the simulation points listed in <file>\n");
+    fprintf(stderr, "                        and report their weighted CPI\n");
+    fprintf(stderr, "    -skip <num>         Skip the first <num> instructions of the trace\n");
+    fprintf(stderr, "    -warmup <num>       Simulate <num> instructions, after those skipped or\n");
+    fprintf(stderr, "                        before each simulation point, without measuring them\n");
+    fprintf(stderr, "    -simulate <num>     Measure only the next <num> instructions (Default: 0,\n");
+    fprintf(stderr, "                        the rest of the trace)\n");
 }
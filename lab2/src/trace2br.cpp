@@ -0,0 +1,134 @@
+// trace2br.cpp
+// Extracts the conditional branches of a gzip-compressed lab2 trace file into
+// a branch trace file, which brreplay runs branch predictors against.
+
+#include "brtrace.h"
+#include "trace.h"
+#include "tracefile.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/** The number of trace records read from the trace file at a time. */
+#define CONVERT_READ_RECS 1024
+
+static void print_usage(char *program_name)
+{
+    fprintf(stderr, "Usage: %s [options] <trace file> <branch trace file>\n\n",
+            program_name);
+    fprintf(stderr, "Extracts the conditional branches of a trace into a branch trace\n\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "    -gunzip             Decompress the trace with an external gunzip process\n");
+    fprintf(stderr, "                        instead of in-process with zlib\n");
+}
+
+int main(int argc, char *argv[])
+{
+    bool use_gunzip = false;
+    char *filenames[2];
+    int num_filenames = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-gunzip") == 0)
+        {
+            use_gunzip = true;
+        }
+        else if (argv[i][0] == '-' || num_filenames == 2)
+        {
+            print_usage(argv[0]);
+            return 2;
+        }
+        else
+        {
+            filenames[num_filenames++] = argv[i];
+        }
+    }
+    if (num_filenames != 2)
+    {
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    TraceFile *tf = tracefile_open(filenames[0], use_gunzip);
+    if (tf == NULL)
+    {
+        return 1;
+    }
+    BranchTrace *bt = brtrace_create(filenames[1]);
+    if (bt == NULL)
+    {
+        tracefile_close(tf);
+        return 1;
+    }
+
+    int status = 0;
+    uint64_t num_inst = 0;
+    while (true)
+    {
+        const void *data;
+        size_t buf_size = CONVERT_READ_RECS * sizeof(TraceRec);
+        ssize_t bytes_read = tracefile_next(tf, &data, buf_size);
+        if (bytes_read == -1)
+        {
+            status = 1;
+            break;
+        }
+
+        size_t num_recs = bytes_read / sizeof(TraceRec);
+        if (num_recs * sizeof(TraceRec) != (size_t)bytes_read)
+        {
+            fprintf(stderr, "Error: Invalid trace file\n");
+            status = 1;
+            break;
+        }
+        const TraceRec *recs = (const TraceRec *)data;
+        for (size_t i = 0; i < num_recs && status == 0; i++)
+        {
+            if (recs[i].op_type >= NUM_OP_TYPES)
+            {
+                fprintf(stderr, "Error: Invalid trace file\n");
+                status = 1;
+            }
+            else if (recs[i].op_type == OP_CBR)
+            {
+                BranchRec branch;
+                branch.pc = recs[i].inst_addr;
+                branch.target = recs[i].br_target;
+                branch.dir = recs[i].br_dir;
+                if (brtrace_write(bt, &branch) != 0)
+                {
+                    status = 1;
+                }
+            }
+        }
+        num_inst += num_recs;
+
+        if (status != 0 || (size_t)bytes_read < buf_size)
+        {
+            break;
+        }
+    }
+
+    uint64_t in_bytes = tf->stat_bytes;
+    if (tracefile_close(tf) == 127)
+    {
+        status = 1;
+    }
+    uint64_t num_branches = bt->branch;
+    bt->header.num_inst = num_inst;
+    if (brtrace_close(bt) != 0)
+    {
+        status = 1;
+    }
+    if (status != 0)
+    {
+        unlink(filenames[1]);
+        return status;
+    }
+
+    printf("Extracted %lu branches of %lu records (%lu bytes) to %s\n",
+           (unsigned long)num_branches, (unsigned long)num_inst,
+           (unsigned long)in_bytes, filenames[1]);
+    return 0;
+}
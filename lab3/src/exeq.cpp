@@ -10,14 +10,21 @@
 #include <stdlib.h>
 
 /**
- * Allocate and initialize a new EXEQ.
+ * Allocate and initialize a new EXEQ, with room for every instruction that
+ * can be executing at once: PIPE_WIDTH per cycle for LOAD_EXE_CYCLES cycles.
  * 
  * @return a pointer to a newly allocated EXEQ
  */
 EXEQ *exeq_init()
 {
     EXEQ *exeq = (EXEQ *)calloc(1, sizeof(EXEQ));
-    for (unsigned int i = 0; i < MAX_EXEQ_ENTRIES; i++)
+    exeq->num_entries = PIPE_WIDTH * LOAD_EXE_CYCLES;
+    if (exeq->num_entries < MAX_EXEQ_ENTRIES)
+    {
+        exeq->num_entries = MAX_EXEQ_ENTRIES;
+    }
+    exeq->entries = (EXEQEntry *)calloc(exeq->num_entries, sizeof(EXEQEntry));
+    for (unsigned int i = 0; i < exeq->num_entries; i++)
     {
         exeq->entries[i].valid = false;
     }
@@ -37,7 +44,7 @@ void exeq_print_state(EXEQ *t)
 {
     printf("Current EXEQ state:\n");
     printf("Entry  Valid  Inst  Wait Cycles\n");
-    for (unsigned int i = 0; i < MAX_EXEQ_ENTRIES; i++)
+    for (unsigned int i = 0; i < t->num_entries; i++)
     {
         printf("%5d ::  %d ", i, t->entries[i].valid);
         printf("%5d \t", (int)t->entries[i].inst.inst_num);
@@ -53,7 +60,7 @@ void exeq_print_state(EXEQ *t)
  */
 void exeq_cycle(EXEQ *exeq)
 {
-    for (unsigned int i = 0; i < MAX_EXEQ_ENTRIES; i++)
+    for (unsigned int i = 0; i < exeq->num_entries; i++)
     {
         if (exeq->entries[i].valid)
         {
@@ -71,7 +78,7 @@ void exeq_cycle(EXEQ *exeq)
  */
 bool exeq_insert(EXEQ *exeq, InstInfo inst)
 {
-    for (unsigned int i = 0; i < MAX_EXEQ_ENTRIES; i++)
+    for (unsigned int i = 0; i < exeq->num_entries; i++)
     {
         if (!exeq->entries[i].valid)
         {
@@ -100,7 +107,7 @@ bool exeq_insert(EXEQ *exeq, InstInfo inst)
  */
 bool exeq_check_done(EXEQ *exeq)
 {
-    for (unsigned int i = 0; i < MAX_EXEQ_ENTRIES; i++)
+    for (unsigned int i = 0; i < exeq->num_entries; i++)
     {
         if (exeq->entries[i].valid)
         {
@@ -122,7 +129,7 @@ bool exeq_check_done(EXEQ *exeq)
  */
 InstInfo exeq_remove(EXEQ *exeq)
 {
-    for (unsigned int i = 0; i < MAX_EXEQ_ENTRIES; i++)
+    for (unsigned int i = 0; i < exeq->num_entries; i++)
     {
         if (exeq->entries[i].valid &&
             exeq->entries[i].inst.exe_wait_cycles == 0)
@@ -136,3 +143,44 @@ InstInfo exeq_remove(EXEQ *exeq)
     InstInfo dummy;
     return dummy;
 }
+
+/**
+ * Get the number of cycles until the next instruction in the execution queue
+ * finishes executing.
+ * 
+ * @param exeq the EXEQ
+ * @return the number of calls to exeq_cycle() after which exeq_check_done()
+ *         will be true, or 0 if the queue is empty
+ */
+unsigned int exeq_cycles_to_done(EXEQ *exeq)
+{
+    unsigned int cycles = 0;
+    for (unsigned int i = 0; i < exeq->num_entries; i++)
+    {
+        if (exeq->entries[i].valid &&
+            (cycles == 0 ||
+             (unsigned int)exeq->entries[i].inst.exe_wait_cycles < cycles))
+        {
+            cycles = exeq->entries[i].inst.exe_wait_cycles;
+        }
+    }
+    return cycles;
+}
+
+/**
+ * Simulate several cycles of the execution queue at once.
+ * 
+ * @param exeq the EXEQ
+ * @param cycles the number of cycles, which must be less than
+ *               exeq_cycles_to_done()
+ */
+void exeq_skip(EXEQ *exeq, unsigned int cycles)
+{
+    for (unsigned int i = 0; i < exeq->num_entries; i++)
+    {
+        if (exeq->entries[i].valid)
+        {
+            exeq->entries[i].inst.exe_wait_cycles -= cycles;
+        }
+    }
+}
@@ -12,11 +12,14 @@
 #include <inttypes.h>
 
 /**
- * The maximum number of instructions that can be in the execution queue at
- * once.
+ * The minimum number of instructions that can be in the execution queue at
+ * once. Wider pipelines and longer loads get a larger queue; see exeq_init().
  */
 #define MAX_EXEQ_ENTRIES 16
 
+/** The width of the pipeline, which bounds the EXEQ insertions per cycle. */
+extern uint32_t PIPE_WIDTH;
+
 /**
  * The number of cycles an LD instruction should take to execute.
  * 
@@ -38,11 +41,14 @@ typedef struct EXEQEntryStruct
 typedef struct EXEQStruct
 {
     /** An array of execution queue entries. */
-    EXEQEntry entries[MAX_EXEQ_ENTRIES];
+    EXEQEntry *entries;
+    /** The number of entries in the array. */
+    unsigned int num_entries;
 } EXEQ;
 
 /**
- * Allocate and initialize a new EXEQ.
+ * Allocate and initialize a new EXEQ, with room for every instruction that
+ * can be executing at once: PIPE_WIDTH per cycle for LOAD_EXE_CYCLES cycles.
  * 
  * @return a pointer to a newly allocated EXEQ
  */
@@ -92,4 +98,23 @@ bool exeq_check_done(EXEQ *t);
  */
 InstInfo exeq_remove(EXEQ *exeq);
 
+/**
+ * Get the number of cycles until the next instruction in the execution queue
+ * finishes executing.
+ * 
+ * @param exeq the EXEQ
+ * @return the number of calls to exeq_cycle() after which exeq_check_done()
+ *         will be true, or 0 if the queue is empty
+ */
+unsigned int exeq_cycles_to_done(EXEQ *exeq);
+
+/**
+ * Simulate several cycles of the execution queue at once.
+ * 
+ * @param exeq the EXEQ
+ * @param cycles the number of cycles, which must be less than
+ *               exeq_cycles_to_done()
+ */
+void exeq_skip(EXEQ *exeq, unsigned int cycles);
+
 #endif
@@ -67,29 +67,24 @@ extern uint32_t LOAD_EXE_CYCLES;
 void pipe_fetch_inst(Pipeline *p, PipelineLatch *fe_latch)
 {
     InstInfo *inst = &fe_latch->inst;
-    TraceRec trace_rec;
-    uint8_t *trace_rec_buf = (uint8_t *)&trace_rec;
-    size_t bytes_read_total = 0;
-    ssize_t bytes_read_last = 0;
-    size_t bytes_left = sizeof(TraceRec);
-
-    // Read a total of sizeof(TraceRec) bytes from the trace file.
-    while (bytes_left > 0)
-    {
-        bytes_read_last = read(p->trace_fd, trace_rec_buf, bytes_left);
-        if (bytes_read_last <= 0)
-        {
-            // EOF or error
-            break;
-        }
+    const void *data;
 
-        trace_rec_buf += bytes_read_last;
-        bytes_read_total += bytes_read_last;
-        bytes_left -= bytes_read_last;
+    // Get the next sizeof(TraceRec) bytes straight from the trace file,
+    // skipping ahead to the next simulation point if needed.
+    ssize_t bytes_read;
+    if (p->simpoints != NULL)
+    {
+        bytes_read = simpoints_next(p->simpoints, p->trace, &data,
+                                    sizeof(TraceRec));
+    }
+    else
+    {
+        bytes_read = tracefile_next(p->trace, &data, sizeof(TraceRec));
     }
+    const TraceRec *trace_rec = (const TraceRec *)data;
 
     // Check for error conditions.
-    if (bytes_left > 0 || trace_rec.op_type >= NUM_OP_TYPES)
+    if (bytes_read != sizeof(TraceRec) || trace_rec->op_type >= NUM_OP_TYPES)
     {
         fe_latch->valid = false;
         p->halt_inst_num = p->last_inst_num;
@@ -99,14 +94,13 @@ void pipe_fetch_inst(Pipeline *p, PipelineLatch *fe_latch)
             p->halt = true;
         }
 
-        if (bytes_read_last == -1)
+        if (bytes_read == -1)
         {
-            fprintf(stderr, "\n");
-            perror("Couldn't read from pipe");
+            // tracefile_next() has already reported the error.
             return;
         }
 
-        if (bytes_read_total == 0)
+        if (bytes_read == 0)
         {
             // No more trace records to read
             return;
@@ -122,11 +116,11 @@ void pipe_fetch_inst(Pipeline *p, PipelineLatch *fe_latch)
     fe_latch->valid = true;
     fe_latch->stall = false;
     inst->inst_num = ++p->last_inst_num;
-    inst->op_type = (OpType)trace_rec.op_type;
+    inst->op_type = (OpType)trace_rec->op_type;
 
-    inst->dest_reg = trace_rec.dest_needed ? trace_rec.dest_reg : -1;
-    inst->src1_reg = trace_rec.src1_needed ? trace_rec.src1_reg : -1;
-    inst->src2_reg = trace_rec.src2_needed ? trace_rec.src2_reg : -1;
+    inst->dest_reg = trace_rec->dest_needed ? trace_rec->dest_reg : -1;
+    inst->src1_reg = trace_rec->src1_needed ? trace_rec->src1_reg : -1;
+    inst->src2_reg = trace_rec->src2_needed ? trace_rec->src2_reg : -1;
 
     inst->dr_tag = -1;
     inst->src1_tag = -1;
@@ -136,15 +130,51 @@ void pipe_fetch_inst(Pipeline *p, PipelineLatch *fe_latch)
     inst->exe_wait_cycles = 0;
 }
 
+/**
+ * Check whether any of the first PIPE_WIDTH latches of a stage hold an
+ * instruction. Finished instructions fill the EX latches from the first, so
+ * this covers them too.
+ * 
+ * @param latches the latches of the stage
+ * @return true if any of them is valid
+ */
+static bool pipe_any_valid(const PipelineLatch *latches)
+{
+    for (unsigned int i = 0; i < PIPE_WIDTH; i++)
+    {
+        if (latches[i].valid)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Count the latches of a stage that hold an instruction.
+ * 
+ * @param latches the PIPE_WIDTH latches of the stage
+ * @return the number of valid latches
+ */
+static unsigned int pipe_count_valid(const PipelineLatch *latches)
+{
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < PIPE_WIDTH; i++)
+    {
+        count += latches[i].valid;
+    }
+    return count;
+}
+
 /**
  * Allocate and initialize a new pipeline.
  * 
  * You should not need to modify this function.
  * 
- * @param trace_fd the file descriptor from which to read trace records
+ * @param trace the trace file from which to read trace records
  * @return a pointer to a newly allocated pipeline
  */
-Pipeline *pipe_init(int trace_fd)
+Pipeline *pipe_init(TraceFile *trace)
 {
     printf("\n** PIPELINE IS %d WIDE **\n\n", PIPE_WIDTH);
 
@@ -155,9 +185,12 @@ Pipeline *pipe_init(int trace_fd)
     p->rat = rat_init();
     p->rob = rob_init();
     p->exeq = exeq_init();
-    p->trace_fd = trace_fd;
+    p->trace = trace;
     p->halt_inst_num = (uint64_t)(-1) - 3;
 
+    p->FE_latch = (PipelineLatch *)calloc(PIPE_WIDTH, sizeof(PipelineLatch));
+    p->ID_latch = (PipelineLatch *)calloc(PIPE_WIDTH, sizeof(PipelineLatch));
+    p->SC_latch = (PipelineLatch *)calloc(PIPE_WIDTH, sizeof(PipelineLatch));
     for (unsigned int i = 0; i < PIPE_WIDTH; i++)
     {
         p->FE_latch[i].valid = false;
@@ -301,6 +334,13 @@ void pipe_cycle(Pipeline *p)
            (unsigned long)p->stat_retired_inst);
     #endif
     
+    // Note what the stages would change, to tell whether the cycle is idle.
+    bool was_busy = pipe_any_valid(p->SC_latch) || pipe_any_valid(p->EX_latch);
+    uint64_t retired_inst = p->stat_retired_inst;
+    int rob_tail = p->rob->tail_ptr;
+    unsigned int fe_valid = pipe_count_valid(p->FE_latch);
+    uint64_t last_inst_num = p->last_inst_num;
+
     // In our simulator, stages are processed in reverse order.
     pipe_cycle_commit(p);
     pipe_cycle_writeback(p);
@@ -310,12 +350,53 @@ void pipe_cycle(Pipeline *p)
     pipe_cycle_decode(p);
     pipe_cycle_fetch(p);
 
+    // Nothing was written back, executed or scheduled (the SC and EX latches
+    // stayed empty), committed, issued (the ROB tail stayed put), decoded
+    // (the FE latches kept their instructions), or fetched.
+    p->idle = !was_busy && !pipe_any_valid(p->SC_latch) &&
+              !pipe_any_valid(p->EX_latch) &&
+              p->stat_retired_inst == retired_inst &&
+              p->rob->tail_ptr == rob_tail &&
+              pipe_count_valid(p->FE_latch) == fe_valid &&
+              p->last_inst_num == last_inst_num;
+
     // Compile with "make debug" to have this show!
     #ifdef DEBUG
         pipe_print_state(p);
     #endif
 }
 
+/**
+ * If the last cycle was idle, skip the cycles that would be idle as well,
+ * up to the one in which an instruction finishes executing in the EXEQ.
+ * 
+ * Skipped cycles are counted in stat_num_cycle as if simulated.
+ * 
+ * You should not modify this function.
+ * 
+ * @param p the pipeline to simulate
+ * @param max_cycles the maximum number of cycles to skip
+ */
+void pipe_skip_idle(Pipeline *p, uint64_t max_cycles)
+{
+    if (!p->idle || p->halt)
+    {
+        return;
+    }
+
+    // With the EXEQ empty, nothing would ever happen: the pipeline is
+    // deadlocked, which the caller will notice.
+    uint64_t cycles = exeq_cycles_to_done(p->exeq);
+    if (cycles == 0)
+    {
+        return;
+    }
+
+    cycles = cycles - 1 < max_cycles ? cycles - 1 : max_cycles;
+    exeq_skip(p->exeq, (unsigned int)cycles);
+    p->stat_num_cycle += cycles;
+}
+
 /**
  * Simulate one cycle of the fetch stage of a pipeline.
  * 
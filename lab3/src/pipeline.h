@@ -12,6 +12,8 @@
 #define _PIPELINE_H_
 
 #include "trace.h"
+#include "tracefile.h"
+#include "simpoints.h"
 #include "rat.h"
 #include "rob.h"
 #include "exeq.h"
@@ -20,12 +22,13 @@
 /**
  * [Internal] The maximum allowed width of the pipeline.
  * 
- * This is an implementation detail that defines the array size of most
- * Pipeline::*_latch arrays; you should not have to use this value directly.
+ * The FE, ID, and SC latch arrays are allocated to PIPE_WIDTH, so this only
+ * bounds the -pipewidth argument; you should not have to use this value
+ * directly.
  * 
  * You may need to use the global variable PIPE_WIDTH instead.
  */
-#define MAX_PIPE_WIDTH 8
+#define MAX_PIPE_WIDTH 64
 
 /**
  * The maximum number of instructions that can be written back in a single
@@ -91,30 +94,27 @@ typedef struct Pipeline
      * The FE (fetch) stage writes instructions to this latch.
      * The ID (instruction decode) stage reads instructions from this latch.
      * 
-     * Not all MAX_PIPE_WIDTH entries of this array will be used. Refer to the
-     * global variable PIPE_WIDTH to see how many of these will be used.
+     * This array has PIPE_WIDTH entries, allocated by pipe_init().
      */
-    PipelineLatch FE_latch[MAX_PIPE_WIDTH];
+    PipelineLatch *FE_latch;
 
     /**
      * The pipeline latch holding decoded instructions.
      * The ID (instruction decode) stage writes instructions to this latch.
      * The issue stage reads instructions from this latch.
      * 
-     * Not all MAX_PIPE_WIDTH entries of this array will be used. Refer to the
-     * global variable PIPE_WIDTH to see how many of these will be used.
+     * This array has PIPE_WIDTH entries, allocated by pipe_init().
      */
-    PipelineLatch ID_latch[MAX_PIPE_WIDTH];
+    PipelineLatch *ID_latch;
 
     /**
      * The pipeline latch holding scheduled instructions.
      * The SC (scheduling) stage writes instructions to this latch.
      * The EX (execution) stage reads instructions from this latch.
      * 
-     * Not all MAX_PIPE_WIDTH entries of this array will be used. Refer to the
-     * global variable PIPE_WIDTH to see how many of these will be used.
+     * This array has PIPE_WIDTH entries, allocated by pipe_init().
      */
-    PipelineLatch SC_latch[MAX_PIPE_WIDTH];
+    PipelineLatch *SC_latch;
 
     /**
      * The pipeline latch holding instructions that have completed execution.
@@ -169,14 +169,25 @@ typedef struct Pipeline
      */
     uint64_t stat_num_cycle;
 
-    /** [Internal] The file descriptor from which to read trace records. */
-    int trace_fd;
+    /** [Internal] The trace file from which to read trace records. */
+    TraceFile *trace;
+    /**
+     * [Internal] The simulation points to fetch, or NULL to fetch the whole
+     * trace.
+     */
+    SimPoints *simpoints;
     /** [Internal] The last inst_num assigned. */
     uint64_t last_inst_num;
     /** [Internal] The inst_num of the last instruction in the trace. */
     uint64_t halt_inst_num;
     /** [Internal] Whether the pipeline is done. */
     bool halt;
+    /**
+     * [Internal] Whether the last cycle changed nothing but the wait times in
+     * the EXEQ, so that every cycle until an instruction there finishes will
+     * do the same.
+     */
+    bool idle;
 } Pipeline;
 
 /**
@@ -184,10 +195,10 @@ typedef struct Pipeline
  * 
  * You should not modify this function.
  * 
- * @param trace_fd the file descriptor from which to read trace records
+ * @param trace the trace file from which to read trace records
  * @return a pointer to a newly allocated pipeline
  */
-Pipeline *pipe_init(int trace_fd);
+Pipeline *pipe_init(TraceFile *trace);
 
 /**
  * Simulate one cycle of all stages of a pipeline.
@@ -200,6 +211,17 @@ Pipeline *pipe_init(int trace_fd);
  */
 void pipe_cycle(Pipeline *p);
 
+/**
+ * If the last cycle was idle, skip the cycles that would be idle as well,
+ * up to the one in which an instruction finishes executing in the EXEQ.
+ * 
+ * Skipped cycles are counted in stat_num_cycle as if simulated.
+ * 
+ * @param p the pipeline to simulate
+ * @param max_cycles the maximum number of cycles to skip
+ */
+void pipe_skip_idle(Pipeline *p, uint64_t max_cycles);
+
 /**
  * Simulate one cycle of the fetch stage of a pipeline.
  * 
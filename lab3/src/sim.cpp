@@ -11,9 +11,6 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/types.h>
-#include <sys/wait.h>
-#include <unistd.h>
 
 /**
  * The width of the pipeline; that is, the maximum number of instructions that
@@ -67,6 +64,44 @@ uint32_t LOAD_EXE_CYCLES = 4;
  */
 SchedulingPolicy SCHED_POLICY = SCHED_OUT_OF_ORDER;
 
+/**
+ * A Boolean indicating whether the trace file should be decompressed by an
+ * external gunzip process instead of in-process with zlib.
+ * 
+ * You should not modify this value directly; it is set by the command-line
+ * argument -gunzip.
+ */
+uint32_t USE_GUNZIP = 0;
+
+/**
+ * A Boolean indicating whether the trace file should be decompressed on a
+ * separate thread, ahead of the fetch stage.
+ * 
+ * You should not modify this value directly; it is set by the command-line
+ * argument -prefetch.
+ */
+uint32_t USE_PREFETCH = 0;
+
+/**
+ * The simulation points to simulate, or NULL to simulate the whole trace.
+ * 
+ * You should not modify this value directly; it is loaded from the file given
+ * by the command-line argument -simpoints.
+ */
+SimPoints *simpoints = NULL;
+
+/**
+ * The number of trace records to skip before simulating, the number after
+ * those to simulate only to warm up the pipeline, and the number after those
+ * to simulate and measure (0 for the rest of the trace).
+ * 
+ * You should not modify these values directly; they are set by the
+ * command-line arguments -skip, -warmup, and -simulate.
+ */
+uint64_t SKIP_INST = 0;
+uint64_t WARMUP_INST = 0;
+uint64_t SIMULATE_INST = 0;
+
 #define HEARTBEAT_CYCLES 10000
 #define STAT_CYCLES (HEARTBEAT_CYCLES * 50)
 
@@ -74,7 +109,6 @@ Pipeline *pipeline;
 uint64_t last_hbeat_inst = 0;
 
 int parse_args(int argc, char *argv[], char **trace_filename);
-int open_gunzip_pipe(const char *filename, int *fd, pid_t *pid);
 int check_heartbeat();
 void print_stats();
 void print_usage(char *program_name);
@@ -91,35 +125,47 @@ int main(int argc, char *argv[])
         return status;
     }
 
-    // Open the trace file using gunzip.
-    int trace_fd;
-    pid_t pid;
-    printf("Opening trace file with gunzip: %s\n", trace_filename);
-    status = open_gunzip_pipe(trace_filename, &trace_fd, &pid);
-    if (status != 0)
+    // Open the trace file.
+    printf("Opening trace file with %s%s: %s\n", USE_GUNZIP ? "gunzip" : "zlib",
+           USE_PREFETCH ? " on a prefetch thread" : "", trace_filename);
+    TraceFile *trace = USE_PREFETCH
+                           ? tracefile_open_prefetch(trace_filename, USE_GUNZIP)
+                           : tracefile_open(trace_filename, USE_GUNZIP);
+    if (trace == NULL)
     {
-        return status;
+        return 1;
     }
 
     // Simulate the pipeline.
-    pipeline = pipe_init(trace_fd);
+    pipeline = pipe_init(trace);
+    pipeline->simpoints = simpoints;
     status = 0;
     while (status == 0 && !pipeline->halt)
     {
         pipe_cycle(pipeline);
+        if (simpoints != NULL)
+        {
+            simpoints_retire(simpoints, pipeline->stat_retired_inst,
+                             pipeline->stat_num_cycle);
+        }
         status = check_heartbeat();
+
+        // Skip cycles spent waiting on the EXEQ, but stop short of the next
+        // heartbeat so that it still sees every cycle count it checks.
+        pipe_skip_idle(pipeline, HEARTBEAT_CYCLES - 1 -
+                                     pipeline->stat_num_cycle % HEARTBEAT_CYCLES);
+    }
+    if (simpoints != NULL)
+    {
+        simpoints_finish(simpoints, pipeline->stat_retired_inst,
+                         pipeline->stat_num_cycle);
     }
-    close(trace_fd);
+    int close_status = tracefile_close(trace);
     if (status != 0)
     {
-        waitpid(pid, NULL, 0);
         return status;
     }
-
-    // Wait for the child process to finish.
-    waitpid(pid, &status, 0);
-    status = WEXITSTATUS(status);
-    if (status == 127)
+    if (close_status == 127)
     {
         return 1;
     }
@@ -200,6 +246,54 @@ int parse_args(int argc, char *argv[], char **trace_filename)
 
                 SCHED_POLICY = (SchedulingPolicy)policy;
             }
+            else if (strcmp(argv[i], "-gunzip") == 0)
+            {
+                USE_GUNZIP = 1;
+            }
+            else if (strcmp(argv[i], "-prefetch") == 0)
+            {
+                USE_PREFETCH = 1;
+            }
+            else if (strcmp(argv[i], "-simpoints") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -simpoints\n");
+                    return 2;
+                }
+
+                simpoints_free(simpoints);
+                simpoints = simpoints_load(argv[i]);
+                if (simpoints == NULL)
+                {
+                    return 2;
+                }
+            }
+            else if (strcmp(argv[i], "-skip") == 0 ||
+                     strcmp(argv[i], "-warmup") == 0 ||
+                     strcmp(argv[i], "-simulate") == 0)
+            {
+                if (i + 1 >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to %s\n", argv[i]);
+                    return 2;
+                }
+
+                uint64_t num_inst = strtoull(argv[i + 1], NULL, 10);
+                if (strcmp(argv[i], "-skip") == 0)
+                {
+                    SKIP_INST = num_inst;
+                }
+                else if (strcmp(argv[i], "-warmup") == 0)
+                {
+                    WARMUP_INST = num_inst;
+                }
+                else
+                {
+                    SIMULATE_INST = num_inst;
+                }
+                i++;
+            }
             else
             {
                 fprintf(stderr, "Error: unrecognized option: %s\n", argv[i]);
@@ -224,45 +318,21 @@ int parse_args(int argc, char *argv[], char **trace_filename)
         return 2;
     }
 
-    return 0;
-}
-
-int open_gunzip_pipe(const char *filename, int *fd, pid_t *pid)
-{
-    int status;
-    int pipefd[2];
-
-    status = pipe(pipefd);
-    if (status != 0)
+    if (simpoints != NULL && (SKIP_INST > 0 || SIMULATE_INST > 0))
     {
-        perror("Couldn't create pipe");
-        return 1;
+        fprintf(stderr, "Error: -skip and -simulate cannot be used with "
+                        "-simpoints\n");
+        return 2;
     }
-
-    *pid = fork();
-    if (*pid == -1)
+    if (simpoints != NULL)
     {
-        perror("Couldn't fork");
-        close(pipefd[0]);
-        close(pipefd[1]);
-        return 1;
+        simpoints_set_warmup(simpoints, WARMUP_INST);
     }
-
-    if (*pid == 0)
+    else if (SKIP_INST > 0 || WARMUP_INST > 0 || SIMULATE_INST > 0)
     {
-        // Child process: exec gunzip.
-        dup2(pipefd[1], STDOUT_FILENO);
-        close(pipefd[0]);
-        close(pipefd[1]);
-        execlp("gunzip", "gunzip", "-c", filename, NULL);
-        perror("Couldn't exec gunzip");
-        fprintf(stderr, "Is gunzip installed?\n");
-        return 127;
+        simpoints = simpoints_window(SKIP_INST, WARMUP_INST, SIMULATE_INST);
     }
 
-    // Parent process: return the read end of the pipe.
-    *fd = pipefd[0];
-    close(pipefd[1]);
     return 0;
 }
 
@@ -308,12 +378,25 @@ void print_stats()
 {
     unsigned long stat_num_inst = pipeline->stat_retired_inst;
     unsigned long stat_num_cycle = pipeline->stat_num_cycle;
+    if (simpoints != NULL)
+    {
+        // Leave out warm-up.
+        stat_num_inst = simpoints->measured_inst;
+        stat_num_cycle = simpoints->measured_cycles;
+    }
     double cpi = (double)stat_num_cycle / (double)stat_num_inst;
 
     printf("\n\n");
     printf("LAB3_NUM_INST           \t : %10lu\n", stat_num_inst);
     printf("LAB3_NUM_CYCLES         \t : %10lu\n", stat_num_cycle);
     printf("LAB3_CPI                \t : %10.3f\n", cpi);
+
+    if (simpoints != NULL && simpoints->interval_size > 0)
+    {
+        printf("\n");
+        simpoints_print(simpoints, "LAB3");
+    }
+
     printf("\n");
 }
 
@@ -326,4 +409,15 @@ void print_usage(char *program_name)
     fprintf(stderr, "    -schedpolicy <num>  Set scheduling policy [0: in-order, 1: out-of-order]\n");
     fprintf(stderr, "                        (default: 1)\n");
     fprintf(stderr, "    -loadlatency <num>  Set number of cycles for LD to execute (default: 4)\n");
+    fprintf(stderr, "    -gunzip             Decompress the trace with an external gunzip process\n");
+    fprintf(stderr, "                        instead of in-process with zlib\n");
+    fprintf(stderr, "    -prefetch           Decompress the trace on a separate thread, ahead of\n");
+    fprintf(stderr, "                        the fetch stage\n");
+    fprintf(stderr, "    -simpoints <file>   Simulate only the simulation points listed in <file>\n");
+    fprintf(stderr, "                        and report their weighted CPI\n");
+    fprintf(stderr, "    -skip <num>         Skip the first <num> instructions of the trace\n");
+    fprintf(stderr, "    -warmup <num>       Simulate <num> instructions, after those skipped or\n");
+    fprintf(stderr, "                        before each simulation point, without measuring them\n");
+    fprintf(stderr, "    -simulate <num>     Measure only the next <num> instructions (default: 0,\n");
+    fprintf(stderr, "                        the rest of the trace)\n");
 }
@@ -0,0 +1,205 @@
+// tracefile.h
+// Declares a reader for trace files.
+//
+// By default a gzip-compressed trace is decompressed in-process with zlib. The
+// older method of forking "gunzip -c" and reading its output through a pipe is
+// still available as a fallback.
+//
+// A trace that is not gzip-compressed (e.g. the output of gunzip, kept around
+// to avoid decompressing the same trace on every run) is memory-mapped
+// instead, and tracefile_next() hands out records straight from the mapping.
+// A trace that is not a regular file, such as a pipe, can't be mapped, so it
+// is streamed through zlib, gunzip, or plain reads.
+//
+// A compressed trace opened with tracefile_open_prefetch() is decompressed on
+// a separate thread, which fills a ring of buffers ahead of the reader, so the
+// reader never waits on read() or inflate() while the ring has data.
+
+#ifndef _TRACEFILE_H_
+#define _TRACEFILE_H_
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <zlib.h>
+
+/** The size of the buffer compressed data is read into. */
+#define TRACEFILE_IN_BUF_SIZE (256 * 1024)
+
+/**
+ * The size of the buffer compressed data is inflated into.
+ *
+ * Reads at least this large are inflated straight into the caller's buffer
+ * instead.
+ */
+#define TRACEFILE_OUT_BUF_SIZE (1024 * 1024)
+
+/**
+ * The number of buffers of TRACEFILE_OUT_BUF_SIZE bytes the prefetch thread
+ * can fill ahead of the reader.
+ */
+#define TRACEFILE_PREFETCH_SLOTS 4
+
+/** The state shared with a prefetch thread; defined in tracefile.cpp. */
+struct TracePrefetch;
+
+/** An open trace file. */
+typedef struct TraceFile
+{
+    /**
+     * The file descriptor data is read from: the trace file itself, or the
+     * read end of the pipe from gunzip.
+     */
+    int fd;
+
+    /** The process ID of gunzip, or -1 if decompressing in-process. */
+    pid_t pid;
+
+    /** Whether the trace is uncompressed and memory-mapped. */
+    bool mapped;
+
+    /**
+     * Whether the trace is uncompressed but not a regular file, so it is read
+     * as is from fd.
+     */
+    bool raw;
+
+    /** The mapping of an uncompressed trace, or NULL if it is empty. */
+    uint8_t *map;
+
+    /** The size of the mapping. */
+    size_t map_size;
+
+    /** The offset of the first byte of the mapping not yet handed out. */
+    size_t map_offset;
+
+    /** The zlib stream state. Unused when reading from gunzip. */
+    z_stream zs;
+
+    /**
+     * Compressed input waiting to be inflated, or for a raw trace, the bytes
+     * read to tell it is not compressed, at zs.next_in.
+     */
+    uint8_t *in_buf;
+
+    /** Inflated, gunzip, or raw output waiting to be handed out. */
+    uint8_t *out_buf;
+
+    /**
+     * Where tracefile_next() assembles data that straddles two fills of
+     * out_buf. Allocated on first use.
+     */
+    uint8_t *next_buf;
+
+    /** The offset of the first byte in out_buf not yet handed out. */
+    size_t out_offset;
+
+    /** The number of bytes in out_buf not yet handed out. */
+    size_t out_left;
+
+    /** Whether the end of the compressed file has been read. */
+    bool in_eof;
+
+    /** Whether the whole trace has been inflated or read. */
+    bool done;
+
+    /** Whether a read error or corrupt data has been encountered. */
+    bool error;
+
+    /**
+     * The prefetch thread decompressing the trace into a ring of buffers, or
+     * NULL if this thread decompresses it. When set, out_buf is the ring
+     * buffer being handed out, and fd, pid, and zs are unused.
+     */
+    struct TracePrefetch *prefetch;
+
+    /** The number of read() system calls issued on fd. */
+    uint64_t stat_syscalls;
+
+    /** The number of decompressed bytes handed out. */
+    uint64_t stat_bytes;
+} TraceFile;
+
+/**
+ * Open a trace file for reading.
+ *
+ * A gzip-compressed trace is decompressed as it is read. Any other regular
+ * file is taken to be an uncompressed trace and memory-mapped; anything else,
+ * such as a pipe, is read as is.
+ *
+ * @param filename the path of the trace file
+ * @param use_gunzip whether to decompress with an external gunzip process
+ *                   instead of in-process with zlib
+ * @return a pointer to a newly allocated trace file, or NULL on failure
+ */
+TraceFile *tracefile_open(const char *filename, bool use_gunzip);
+
+/**
+ * Open a trace file for reading, and decompress it on a separate thread.
+ *
+ * An uncompressed trace is memory-mapped as by tracefile_open(), without a
+ * thread.
+ *
+ * @param filename the path of the trace file
+ * @param use_gunzip whether to decompress with an external gunzip process
+ *                   instead of in-process with zlib
+ * @return a pointer to a newly allocated trace file, or NULL on failure
+ */
+TraceFile *tracefile_open_prefetch(const char *filename, bool use_gunzip);
+
+/**
+ * Read decompressed trace data, with the same semantics as read(): the buffer
+ * is filled as far as possible, and fewer than size bytes are returned only at
+ * the end of the trace.
+ *
+ * @param tf the trace file
+ * @param buf the buffer to read into
+ * @param size the number of bytes to read
+ * @return the number of bytes read, 0 at the end of the trace, or -1 on error
+ */
+ssize_t tracefile_read(TraceFile *tf, void *buf, size_t size);
+
+/**
+ * Get the next size bytes of decompressed trace data without copying them
+ * where possible.
+ *
+ * The data is handed out straight from the mapping of an uncompressed trace,
+ * or from the buffer it was inflated or read into. It is only copied when it
+ * straddles two fills of that buffer.
+ *
+ * @param tf the trace file
+ * @param data set to point at the data, which stays valid until the next call
+ *             on tf (or until tf is closed, for a memory-mapped trace)
+ * @param size the number of bytes wanted, at most TRACEFILE_OUT_BUF_SIZE
+ * @return the number of bytes available at *data, which is less than size only
+ *         at the end of the trace, 0 at the end of the trace, or -1 on error
+ */
+ssize_t tracefile_next(TraceFile *tf, const void **data, size_t size);
+
+/**
+ * Skip over decompressed trace data without handing it out, e.g. to
+ * fast-forward to the part of a trace to be simulated.
+ *
+ * Skipping a memory-mapped trace costs nothing; a compressed trace is still
+ * inflated, but straight into the internal buffer and without any copying.
+ *
+ * @param tf the trace file
+ * @param size the number of bytes to skip
+ * @return the number of bytes skipped, which is less than size only at the end
+ *         of the trace, or -1 on error
+ */
+ssize_t tracefile_skip(TraceFile *tf, size_t size);
+
+/**
+ * Close a trace file and free it.
+ *
+ * When reading from gunzip, this waits for the gunzip process to exit. A
+ * prefetch thread is stopped first.
+ *
+ * @param tf the trace file
+ * @return the exit status of gunzip (127 if it could not be run), or 0 when
+ *         decompressing in-process
+ */
+int tracefile_close(TraceFile *tf);
+
+#endif
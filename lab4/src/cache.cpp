@@ -375,3 +375,17 @@ void cache_print_stats(Cache *c, const char *header)
     printf("%s_WRITE_MISS_PERC \t\t : %10.3f\n", header, write_miss_percent);
     printf("%s_DIRTY_EVICTS    \t\t : %10llu\n", header, c->stat_dirty_evicts);
 }
+
+/**
+ * Zero the statistics of the given cache, leaving its contents alone.
+ * 
+ * @param c The cache to reset the statistics of.
+ */
+void cache_reset_stats(Cache *c)
+{
+    c->stat_read_access = 0;
+    c->stat_write_access = 0;
+    c->stat_read_miss = 0;
+    c->stat_write_miss = 0;
+    c->stat_dirty_evicts = 0;
+}
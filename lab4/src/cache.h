@@ -206,4 +206,11 @@ unsigned int cache_find_victim(Cache *c, unsigned int set_index,
  */
 void cache_print_stats(Cache *c, const char *label);
 
+/**
+ * Zero the statistics of the given cache, leaving its contents alone.
+ * 
+ * @param c The cache to reset the statistics of.
+ */
+void cache_reset_stats(Cache *c);
+
 #endif // __CACHE_H__
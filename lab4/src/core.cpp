@@ -9,20 +9,22 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/wait.h>
-#include <unistd.h>
 
 extern uint64_t current_cycle;
+extern uint32_t USE_GUNZIP;
+extern SimPoints *simpoints;
 
-int open_gunzip_pipe(const char *filename, int *fd, pid_t *pid);
-ssize_t trace_read(Core *core, void *buf, size_t size);
+/**
+ * The size of a trace record: a 4-byte instruction address, a 1-byte
+ * instruction type, and a 4-byte load/store address, packed.
+ */
+#define TRACE_REC_SIZE 9
 
 Core *core_new(MemorySystem *memsys, const char *trace_filename,
                unsigned int core_id)
 {
-    int trace_fd;
-    pid_t pid;
-    if (open_gunzip_pipe(trace_filename, &trace_fd, &pid) != 0)
+    TraceFile *trace = tracefile_open(trace_filename, USE_GUNZIP);
+    if (trace == NULL)
     {
         return NULL;
     }
@@ -30,10 +32,8 @@ Core *core_new(MemorySystem *memsys, const char *trace_filename,
     Core *core = (Core *)calloc(1, sizeof(Core));
     core->core_id = core_id;
     core->memsys = memsys;
-    core->trace_fd = trace_fd;
-    core->pid = pid;
-    core->read_buf_offset = 0;
-    core->read_buf_left = 0;
+    core->trace = trace;
+    core->simpoints = simpoints;
 
     core_read_trace(core);
     return core;
@@ -96,18 +96,33 @@ void core_read_trace(Core *core)
     uint8_t inst_type;
     uint32_t ldst_addr;
 
-    if (trace_read(core, &inst_addr, sizeof(inst_addr)) !=
-            sizeof(inst_addr) ||
-        trace_read(core, &inst_type, sizeof(inst_type)) !=
-            sizeof(inst_type) ||
-        trace_read(core, &ldst_addr, sizeof(ldst_addr)) !=
-            sizeof(ldst_addr))
+    // Get the next record straight from the trace file, skipping ahead to the
+    // next simulation point if needed.
+    const void *data;
+    ssize_t bytes_read;
+    if (core->simpoints != NULL)
+    {
+        bytes_read = simpoints_next(core->simpoints, core->trace, &data,
+                                    TRACE_REC_SIZE);
+    }
+    else
+    {
+        bytes_read = tracefile_next(core->trace, &data, TRACE_REC_SIZE);
+    }
+    if (bytes_read != TRACE_REC_SIZE)
     {
         core->done = true;
         core->done_inst_count = core->inst_count;
         core->done_cycle_count = current_cycle;
+        return;
     }
 
+    const uint8_t *rec = (const uint8_t *)data;
+    memcpy(&inst_addr, rec, sizeof(inst_addr));
+    memcpy(&inst_type, rec + sizeof(inst_addr), sizeof(inst_type));
+    memcpy(&ldst_addr, rec + sizeof(inst_addr) + sizeof(inst_type),
+           sizeof(ldst_addr));
+
     core->trace_inst_addr = inst_addr;
     core->trace_inst_type = inst_type;
     core->trace_ldst_addr = ldst_addr;
@@ -129,94 +144,5 @@ void core_print_stats(Core *core)
            core->done_cycle_count);
     printf("CORE_%01d_IPC          \t\t : %10.3f\n", core->core_id, ipc);
 
-    close(core->trace_fd);
-    waitpid(core->pid, NULL, 0);
-}
-
-int open_gunzip_pipe(const char *filename, int *fd, pid_t *pid)
-{
-    int status;
-    int pipefd[2];
-
-    status = pipe(pipefd);
-    if (status != 0)
-    {
-        perror("Couldn't create pipe");
-        return 1;
-    }
-
-    *pid = fork();
-    if (*pid == -1)
-    {
-        perror("Couldn't fork");
-        close(pipefd[0]);
-        close(pipefd[1]);
-        return 1;
-    }
-
-    if (*pid == 0)
-    {
-        // Child process: exec gunzip.
-        dup2(pipefd[1], STDOUT_FILENO);
-        close(pipefd[0]);
-        close(pipefd[1]);
-        execlp("gunzip", "gunzip", "-c", filename, NULL);
-        perror("Couldn't exec gunzip");
-        fprintf(stderr, "Is gunzip installed?\n");
-        return 127;
-    }
-
-    // Parent process: return the read end of the pipe.
-    *fd = pipefd[0];
-    close(pipefd[1]);
-    return 0;
-}
-
-ssize_t trace_read(Core *core, void *buf, size_t size)
-{
-    uint8_t *bytes = (uint8_t *)buf;
-    size_t bytes_read_total = 0;
-    size_t bytes_left = size;
-
-    // Read a total of size bytes from the file descriptor.
-    while (bytes_left > 0)
-    {
-        if (core->read_buf_left < 0)
-        {
-            // Error
-            return -1;
-        }
-
-        if (core->read_buf_left == 0)
-        {
-            // Refill the read buffer.
-            core->read_buf_left = read(core->trace_fd, core->read_buf,
-                                       sizeof(core->read_buf));
-            if (core->read_buf_left < 0)
-            {
-                perror("Couldn't read from trace file");
-                return -1;
-            }
-            if (core->read_buf_left == 0)
-            {
-                // EOF
-                break;
-            }
-            core->read_buf_offset = 0;
-        }
-
-        // Copy bytes from the read buffer to the caller's buffer.
-        uint8_t *read_buf_ptr = core->read_buf + core->read_buf_offset;
-        size_t bytes_to_copy = ((ssize_t)bytes_left < core->read_buf_left)
-                                   ? bytes_left
-                                   : core->read_buf_left;
-        memcpy(bytes, read_buf_ptr, bytes_to_copy);
-        bytes += bytes_to_copy;
-        bytes_read_total += bytes_to_copy;
-        bytes_left -= bytes_to_copy;
-        core->read_buf_left -= bytes_to_copy;
-        core->read_buf_offset += bytes_to_copy;
-    }
-
-    return bytes_read_total;
+    tracefile_close(core->trace);
 }
@@ -10,6 +10,8 @@
 
 #include "types.h"
 #include "memsys.h"
+#include "simpoints.h"
+#include "tracefile.h"
 #include <sys/types.h>
 
 typedef struct Core
@@ -18,11 +20,10 @@ typedef struct Core
 
     MemorySystem *memsys;
 
-    int trace_fd;
-    pid_t pid;
-    uint8_t read_buf[32 * 1024];
-    size_t read_buf_offset;
-    ssize_t read_buf_left;
+    TraceFile *trace;
+
+    // The simulation points to run, or NULL to run the whole trace.
+    SimPoints *simpoints;
 
     bool done;
 
@@ -286,3 +286,16 @@ void dram_print_stats(DRAM *dram)
     printf("DRAM_READ_DELAY_AVG  \t\t : %10.3f\n", avg_read_delay);
     printf("DRAM_WRITE_DELAY_AVG \t\t : %10.3f\n", avg_write_delay);
 }
+
+/**
+ * Zero the statistics of the DRAM module, leaving its row buffers alone.
+ * 
+ * @param dram The DRAM module to reset the statistics of.
+ */
+void dram_reset_stats(DRAM *dram)
+{
+    dram->stat_read_access = 0;
+    dram->stat_read_delay = 0;
+    dram->stat_write_access = 0;
+    dram->stat_write_delay = 0;
+}
@@ -140,4 +140,11 @@ uint64_t dram_access_mode_CDEF(DRAM *dram, uint64_t line_addr,
  */
 void dram_print_stats(DRAM *dram);
 
+/**
+ * Zero the statistics of the DRAM module, leaving its row buffers alone.
+ * 
+ * @param dram The DRAM module to reset the statistics of.
+ */
+void dram_reset_stats(DRAM *dram);
+
 #endif // __DRAM_H__
@@ -586,3 +586,34 @@ void memsys_print_stats(MemorySystem *sys)
         dram_print_stats(sys->dram);
     }
 }
+
+/**
+ * Zero the statistics of the memory system and of its caches and DRAM, for
+ * example at the end of a warm-up period, leaving their contents alone.
+ * 
+ * @param sys The memory system to reset the statistics of.
+ */
+void memsys_reset_stats(MemorySystem *sys)
+{
+    sys->stat_ifetch_access = 0;
+    sys->stat_load_access = 0;
+    sys->stat_store_access = 0;
+    sys->stat_ifetch_delay = 0;
+    sys->stat_load_delay = 0;
+    sys->stat_store_delay = 0;
+
+    Cache *caches[] = {sys->dcache, sys->icache, sys->dcache_coreid[0],
+                       sys->dcache_coreid[1], sys->icache_coreid[0],
+                       sys->icache_coreid[1], sys->l2cache};
+    for (unsigned int i = 0; i < sizeof(caches) / sizeof(caches[0]); i++)
+    {
+        if (caches[i] != NULL)
+        {
+            cache_reset_stats(caches[i]);
+        }
+    }
+    if (sys->dram != NULL)
+    {
+        dram_reset_stats(sys->dram);
+    }
+}
@@ -208,4 +208,12 @@ uint64_t memsys_convert_vpn_to_pfn(MemorySystem *sys, uint64_t vpn,
  */
 void memsys_print_stats(MemorySystem *sys);
 
+/**
+ * Zero the statistics of the memory system and of its caches and DRAM, for
+ * example at the end of a warm-up period, leaving their contents alone.
+ * 
+ * @param sys The memory system to reset the statistics of.
+ */
+void memsys_reset_stats(MemorySystem *sys);
+
 #endif // __MEMSYS_H__
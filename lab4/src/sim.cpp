@@ -66,6 +66,27 @@ unsigned int NUM_CORES = 0;
 /** Which page policy the DRAM should use. */
 DRAMPolicy DRAM_PAGE_POLICY = OPEN_PAGE;
 
+/**
+ * Whether the trace files should be decompressed by an external gunzip process
+ * instead of in-process with zlib.
+ */
+uint32_t USE_GUNZIP = 0;
+
+/**
+ * The simulation points to run on core 0, or NULL to run the whole trace.
+ * Only a single core can be sampled.
+ */
+SimPoints *simpoints = NULL;
+
+/**
+ * The number of trace records of core 0 to skip before simulating, the number
+ * after those to simulate only to warm up the caches and DRAM, and the number
+ * after those to simulate and measure (0 for the rest of the trace).
+ */
+uint64_t SKIP_INST = 0;
+uint64_t WARMUP_INST = 0;
+uint64_t SIMULATE_INST = 0;
+
 /**
  * The current clock cycle number.
  * 
@@ -96,6 +117,10 @@ int main(int argc, char **argv)
     for (unsigned int i = 0; i < NUM_CORES; i++)
     {
         core[i] = core_new(memsys, trace_filename[i], i);
+        if (core[i] == NULL)
+        {
+            return 1;
+        }
     }
 
     print_dots();
@@ -106,12 +131,28 @@ int main(int argc, char **argv)
     {
         all_cores_done = true;
 
+        // The warm-up of a window is over once its first measured
+        // instruction is next to issue: count that one and what follows.
+        if (simpoints != NULL &&
+            simpoints_fetch(simpoints, core[0]->inst_count) &&
+            simpoints->interval_size == 0)
+        {
+            memsys_reset_stats(memsys);
+        }
+
         for (unsigned int i = 0; i < NUM_CORES; i++)
         {
             core_cycle(core[i]);
             all_cores_done = all_cores_done && core[i]->done;
         }
 
+        // An instruction is done once the next one issues.
+        if (simpoints != NULL && core[0]->inst_count > 0)
+        {
+            simpoints_retire(simpoints, core[0]->inst_count - 1,
+                             current_cycle);
+        }
+
         if (current_cycle - last_printdot_cycle >= DOT_INTERVAL)
         {
             print_dots();
@@ -120,6 +161,16 @@ int main(int argc, char **argv)
         current_cycle++;
     }
 
+    if (simpoints != NULL)
+    {
+        simpoints_finish(simpoints, core[0]->done_inst_count,
+                         core[0]->done_cycle_count);
+
+        // Leave out warm-up.
+        core[0]->done_inst_count = simpoints->measured_inst;
+        core[0]->done_cycle_count = simpoints->measured_cycles;
+    }
+
     print_stats();
     return 0;
 }
@@ -278,6 +329,53 @@ int parse_args(int argc, char **argv)
                 DRAM_PAGE_POLICY = (DRAMPolicy)dram_policy;
             }
 
+            else if (strcasecmp(argv[i], "-gunzip") == 0)
+            {
+                USE_GUNZIP = 1;
+            }
+
+            else if (strcasecmp(argv[i], "-simpoints") == 0)
+            {
+                if (++i >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to -simpoints\n");
+                    return 2;
+                }
+
+                simpoints_free(simpoints);
+                simpoints = simpoints_load(argv[i]);
+                if (simpoints == NULL)
+                {
+                    return 2;
+                }
+            }
+
+            else if (strcasecmp(argv[i], "-skip") == 0 ||
+                     strcasecmp(argv[i], "-warmup") == 0 ||
+                     strcasecmp(argv[i], "-simulate") == 0)
+            {
+                if (i + 1 >= argc)
+                {
+                    fprintf(stderr, "Error: missing argument to %s\n", argv[i]);
+                    return 2;
+                }
+
+                uint64_t num_inst = strtoull(argv[i + 1], NULL, 10);
+                if (strcasecmp(argv[i], "-skip") == 0)
+                {
+                    SKIP_INST = num_inst;
+                }
+                else if (strcasecmp(argv[i], "-warmup") == 0)
+                {
+                    WARMUP_INST = num_inst;
+                }
+                else
+                {
+                    SIMULATE_INST = num_inst;
+                }
+                i++;
+            }
+
             else
             {
                 fprintf(stderr, "Error: unrecognized option: %s\n", argv[i]);
@@ -304,6 +402,28 @@ int parse_args(int argc, char **argv)
         return 2;
     }
 
+    if (simpoints != NULL && (SKIP_INST > 0 || SIMULATE_INST > 0))
+    {
+        fprintf(stderr, "Error: -skip and -simulate cannot be used with "
+                        "-simpoints\n");
+        return 2;
+    }
+    if (simpoints != NULL)
+    {
+        simpoints_set_warmup(simpoints, WARMUP_INST);
+    }
+    else if (SKIP_INST > 0 || WARMUP_INST > 0 || SIMULATE_INST > 0)
+    {
+        simpoints = simpoints_window(SKIP_INST, WARMUP_INST, SIMULATE_INST);
+    }
+
+    if (simpoints != NULL && NUM_CORES > 1)
+    {
+        fprintf(stderr, "Error: -simpoints, -skip, -warmup, and -simulate "
+                        "need a single trace file\n");
+        return 2;
+    }
+
     return 0;
 }
 
@@ -344,6 +464,16 @@ void print_stats()
         core_print_stats(core[i]);
     }
 
+    if (simpoints != NULL && simpoints->interval_size > 0)
+    {
+        printf("\n");
+        simpoints_print(simpoints, "CORE_0");
+
+        // Only cycles are measured point by point.
+        printf("(Memory system statistics include the warm-up before each "
+               "point)\n");
+    }
+
     memsys_print_stats(memsys);
 }
 
@@ -381,4 +511,22 @@ void print_usage(const char *program_name)
     fprintf(stderr, "    -dram_policy <num>      Set DRAM page policy "
                     "[0: open-page, 1: close-page]\n");
     fprintf(stderr, "                            (default: 0)\n");
+    fprintf(stderr, "    -gunzip                 Decompress traces with an "
+                    "external gunzip process\n");
+    fprintf(stderr, "                            instead of in-process with "
+                    "zlib\n");
+    fprintf(stderr, "    -simpoints <file>       Run only the simulation points "
+                    "listed in <file>\n");
+    fprintf(stderr, "                            on a single core and report "
+                    "their weighted CPI\n");
+    fprintf(stderr, "    -skip <num>             Skip the first <num> "
+                    "instructions of the trace\n");
+    fprintf(stderr, "    -warmup <num>           Run <num> instructions, after "
+                    "those skipped or before\n");
+    fprintf(stderr, "                            each simulation point, "
+                    "without measuring them\n");
+    fprintf(stderr, "    -simulate <num>         Measure only the next <num> "
+                    "instructions\n");
+    fprintf(stderr, "                            (default: 0, the rest of the "
+                    "trace)\n");
 }
@@ -0,0 +1,278 @@
+// simpoints.h
+// Declares simulation point lists: the representative intervals of a trace
+// chosen by the simpoint tool in lab1, and their weights.
+//
+// A list is a text file of the form
+//
+//     # Any number of comment lines
+//     interval <instructions per interval>
+//     instructions <instructions in the whole trace>
+//     <interval number> <weight>
+//     ...
+//
+// with one line per simulation point, in increasing order of interval number.
+// Interval n covers trace records n * interval to (n + 1) * interval - 1.
+//
+// A simulator given a list fetches only the records of those intervals,
+// skipping the rest with tracefile_skip(), and measures the cycles each
+// interval takes. Weighting the CPI of every interval estimates the CPI of the
+// whole trace.
+//
+// Each point may be preceded by warm-up records, which are simulated to bring
+// predictors and caches up to date but not measured. The same machinery runs a
+// single window of a trace: skip, warm up, then measure; see
+// simpoints_window().
+//
+// Cycles are measured as instructions retire, with simpoints_retire(), but a
+// simulator that counts events as instructions are fetched or issued must
+// reset those counts when the first measured instruction gets there, which it
+// learns from simpoints_fetch().
+
+#ifndef _SIMPOINTS_H_
+#define _SIMPOINTS_H_
+
+#include "tracefile.h"
+#include <inttypes.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/** A simulation point: one representative interval of a trace. */
+typedef struct SimPoint
+{
+    /** The number of the interval. */
+    uint64_t interval;
+
+    /** The fraction of the trace the interval represents. */
+    double weight;
+
+    /** The first record of the trace to measure. */
+    uint64_t start;
+
+    /** The number of records to measure. */
+    uint64_t length;
+
+    /** The number of records before start to simulate without measuring. */
+    uint64_t warmup;
+
+    /** The number of instructions of the point measured. */
+    uint64_t num_inst;
+
+    /** The number of cycles the measured instructions took. */
+    uint64_t num_cycles;
+} SimPoint;
+
+/** A list of simulation points, and the progress of simulating them. */
+typedef struct SimPoints
+{
+    /**
+     * The number of instructions per interval, or 0 for a window made by
+     * simpoints_window().
+     */
+    uint64_t interval_size;
+
+    /** The number of instructions in the whole trace, or 0 if unknown. */
+    uint64_t trace_inst;
+
+    /** The simulation points, in increasing order of interval number. */
+    SimPoint *points;
+
+    /** The number of simulation points. */
+    uint32_t count;
+
+    /** The index of the next point to fetch records from. */
+    uint32_t next_fetch;
+
+    /** The number of records consumed from the trace, fetched or skipped. */
+    uint64_t fetch_pos;
+
+    /** The number of records left to fetch from the current point. */
+    uint64_t fetch_left;
+
+    /** The index of the first point whose measurement is yet to be fetched. */
+    uint32_t next_measure;
+
+    /** The number of instructions fetched before that point's warm-up. */
+    uint64_t measure_base;
+
+    /** The index of the point whose instructions are being retired. */
+    uint32_t next_retire;
+
+    /** The number of instructions retired before the current point. */
+    uint64_t retire_base;
+
+    /** Whether the current point has finished warming up. */
+    bool measuring;
+
+    /** The cycle the current phase (warm-up or measurement) started on. */
+    uint64_t retire_cycle;
+
+    /** The number of instructions measured over all points. */
+    uint64_t measured_inst;
+
+    /** The number of cycles measured over all points. */
+    uint64_t measured_cycles;
+} SimPoints;
+
+/**
+ * Allocate an empty list of simulation points.
+ *
+ * @param interval_size the number of instructions per interval
+ * @param trace_inst the number of instructions in the whole trace
+ * @param count the number of simulation points
+ * @return a pointer to a newly allocated list, whose points are zeroed
+ */
+SimPoints *simpoints_new(uint64_t interval_size, uint64_t trace_inst,
+                         uint32_t count);
+
+/**
+ * Make a list of a single window of a trace: skip some records, simulate some
+ * without measuring them, then measure the rest.
+ *
+ * @param skip the number of records to skip
+ * @param warmup the number of records after those to warm up with
+ * @param simulate the number of records after those to measure, or 0 to
+ *                 measure up to the end of the trace
+ * @return a pointer to a newly allocated list
+ */
+SimPoints *simpoints_window(uint64_t skip, uint64_t warmup, uint64_t simulate);
+
+/**
+ * Warm up before every simulation point of a list, as far as the end of the
+ * previous point allows.
+ *
+ * @param sp the list
+ * @param warmup the number of records to warm up with before each point
+ */
+void simpoints_set_warmup(SimPoints *sp, uint64_t warmup);
+
+/**
+ * Read a list of simulation points.
+ *
+ * @param filename the path of the list
+ * @return a pointer to a newly allocated list, or NULL on failure
+ */
+SimPoints *simpoints_load(const char *filename);
+
+/**
+ * Write a list of simulation points.
+ *
+ * @param sp the list
+ * @param filename the path to write to
+ * @return 0 on success, or -1 on failure
+ */
+int simpoints_write(const SimPoints *sp, const char *filename);
+
+/**
+ * Free a list of simulation points.
+ *
+ * @param sp the list to free
+ */
+void simpoints_free(SimPoints *sp);
+
+/**
+ * Get the next record of the simulation points from a trace file, skipping
+ * the records between them. Use in place of tracefile_next().
+ *
+ * @param sp the list
+ * @param tf the trace file
+ * @param data set to point at the record
+ * @param rec_size the size of a record
+ * @return the number of bytes available at *data, 0 once every point has been
+ *         fetched or at the end of the trace, or -1 on error
+ */
+ssize_t simpoints_next(SimPoints *sp, TraceFile *tf, const void **data,
+                       size_t rec_size);
+
+/**
+ * Check whether the next instruction to be fetched is the first measured one
+ * of a simulation point that was warmed up, so that the statistics the
+ * simulator keeps itself at fetch can be reset before it counts toward them.
+ * Call before every instruction is fetched.
+ *
+ * @param sp the list
+ * @param num_inst the number of instructions fetched so far
+ * @return whether the next instruction ends a warm-up
+ */
+static inline bool simpoints_fetch(SimPoints *sp, uint64_t num_inst)
+{
+    while (sp->next_measure < sp->count)
+    {
+        const SimPoint *point = &sp->points[sp->next_measure];
+        uint64_t measure_start = sp->measure_base + point->warmup;
+        if (num_inst < measure_start)
+        {
+            return false;
+        }
+        sp->measure_base = measure_start + point->length;
+        sp->next_measure++;
+        if (num_inst == measure_start)
+        {
+            return point->warmup > 0;
+        }
+    }
+    return false;
+}
+
+/**
+ * Record the end of the warm-up or measurement of every simulation point whose
+ * instructions have all retired. Call after every simulated cycle.
+ *
+ * @param sp the list
+ * @param num_inst the number of instructions retired so far
+ * @param num_cycles the number of cycles simulated so far
+ */
+static inline void simpoints_retire(SimPoints *sp, uint64_t num_inst,
+                                    uint64_t num_cycles)
+{
+    while (sp->next_retire < sp->count)
+    {
+        SimPoint *point = &sp->points[sp->next_retire];
+        uint64_t measure_start = sp->retire_base + point->warmup;
+        if (!sp->measuring)
+        {
+            if (num_inst < measure_start)
+            {
+                break;
+            }
+            if (point->warmup > 0)
+            {
+                sp->retire_cycle = num_cycles;
+            }
+            sp->measuring = true;
+        }
+        if (num_inst - measure_start < point->length)
+        {
+            break;
+        }
+
+        point->num_inst = point->length;
+        point->num_cycles = num_cycles - sp->retire_cycle;
+        sp->measured_inst += point->num_inst;
+        sp->measured_cycles += point->num_cycles;
+        sp->retire_base = measure_start + point->length;
+        sp->retire_cycle = num_cycles;
+        sp->measuring = false;
+        sp->next_retire++;
+    }
+}
+
+/**
+ * Record the end of the simulation, which ends the current simulation point
+ * early if the trace ran out.
+ *
+ * @param sp the list
+ * @param num_inst the number of instructions retired
+ * @param num_cycles the number of cycles simulated
+ */
+void simpoints_finish(SimPoints *sp, uint64_t num_inst, uint64_t num_cycles);
+
+/**
+ * Print the CPI of every simulation point and the weighted CPI, IPC, and
+ * number of cycles estimated for the whole trace. Prints nothing for a window.
+ *
+ * @param sp the list
+ * @param prefix the prefix of every statistic, e.g. "LAB2"
+ */
+void simpoints_print(const SimPoints *sp, const char *prefix);
+
+#endif